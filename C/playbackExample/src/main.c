@@ -52,9 +52,8 @@ int main(void)
 		case 2:
 		{
 			getString("Enter path to saved playback file", path);
-			int interval = getInt("Enter interval between frames (milliseconds)");
 
-			playback(path, interval);
+			playback(path);
 			break;
 		}
 		case 3:
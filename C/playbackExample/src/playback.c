@@ -27,8 +27,11 @@
 #include "chrome.h"
 
 #include "xplaneConnect.h"
+#include "xplaneRecording.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #ifdef WIN32
@@ -48,16 +51,17 @@ void playbackSleep(int ms)
 
 void record(char* path, int interval, int duration)
 {
-	FILE* fd = fopen(path, "w");
 	int count = duration * 1000 / interval;
-	if (!fd)
+	if (count < 1)
 	{
-		displayMsg("Unable to open output file.");
+		displayMsg("Duration is less than one iteration.");
 		return;
 	}
-	if (count < 1)
+	XPCChannel channel = { "posi", XPC_TYPE_DOUBLE, 7, 0 };
+	XPCRecordingWriter* writer = createRecording(path, &channel, 1);
+	if (!writer)
 	{
-		displayMsg("Duration is less than one iteration.");
+		displayMsg("Unable to open output file.");
 		return;
 	}
 	displayMsg("Recording...");
@@ -72,35 +76,64 @@ void record(char* path, int interval, int duration)
 		{
 			continue;
 		}
-		fprintf(fd, "%f, %f, %f, %f, %f, %f, %f\n", posi[0], posi[1], posi[2], posi[3], posi[4], posi[5], posi[6]);
+		const void* values[1] = { posi };
+		appendRecord(writer, i * interval / 1000.0, values);
 	}
 	closeUDP(sock);
+	closeRecordingWriter(writer);
 	displayMsg("Recording Complete");
 }
 
-void playback(char* path, int interval)
+void playback(char* path)
 {
-	FILE* fd = fopen(path, "r");
-	if (!fd)
+	XPCRecording* recording = openRecording(path);
+	const XPCChannel* channels;
+	if (!recording)
 	{
-		displayMsg("Unable to open output file.");
+		displayMsg("Unable to open playback file.");
+		return;
+	}
+	long long count = getRecordCount(recording);
+	if (getRecordingChannels(recording, &channels) != 1 || channels[0].type != XPC_TYPE_DOUBLE ||
+		channels[0].count != 7 || count < 1 || count > 1048576)
+	{
+		displayMsg("The playback file does not contain a recorded flight.");
+		closeRecording(recording);
+		return;
+	}
+
+	// The plugin plays the whole recording on its own, so it is sent in one go.
+	double (*posi)[7] = malloc((size_t)count * sizeof(*posi));
+	double* times = malloc((size_t)count * sizeof(double));
+	if (!posi || !times)
+	{
+		displayMsg("Not enough memory to load the playback file.");
+		free(posi);
+		free(times);
+		closeRecording(recording);
 		return;
 	}
-	displayMsg("Starting Playback...");
+	for (long long i = 0; i < count; ++i)
+	{
+		times[i] = getRecordTime(recording, i);
+		memcpy(posi[i], getRecordValues(recording, i, 0), sizeof(posi[i]));
+	}
+	closeRecording(recording);
 
+	displayMsg("Uploading...");
 	XPCSocket sock = openUDP("127.0.0.1");
-	double posi[7];
-	while (!feof(fd) && !ferror(fd))
+	if (sendTRAJ(sock, times, posi, NULL, (int)count, NULL, NULL, 0, 0) < 0)
 	{
-		int result = fscanf(fd, "%lf, %lf, %lf, %lf, %lf, %lf, %lf\n",
-			&posi[0], &posi[1], &posi[2], &posi[3], &posi[4], &posi[5], &posi[6]);
-		playbackSleep(interval);
-		if (result != 7)
-		{
-			continue;
-		}
-		sendPOSI(sock, posi, 7, 0);
+		displayMsg("Upload failed.");
+	}
+	else
+	{
+		displayMsg("Starting Playback...");
+		sendPLAY(sock, XPC_PLAY_START, times[0], 0);
+		playbackSleep((int)((times[count - 1] - times[0]) * 1000));
+		displayMsg("Playback Complete");
 	}
 	closeUDP(sock);
-	displayMsg("Playback Complete");
+	free(posi);
+	free(times);
 }
@@ -27,6 +27,6 @@
 
 void record(char* path, int interval, int duration);
 
-void playback(char* path, int interval);
+void playback(char* path);
 
 #endif
@@ -56,8 +56,12 @@
 
 int sendUDP(XPCSocket sock, char buffer[], int len);
 int readUDP(XPCSocket sock, char buffer[], int len);
-int sendDREFRequest(XPCSocket sock, const char* drefs[], unsigned char count);
+int sendDREFRequest(XPCSocket sock, char* functionName, const char* head, const char* drefs[], unsigned char count);
+int sendSUBSRequest(XPCSocket sock, const char* drefs[], float deadbands[], unsigned char count,
+	unsigned short divisor, unsigned short keyframe, unsigned short port);
 int getDREFResponse(XPCSocket sock, float* values[], unsigned char count, int sizes[]);
+int parseDREFResponse(char* functionName, char buffer[], int len, float* values[], unsigned char count, int sizes[]);
+int parseDREFChanges(char buffer[], int len, float* values[], unsigned char count, int sizes[]);
 
 void printError(char *functionName, char *format, ...)
 {
@@ -231,6 +235,101 @@ int readUDP(XPCSocket sock, char buffer[], int len)
 	}
 	return status;
 }
+
+/// Tracks the fragments of a response that spans several datagrams.
+typedef struct
+{
+	/// The message header of the fragments, e.g. "RESF".
+	const char* head;
+	/// The sequence number of the request.
+	unsigned short seq;
+	/// The size of the header that starts every fragment.
+	int headerSize;
+	/// Non-zero if the fragment index and total are u16 values at bytes 7 and 9, zero if they are
+	/// single bytes at bytes 7 and 8.
+	int wide;
+	/// The number of fragments in the response, or -1 until the first one arrives.
+	int total;
+	/// The number of distinct fragments received so far.
+	int seen;
+	unsigned char received[65536 / 8];
+} FragmentReader;
+
+static void beginFragments(FragmentReader* reader, const char* head, unsigned short seq, int headerSize, int wide)
+{
+	reader->head = head;
+	reader->seq = seq;
+	reader->headerSize = headerSize;
+	reader->wide = wide;
+	reader->total = -1;
+	reader->seen = 0;
+	memset(reader->received, 0, sizeof(reader->received));
+}
+
+/// Reads datagrams until a fragment of the response arrives that hasn't been seen yet, skipping
+/// datagrams left over from earlier requests.
+///
+/// \param sock         The socket to read from.
+/// \param functionName The name of the calling function, used in error messages.
+/// \param reader       The state of the response.
+/// \param buffer       A buffer of at least 65536 bytes in which the fragment will be stored.
+/// \param index        The location in which the index of the fragment will be stored.
+/// \returns            The size of the fragment, -1 if reading fails, or -2 if no new fragment
+///                     arrives within XPC_FRAGMENT_TIMEOUT_MS.
+static int readFragment(XPCSocket sock, char* functionName, FragmentReader* reader, char buffer[], int* index)
+{
+	// readUDP waits 50 ms for each datagram.
+	int timeouts = 0;
+	for (;;)
+	{
+		int result = readUDP(sock, buffer, 65536);
+		if (result < 0)
+		{
+			printError(functionName, "Read operation failed after %d fragments.", reader->seen);
+			return -1;
+		}
+		if (result == 0)
+		{
+			if (++timeouts * 50 >= XPC_FRAGMENT_TIMEOUT_MS)
+			{
+				printError(functionName, "Timed out after %d fragments.", reader->seen);
+				return -2;
+			}
+			continue;
+		}
+		unsigned short fragmentSeq = 0;
+		if (result >= reader->headerSize)
+		{
+			memcpy(&fragmentSeq, buffer + 5, 2);
+		}
+		if (result < reader->headerSize || strncmp(buffer, reader->head, 4) != 0 || fragmentSeq != reader->seq)
+		{
+			// Left over from an earlier request.
+			continue;
+		}
+		int total;
+		if (reader->wide)
+		{
+			unsigned short header[2]; // index, total
+			memcpy(header, buffer + 7, sizeof(header));
+			*index = header[0];
+			total = header[1];
+		}
+		else
+		{
+			*index = (unsigned char)buffer[7];
+			total = (unsigned char)buffer[8];
+		}
+		if (reader->received[*index / 8] & (1 << (*index % 8)))
+		{
+			continue;
+		}
+		reader->received[*index / 8] |= 1 << (*index % 8);
+		reader->total = total;
+		++reader->seen;
+		return result;
+	}
+}
 /*****************************************************************************/
 /****                    End Low Level UDP functions                      ****/
 /*****************************************************************************/
@@ -293,6 +392,125 @@ int pauseSim(XPCSocket sock, char pause)
 	}
 	return 0;
 }
+
+int setLogLevel(XPCSocket sock, unsigned char level)
+{
+	// Validate input
+	if (level > 6)
+	{
+		printError("setLogLevel", "Invalid argument: %i", level);
+		return -2;
+	}
+
+	// Setup command
+	char buffer[6] = "LOGL";
+	buffer[5] = level;
+
+	// Send command
+	if (sendUDP(sock, buffer, 6) < 0)
+	{
+		printError("setLogLevel", "Failed to send command");
+		return -1;
+	}
+	return 0;
+}
+
+int getLatency(XPCSocket sock, XPCLatency stats[], int* count, char reset)
+{
+	// Setup command
+	char buffer[4096] = "STAT";
+	buffer[5] = 1;
+	buffer[6] = reset ? 1 : 0;
+
+	// Send command
+	if (sendUDP(sock, buffer, 7) < 0)
+	{
+		printError("getLatency", "Failed to send command");
+		return -1;
+	}
+
+	// Read response
+	// Format: STAR\0 | kind (1) | count (1) | { name (4) | count (4) | p50, p99, p99.9, max (4 each) } ...
+	int result = readUDP(sock, buffer, 4096);
+	if (result < 0)
+	{
+		printError("getLatency", "Read operation failed.");
+		return -2;
+	}
+	if (result < 7 || strncmp(buffer, "STAR", 4) != 0 || buffer[5] != 1)
+	{
+		printError("getLatency", "Unexpected response.");
+		return -3;
+	}
+	int n = (unsigned char)buffer[6];
+	if (result < 7 + 24 * n)
+	{
+		printError("getLatency", "Response was too short for %d entries.", n);
+		return -4;
+	}
+	if (n > *count)
+	{
+		printError("getLatency", "stats is too small. Got %d entries, only room for %d.", n, *count);
+		n = *count;
+	}
+
+	int i; // Iterator
+	for (i = 0; i < n; ++i)
+	{
+		const char* entry = buffer + 7 + 24 * i;
+		memcpy(stats[i].name, entry, 4);
+		stats[i].name[4] = 0;
+		memcpy(&stats[i].count, entry + 4, 4);
+		memcpy(&stats[i].p50, entry + 8, 4);
+		memcpy(&stats[i].p99, entry + 12, 4);
+		memcpy(&stats[i].p999, entry + 16, 4);
+		memcpy(&stats[i].max, entry + 20, 4);
+	}
+	*count = n;
+	return 0;
+}
+
+int getSTATS(XPCSocket sock, XPCStats* stats)
+{
+	// Setup command
+	char buffer[4096] = "STAT";
+	buffer[5] = 2;
+	buffer[6] = 0;
+
+	// Send command
+	if (sendUDP(sock, buffer, 7) < 0)
+	{
+		printError("getSTATS", "Failed to send command");
+		return -1;
+	}
+
+	// Read response
+	// Format: STAR\0 | kind (1) | count (1) | values (8 each)
+	int result = readUDP(sock, buffer, 4096);
+	if (result < 0)
+	{
+		printError("getSTATS", "Read operation failed.");
+		return -2;
+	}
+	if (result < 7 || strncmp(buffer, "STAR", 4) != 0 || buffer[5] != 2)
+	{
+		printError("getSTATS", "Unexpected response.");
+		return -3;
+	}
+	int n = (unsigned char)buffer[6];
+	if (result < 7 + 8 * n)
+	{
+		printError("getSTATS", "Response was too short for %d values.", n);
+		return -4;
+	}
+
+	// The plugin may know about more or fewer counters than this client. XPCStats lists them in
+	// the order they are sent, so copy as many as both sides know about.
+	int size = 8 * n < (int)sizeof(XPCStats) ? 8 * n : (int)sizeof(XPCStats);
+	memset(stats, 0, sizeof(XPCStats));
+	memcpy(stats, buffer + 7, size);
+	return 0;
+}
 /*****************************************************************************/
 /****                    End Configuration functions                      ****/
 /*****************************************************************************/
@@ -430,12 +648,14 @@ int sendDREFs(XPCSocket sock, const char* drefs[], float* values[], int sizes[],
 	return 0;
 }
 
-int sendDREFRequest(XPCSocket sock, const char* drefs[], unsigned char count)
+int sendDREFRequest(XPCSocket sock, char* functionName, const char* head, const char* drefs[], unsigned char count)
 {
 	// Setup command
 	// 6 byte header + potentially 255 drefs, each 256 chars long.
 	// Easiest to just round to an even 2^16.
-	char buffer[65536] = "GETD";
+	char buffer[65536];
+	strncpy(buffer, head, 4);
+	buffer[4] = 0;
 	buffer[5] = count;
 	int len = 6;
     int i; // iterator
@@ -444,7 +664,7 @@ int sendDREFRequest(XPCSocket sock, const char* drefs[], unsigned char count)
 		size_t drefLen = strnlen(drefs[i], 256);
 		if (drefLen > 255)
 		{
-			printError("getDREFs", "dref %d is too long.", i);
+			printError(functionName, "dref %d is too long.", i);
 			return -1;
 		}
 		buffer[len++] = (unsigned char)drefLen;
@@ -454,7 +674,7 @@ int sendDREFRequest(XPCSocket sock, const char* drefs[], unsigned char count)
 	// Send Command
 	if (sendUDP(sock, buffer, len) < 0)
 	{
-		printError("getDREFs", "Failed to send command");
+		printError(functionName, "Failed to send command");
 		return -2;
 	}
 	return 0;
@@ -475,14 +695,19 @@ int getDREFResponse(XPCSocket sock, float* values[], unsigned char count, int si
         return -1;
     }
 
-	if (result < 6)
+	return parseDREFResponse("getDREFs", buffer, result, values, count, sizes);
+}
+
+int parseDREFResponse(char* functionName, char buffer[], int len, float* values[], unsigned char count, int sizes[])
+{
+	if (len < 6)
 	{
-		printError("getDREFs", "Response was too short. Expected at least 6 bytes, but only got %d.", result);
+		printError(functionName, "Response was too short. Expected at least 6 bytes, but only got %d.", len);
 		return -2;
 	}
-	if (buffer[5] != count)
+	if ((unsigned char)buffer[5] != count)
 	{
-		printError("getDREFs", "Unexpected response size. Expected %d rows, got %d instead.", count, buffer[5]);
+		printError(functionName, "Unexpected response size. Expected %d rows, got %d instead.", count, (unsigned char)buffer[5]);
 		return -3;
 	}
 
@@ -490,10 +715,10 @@ int getDREFResponse(XPCSocket sock, float* values[], unsigned char count, int si
     int i; // Iterator
 	for (i = 0; i < count; ++i)
 	{
-		int l = buffer[cur++];
+		int l = (unsigned char)buffer[cur++];
 		if (l > sizes[i])
 		{
-			printError("getDREFs", "values is too small. Row had %d values, only room for %d.", l, sizes[i]);
+			printError(functionName, "values is too small. Row had %d values, only room for %d.", l, sizes[i]);
 			// Copy as many values as we can anyway
 			memcpy(values[i], buffer + cur, sizes[i] * sizeof(float));
 		}
@@ -515,7 +740,7 @@ int getDREF(XPCSocket sock, const char* dref, float values[], int* size)
 int getDREFs(XPCSocket sock, const char* drefs[], float* values[], unsigned char count, int sizes[])
 {
 	// Send Command
-	int result = sendDREFRequest(sock, drefs, count);
+	int result = sendDREFRequest(sock, "getDREFs", "GETD", drefs, count);
 	if (result < 0)
 	{
 		// An error ocurred while sending.
@@ -532,131 +757,1211 @@ int getDREFs(XPCSocket sock, const char* drefs[], float* values[], unsigned char
 	}
 	return 0;
 }
-/*****************************************************************************/
-/****                        End DREF functions                           ****/
-/*****************************************************************************/
 
-/*****************************************************************************/
-/****                          POSI functions                             ****/
-/*****************************************************************************/
-int getPOSI(XPCSocket sock, double values[7], char ac)
+int getDREFsTyped(XPCSocket sock, const char* drefs[], double* values[], DREF_TYPE types[], unsigned char count, int sizes[])
 {
-	// Setup send command
-	char buffer[6] = "GETP";
-	buffer[5] = ac;
-
-	// Send command
-	if (sendUDP(sock, buffer, 6) < 0)
+	// Send Command
+	if (sendDREFRequest(sock, "getDREFsTyped", "GETY", drefs, count) < 0)
 	{
-		printError("getPOSI", "Failed to send command.");
+		// sendDREFRequest will print an error message, so just return.
 		return -1;
 	}
 
-	// Get response
-	char readBuffer[46];
-	float f[7];
-	int readResult = readUDP(sock, readBuffer, 46);
-
-	// Copy response into values
-	if (readResult < 0)
+	// Read Response
+	char buffer[65536];
+	int result = readUDP(sock, buffer, 65536);
+	if (result < 0)
 	{
-		printError("getPOSI", "Failed to read response.");
+		printError("getDREFsTyped", "Read operation failed.");
 		return -2;
 	}
-	else if (readResult == 34) /* lat/lon/h as 32-bit float */
+	if (result < 6 || strncmp(buffer, "REST", 4) != 0)
 	{
-		memcpy(f, readBuffer + 6, 7 * sizeof(float));
-		values[0] = (double)f[0];
-		values[1] = (double)f[1];
-		values[2] = (double)f[2];
-		values[3] = (double)f[3];
-		values[4] = (double)f[4];
-		values[5] = (double)f[5];
-		values[6] = (double)f[6];
+		printError("getDREFsTyped", "Unexpected response.");
+		return -3;
 	}
-	else if (readResult == 46) /* lat/lon/h as 64-bit double */
+	if ((unsigned char)buffer[5] != count)
 	{
-		memcpy(values, readBuffer + 6, 3 * sizeof(double));
-		memcpy(f, readBuffer + 30, 4 * sizeof(float));
-		values[3] = (double)f[0];
-		values[4] = (double)f[1];
-		values[5] = (double)f[2];
-		values[6] = (double)f[3];
+		printError("getDREFsTyped", "Unexpected response size. Expected %d rows, got %d instead.", count, (unsigned char)buffer[5]);
+		return -4;
 	}
-	else
+
+	int cur = 6;
+	int i; // Iterator
+	for (i = 0; i < count; ++i)
 	{
-		printError("getPOSI", "Unexpected response length.");
-		return -3;
+		if (cur + 2 > result)
+		{
+			printError("getDREFsTyped", "Response was truncated at row %d.", i);
+			return -5;
+		}
+		DREF_TYPE type = (DREF_TYPE)(unsigned char)buffer[cur];
+		int l = (unsigned char)buffer[cur + 1];
+		cur += 2;
+
+		int elementSize;
+		switch (type)
+		{
+		case XPC_TYPE_INT:
+		case XPC_TYPE_FLOAT:
+			elementSize = 4;
+			break;
+		case XPC_TYPE_DOUBLE:
+			elementSize = 8;
+			break;
+		case XPC_TYPE_BYTES:
+			elementSize = 1;
+			break;
+		default:
+			elementSize = 0;
+			break;
+		}
+		if (cur + l * elementSize > result)
+		{
+			printError("getDREFsTyped", "Response was truncated at row %d.", i);
+			return -5;
+		}
+		if (types)
+		{
+			types[i] = type;
+		}
+
+		int n = l;
+		if (l > sizes[i])
+		{
+			printError("getDREFsTyped", "values is too small. Row had %d values, only room for %d.", l, sizes[i]);
+			// Copy as many values as we can anyway
+			n = sizes[i];
+		}
+		else
+		{
+			sizes[i] = l;
+		}
+
+		int j; // Iterator
+		for (j = 0; j < n; ++j)
+		{
+			const char* src = buffer + cur + j * elementSize;
+			switch (type)
+			{
+			case XPC_TYPE_INT:
+			{
+				int value;
+				memcpy(&value, src, sizeof(int));
+				values[i][j] = value;
+				break;
+			}
+			case XPC_TYPE_FLOAT:
+			{
+				float value;
+				memcpy(&value, src, sizeof(float));
+				values[i][j] = value;
+				break;
+			}
+			case XPC_TYPE_DOUBLE:
+				memcpy(&values[i][j], src, sizeof(double));
+				break;
+			default:
+				values[i][j] = (unsigned char)*src;
+				break;
+			}
+		}
+		cur += l * elementSize;
 	}
 	return 0;
 }
 
-int sendPOSI(XPCSocket sock, double values[], int size, char ac)
+int getDREFsFragmented(XPCSocket sock, const char* drefs[], float* values[], unsigned char count, int sizes[],
+	unsigned short mtu)
 {
-	// Validate input
-	if (ac < 0 || ac > 20)
-	{
-		printError("sendPOSI", "aircraft should be a value between 0 and 20.");
-		return -1;
-	}
-	if (size < 1 || size > 7)
+	static unsigned short lastSeq = 0;
+	unsigned short seq = ++lastSeq;
+	if (mtu == 0)
 	{
-		printError("sendPOSI", "size should be a value between 1 and 7.");
-		return -2;
+		mtu = XPC_DEFAULT_MTU;
 	}
 
 	// Setup command
-	char buffer[46] = "POSI";
-	buffer[4] = 0xff; //Placeholder for message length
-	buffer[5] = ac;
-    int i; // iterator
+	// Format: GETF\0 | seq (2) | mtu (2) | count (1) | drefs
+	char buffer[65536] = "GETF";
+	memcpy(buffer + 5, &seq, 2);
+	memcpy(buffer + 7, &mtu, 2);
+	buffer[9] = count;
+	int len = 10;
+	int i; // Iterator
+	for (i = 0; i < count; ++i)
+	{
+		size_t drefLen = strnlen(drefs[i], 256);
+		if (drefLen > 255)
+		{
+			printError("getDREFsFragmented", "dref %d is too long.", i);
+			return -1;
+		}
+		buffer[len++] = (unsigned char)drefLen;
+		strncpy(buffer + len, drefs[i], drefLen);
+		len += drefLen;
+	}
 
-	for (i = 0; i < 7; i++) // double for lat/lon/h
+	// Send command
+	if (sendUDP(sock, buffer, len) < 0)
 	{
-		double val = -998;
+		printError("getDREFsFragmented", "Failed to send command");
+		return -2;
+	}
 
-		if (i < size)
+	// Read response
+	// Format: RESF\0 | seq (2) | index (1) | total (1) | count (1) | runs
+	// Run: row (1) | row size (1) | first element (1) | length (1) | values
+	int capacity[255];
+	int rowSizes[255];
+	for (i = 0; i < count; ++i)
+	{
+		capacity[i] = sizes[i];
+		rowSizes[i] = 0;
+	}
+	FragmentReader reader;
+	beginFragments(&reader, "RESF", seq, 10, 0);
+	while (reader.total < 0 || reader.seen < reader.total)
+	{
+		int index;
+		int result = readFragment(sock, "getDREFsFragmented", &reader, buffer, &index);
+		if (result < 0)
 		{
-			val = values[i];
+			return result == -2 ? -7 : -3;
 		}
-		if (i < 3) /* lat/lon/h */
+		if ((unsigned char)buffer[9] != count)
 		{
-			memcpy(&buffer[6 + i*8], &val, sizeof(double));
+			printError("getDREFsFragmented", "Unexpected response size. Expected %d rows, got %d instead.",
+				count, (unsigned char)buffer[9]);
+			return -4;
 		}
-		else /* attitude and gear */
+
+		int cur = 10;
+		while (cur + 4 <= result)
 		{
-            float f = (float)val;
-            memcpy(&buffer[18 + i*4], &f, sizeof(float));
+			int row = (unsigned char)buffer[cur];
+			int rowSize = (unsigned char)buffer[cur + 1];
+			int start = (unsigned char)buffer[cur + 2];
+			int n = (unsigned char)buffer[cur + 3];
+			cur += 4;
+			if (row >= count || cur + n * (int)sizeof(float) > result)
+			{
+				printError("getDREFsFragmented", "Fragment %d is malformed.", index);
+				return -5;
+			}
+			rowSizes[row] = rowSize;
+
+			// Copy as many values as we can.
+			int copy = capacity[row] - start;
+			if (copy > n)
+			{
+				copy = n;
+			}
+			if (copy > 0)
+			{
+				memcpy(values[row] + start, buffer + cur, copy * sizeof(float));
+			}
+			cur += n * sizeof(float);
 		}
 	}
 
-	// Send Command
-	if (sendUDP(sock, buffer, 46) < 0)
+	int truncated = 0;
+	for (i = 0; i < count; ++i)
 	{
-		printError("sendPOSI", "Failed to send command");
-		return -3;
+		if (rowSizes[i] > capacity[i])
+		{
+			printError("getDREFsFragmented", "values is too small. Row had %d values, only room for %d.",
+				rowSizes[i], capacity[i]);
+			sizes[i] = capacity[i];
+			truncated = 1;
+		}
+		else
+		{
+			sizes[i] = rowSizes[i];
+		}
 	}
-	return 0;
+	return truncated ? -6 : 0;
 }
-/*****************************************************************************/
-/****                        End POSI functions                           ****/
-/*****************************************************************************/
 
-/*****************************************************************************/
-/****                          TERR functions                             ****/
-/*****************************************************************************/
-int sendTERRRequest(XPCSocket sock, double posi[3], char ac)
+int resolveDREFs(XPCSocket sock, const char* drefs[], unsigned short ids[], int sizes[], unsigned char count)
 {
-	// Setup send command
-	char buffer[30] = "GETT";
-	buffer[5] = ac;
-	memcpy(&buffer[6], posi, 3 * sizeof(double));
+	// Setup command
+	char buffer[65536] = "RSLV";
+	buffer[5] = count;
+	int len = 6;
+	int i; // Iterator
+	for (i = 0; i < count; ++i)
+	{
+		size_t drefLen = strnlen(drefs[i], 256);
+		if (drefLen > 255)
+		{
+			printError("resolveDREFs", "dref %d is too long.", i);
+			return -1;
+		}
+		buffer[len++] = (unsigned char)drefLen;
+		strncpy(buffer + len, drefs[i], drefLen);
+		len += drefLen;
+	}
 
 	// Send command
-	if (sendUDP(sock, buffer, 30) < 0)
+	if (sendUDP(sock, buffer, len) < 0)
 	{
-		printError("getTERR", "Failed to send command.");
-		return -1;
+		printError("resolveDREFs", "Failed to send command");
+		return -2;
+	}
+
+	// Read response
+	// Format: DRID\0 | count (1) | { id (2) | element count (1) } ...
+	int result = readUDP(sock, buffer, 65536);
+	if (result < 0)
+	{
+		printError("resolveDREFs", "Read operation failed.");
+		return -3;
+	}
+	if (result < 6 || strncmp(buffer, "DRID", 4) != 0)
+	{
+		printError("resolveDREFs", "Unexpected response.");
+		return -4;
+	}
+	if ((unsigned char)buffer[5] != count || result < 6 + 3 * count)
+	{
+		printError("resolveDREFs", "Unexpected response size. Expected %d ids.", count);
+		return -5;
+	}
+	for (i = 0; i < count; ++i)
+	{
+		memcpy(&ids[i], buffer + 6 + 3 * i, 2);
+		if (sizes)
+		{
+			sizes[i] = (unsigned char)buffer[8 + 3 * i];
+		}
+	}
+	return 0;
+}
+
+int getDREFsById(XPCSocket sock, const unsigned short ids[], float* values[], unsigned char count, int sizes[])
+{
+	// Setup command
+	char buffer[6 + 2 * 255] = "GETI";
+	buffer[5] = count;
+	memcpy(buffer + 6, ids, 2 * count);
+
+	// Send command
+	if (sendUDP(sock, buffer, 6 + 2 * count) < 0)
+	{
+		printError("getDREFsById", "Failed to send command");
+		return -1;
+	}
+
+	// Read response
+	if (getDREFResponse(sock, values, count, sizes) < 0)
+	{
+		// getDREFResponse will print an error message, so just return.
+		return -2;
+	}
+	return 0;
+}
+
+int sendDREFsById(XPCSocket sock, const unsigned short ids[], float* values[], int sizes[], int count)
+{
+	// Setup command
+	char buffer[65536] = "DREI";
+	int pos = 5;
+	int i; // Iterator
+	for (i = 0; i < count; ++i)
+	{
+		if (pos + sizes[i] * 4 + 3 > 65536)
+		{
+			printError("sendDREFsById", "About to overrun the send buffer!");
+			return -3;
+		}
+		if (sizes[i] > 255)
+		{
+			printError("sendDREFsById", "size %d is too big. Must be less than 256.", i);
+			return -1;
+		}
+		memcpy(buffer + pos, &ids[i], 2);
+		pos += 2;
+		buffer[pos++] = (unsigned char)sizes[i];
+		memcpy(buffer + pos, values[i], sizes[i] * sizeof(float));
+		pos += sizes[i] * sizeof(float);
+	}
+
+	// Send command
+	if (sendUDP(sock, buffer, pos) < 0)
+	{
+		printError("sendDREFsById", "Failed to send command");
+		return -2;
+	}
+	return 0;
+}
+
+int sendSUBSRequest(XPCSocket sock, const char* drefs[], float deadbands[], unsigned char count,
+	unsigned short divisor, unsigned short keyframe, unsigned short port)
+{
+	if (divisor == 0)
+	{
+		printError("subscribeDREFs", "divisor must be at least 1.");
+		return -1;
+	}
+
+	// Setup command
+	// 10 byte header + potentially 255 drefs, each 256 chars long, + trailer.
+	char buffer[65536 + 1024] = "SUBS";
+	memcpy(buffer + 5, &divisor, 2);
+	memcpy(buffer + 7, &port, 2);
+	buffer[9] = count;
+	int len = 10;
+	int i; // iterator
+	for (i = 0; i < count; ++i)
+	{
+		size_t drefLen = strnlen(drefs[i], 256);
+		if (drefLen > 255)
+		{
+			printError("subscribeDREFs", "dref %d is too long.", i);
+			return -2;
+		}
+		buffer[len++] = (unsigned char)drefLen;
+		strncpy(buffer + len, drefs[i], drefLen);
+		len += drefLen;
+	}
+	if (deadbands)
+	{
+		// Trailer: mode 1 (changes only) | keyframe interval | deadbands
+		buffer[len++] = 1;
+		memcpy(buffer + len, &keyframe, 2);
+		len += 2;
+		memcpy(buffer + len, deadbands, count * sizeof(float));
+		len += count * sizeof(float);
+	}
+
+	// Send Command
+	if (sendUDP(sock, buffer, len) < 0)
+	{
+		printError("subscribeDREFs", "Failed to send command");
+		return -3;
+	}
+	return 0;
+}
+
+int subscribeDREFs(XPCSocket sock, const char* drefs[], unsigned char count, unsigned short divisor, unsigned short port)
+{
+	return sendSUBSRequest(sock, drefs, NULL, count, divisor, 0, port);
+}
+
+int subscribeDREFChanges(XPCSocket sock, const char* drefs[], float deadbands[], unsigned char count,
+	unsigned short divisor, unsigned short keyframe, unsigned short port)
+{
+	float zero = 0.0F;
+	return sendSUBSRequest(sock, drefs, count > 0 ? deadbands : &zero, count, divisor, keyframe, port);
+}
+
+int unsubscribeDREFs(XPCSocket sock)
+{
+	// A divisor of 0 cancels the subscription
+	char buffer[10] = "SUBS";
+	if (sendUDP(sock, buffer, 10) < 0)
+	{
+		printError("unsubscribeDREFs", "Failed to send command");
+		return -1;
+	}
+	return 0;
+}
+
+int readDREFs(XPCSocket sock, float* values[], unsigned char count, int sizes[])
+{
+	char buffer[65536];
+	int result = readUDP(sock, buffer, 65536);
+	if (result < 0)
+	{
+		printError("readDREFs", "Read operation failed.");
+		return -1;
+	}
+	if (result == 0)
+	{
+		// No update yet
+		return 0;
+	}
+	if (strncmp(buffer, "RESD", 4) == 0)
+	{
+		if (parseDREFChanges(buffer, result, values, count, sizes) < 0)
+		{
+			// parseDREFChanges will print an error message, so just return.
+			return -3;
+		}
+		return 1;
+	}
+	if (strncmp(buffer, "RESP", 4) != 0)
+	{
+		printError("readDREFs", "Unexpected message type.");
+		return -2;
+	}
+	if (parseDREFResponse("readDREFs", buffer, result, values, count, sizes) < 0)
+	{
+		// parseDREFResponse will print an error message, so just return.
+		return -3;
+	}
+	return 1;
+}
+
+int parseDREFChanges(char buffer[], int len, float* values[], unsigned char count, int sizes[])
+{
+	// Format: RESD\0 | change count (2) | changes
+	// Change: dref index (1) | element index (1) | value (4)
+	if (len < 7)
+	{
+		printError("readDREFs", "Response was too short. Expected at least 7 bytes, but only got %d.", len);
+		return -1;
+	}
+	unsigned short changes;
+	memcpy(&changes, buffer + 5, 2);
+	if (len < 7 + changes * 6)
+	{
+		printError("readDREFs", "Response was truncated. Expected %d changes.", changes);
+		return -2;
+	}
+
+	int cur = 7;
+	int i; // Iterator
+	for (i = 0; i < changes; ++i, cur += 6)
+	{
+		unsigned char row = (unsigned char)buffer[cur];
+		unsigned char col = (unsigned char)buffer[cur + 1];
+		if (row >= count || col >= sizes[row])
+		{
+			// Values we don't have room for are dropped, as in parseDREFResponse
+			continue;
+		}
+		memcpy(values[row] + col, buffer + cur + 2, sizeof(float));
+	}
+	return 0;
+}
+/*****************************************************************************/
+/****                        End DREF functions                           ****/
+/*****************************************************************************/
+
+/*****************************************************************************/
+/****                          POSI functions                             ****/
+/*****************************************************************************/
+int getPOSI(XPCSocket sock, double values[7], char ac)
+{
+	// Setup send command
+	char buffer[6] = "GETP";
+	buffer[5] = ac;
+
+	// Send command
+	if (sendUDP(sock, buffer, 6) < 0)
+	{
+		printError("getPOSI", "Failed to send command.");
+		return -1;
+	}
+
+	// Get response
+	char readBuffer[46];
+	float f[7];
+	int readResult = readUDP(sock, readBuffer, 46);
+
+	// Copy response into values
+	if (readResult < 0)
+	{
+		printError("getPOSI", "Failed to read response.");
+		return -2;
+	}
+	else if (readResult == 34) /* lat/lon/h as 32-bit float */
+	{
+		memcpy(f, readBuffer + 6, 7 * sizeof(float));
+		values[0] = (double)f[0];
+		values[1] = (double)f[1];
+		values[2] = (double)f[2];
+		values[3] = (double)f[3];
+		values[4] = (double)f[4];
+		values[5] = (double)f[5];
+		values[6] = (double)f[6];
+	}
+	else if (readResult == 46) /* lat/lon/h as 64-bit double */
+	{
+		memcpy(values, readBuffer + 6, 3 * sizeof(double));
+		memcpy(f, readBuffer + 30, 4 * sizeof(float));
+		values[3] = (double)f[0];
+		values[4] = (double)f[1];
+		values[5] = (double)f[2];
+		values[6] = (double)f[3];
+	}
+	else
+	{
+		printError("getPOSI", "Unexpected response length.");
+		return -3;
+	}
+	return 0;
+}
+
+int sendPOSI(XPCSocket sock, double values[], int size, char ac)
+{
+	// Validate input
+	if (ac < 0 || ac > 20)
+	{
+		printError("sendPOSI", "aircraft should be a value between 0 and 20.");
+		return -1;
+	}
+	if (size < 1 || size > 7)
+	{
+		printError("sendPOSI", "size should be a value between 1 and 7.");
+		return -2;
+	}
+
+	// Setup command
+	char buffer[46] = "POSI";
+	buffer[4] = 0xff; //Placeholder for message length
+	buffer[5] = ac;
+    int i; // iterator
+
+	for (i = 0; i < 7; i++) // double for lat/lon/h
+	{
+		double val = -998;
+
+		if (i < size)
+		{
+			val = values[i];
+		}
+		if (i < 3) /* lat/lon/h */
+		{
+			memcpy(&buffer[6 + i*8], &val, sizeof(double));
+		}
+		else /* attitude and gear */
+		{
+            float f = (float)val;
+            memcpy(&buffer[18 + i*4], &f, sizeof(float));
+		}
+	}
+
+	// Send Command
+	if (sendUDP(sock, buffer, 46) < 0)
+	{
+		printError("sendPOSI", "Failed to send command");
+		return -3;
+	}
+	return 0;
+}
+
+int getPOSIs(XPCSocket sock, const char ac[], int count, XPCAircraftStates* states)
+{
+	// Validate input
+	if (!ac)
+	{
+		count = 0;
+	}
+	if (count < 0 || count > 20)
+	{
+		printError("getPOSIs", "count should be a value between 0 and 20.");
+		return -1;
+	}
+
+	// Setup command
+	// Format: GETS\0 | count (1) | aircraft (count)
+	char buffer[2048] = "GETS";
+	buffer[5] = (char)count;
+	if (count > 0)
+	{
+		memcpy(buffer + 6, ac, count);
+	}
+
+	// Send command
+	if (sendUDP(sock, buffer, 6 + count) < 0)
+	{
+		printError("getPOSIs", "Failed to send command");
+		return -2;
+	}
+
+	// Read response
+	// Format: ACST\0 | count (1) | reserved (2) | aircraft (n, padded to 8 bytes)
+	//         | lat, lon, h (f64[n] each) | pitch, roll, heading, vx, vy, vz, gear (f32[n] each)
+	// where n is count rounded up to a multiple of 4.
+	int result = readUDP(sock, buffer, 2048);
+	if (result < 0)
+	{
+		printError("getPOSIs", "Read operation failed.");
+		return -3;
+	}
+	if (result < 8 || strncmp(buffer, "ACST", 4) != 0)
+	{
+		printError("getPOSIs", "Unexpected response.");
+		return -4;
+	}
+	int received = (unsigned char)buffer[5];
+	int n = (received + 3) & ~3;
+	int idsSize = (n + 7) & ~7;
+	if (received > 20 || result < 8 + idsSize + 3 * n * 8 + 7 * n * 4)
+	{
+		printError("getPOSIs", "Unexpected response size.");
+		return -5;
+	}
+
+	states->count = received;
+	memcpy(states->aircraft, buffer + 8, received);
+	const char* cur = buffer + 8 + idsSize;
+	double* doubles[3] = { states->lat, states->lon, states->alt };
+	float* floats[7] = { states->pitch, states->roll, states->heading, states->vx, states->vy, states->vz, states->gear };
+	int i; // iterator
+	for (i = 0; i < 3; ++i)
+	{
+		memcpy(doubles[i], cur, received * sizeof(double));
+		cur += n * sizeof(double);
+	}
+	for (i = 0; i < 7; ++i)
+	{
+		memcpy(floats[i], cur, received * sizeof(float));
+		cur += n * sizeof(float);
+	}
+	return 0;
+}
+
+int sendPOSIs(XPCSocket sock, const char ac[], double posi[][7], float ctrl[][7], int count)
+{
+	// Validate input
+	if (count < 1 || count > 20)
+	{
+		printError("sendPOSIs", "count should be a value between 1 and 20.");
+		return -1;
+	}
+
+	// Setup command
+	// Format: BPOS\0 | count (1) | flags (1) | records
+	// Record: aircraft (1) | lat, lon, h (f64) | pitch, roll, heading, gear (f32)
+	//         [ | pitch, roll, yaw, throttle (f32) | gear (i8) | flaps, speedbrake (f32) ]
+	char buffer[7 + 20 * 66] = "BPOS";
+	buffer[5] = (char)count;
+	buffer[6] = ctrl ? 1 : 0;
+	int cur = 7;
+	int i; // iterator
+	for (i = 0; i < count; ++i)
+	{
+		if (ac[i] < 0 || ac[i] > 19)
+		{
+			printError("sendPOSIs", "aircraft should be a value between 0 and 19.");
+			return -2;
+		}
+		buffer[cur++] = ac[i];
+		memcpy(buffer + cur, posi[i], 3 * sizeof(double));
+		cur += 3 * sizeof(double);
+		int j; // iterator
+		for (j = 3; j < 7; ++j)
+		{
+			float f = (float)posi[i][j];
+			memcpy(buffer + cur, &f, sizeof(float));
+			cur += sizeof(float);
+		}
+		if (ctrl)
+		{
+			memcpy(buffer + cur, ctrl[i], 4 * sizeof(float));
+			cur += 4 * sizeof(float);
+			buffer[cur++] = ctrl[i][4] == -998 ? -1 : (char)ctrl[i][4];
+			memcpy(buffer + cur, &ctrl[i][5], 2 * sizeof(float));
+			cur += 2 * sizeof(float);
+		}
+	}
+
+	// Send Command
+	if (sendUDP(sock, buffer, cur) < 0)
+	{
+		printError("sendPOSIs", "Failed to send command");
+		return -3;
+	}
+	return 0;
+}
+
+int sendTPOS(XPCSocket sock, double time, double values[7], double delay, char ac)
+{
+	// Validate input
+	if (ac < 0 || ac > 19)
+	{
+		printError("sendTPOS", "aircraft should be a value between 0 and 19.");
+		return -1;
+	}
+	if (delay < 0 || delay > 65.535)
+	{
+		printError("sendTPOS", "delay should be a value between 0 and 65.535.");
+		return -2;
+	}
+
+	// Setup command
+	// Format: TPOS\0 | aircraft (1) | delay (u16, ms) | time (f64) | lat, lon, h (f64)
+	//         | pitch, roll, heading, gear (f32)
+	char buffer[56] = "TPOS";
+	buffer[5] = ac;
+	unsigned short delayMs = (unsigned short)(delay * 1000 + 0.5);
+	memcpy(buffer + 6, &delayMs, sizeof(delayMs));
+	memcpy(buffer + 8, &time, sizeof(double));
+	memcpy(buffer + 16, values, 3 * sizeof(double));
+	int i; // iterator
+	for (i = 3; i < 7; ++i)
+	{
+		float f = (float)values[i];
+		memcpy(buffer + 40 + (i - 3) * sizeof(float), &f, sizeof(float));
+	}
+
+	// Send Command
+	if (sendUDP(sock, buffer, 56) < 0)
+	{
+		printError("sendTPOS", "Failed to send command");
+		return -3;
+	}
+	return 0;
+}
+/*****************************************************************************/
+/****                        End POSI functions                           ****/
+/*****************************************************************************/
+
+/*****************************************************************************/
+/****                        Playback functions                           ****/
+/*****************************************************************************/
+int sendTRAJ(XPCSocket sock, const double time[], double posi[][7], float ctrl[][7], int count,
+	const char* drefs[], const float drefValues[], int drefCount, char ac)
+{
+	// Chunks sent before waiting for the plugin to confirm them, and attempts at each window.
+	const int WINDOW_CHUNKS = 32;
+	const int ATTEMPTS = 3;
+
+	// Validate input
+	if (ac < 0 || ac > 19)
+	{
+		printError("sendTRAJ", "aircraft should be a value between 0 and 19.");
+		return -1;
+	}
+	if (count < 1 || count > 1048576)
+	{
+		printError("sendTRAJ", "count should be a value between 1 and 1048576.");
+		return -2;
+	}
+	if (drefCount < 0 || drefCount > 16)
+	{
+		printError("sendTRAJ", "drefCount should be a value between 0 and 16.");
+		return -3;
+	}
+
+	// Setup command
+	// Format: TRAJ\0 | aircraft (1) | flags (1) | dref count (1) | total (u32) | first (u32)
+	//         | count (u16) | [drefs] | samples
+	// Sample: time, lat, lon, h (f64) | pitch, roll, heading, gear (f32) | [controls (7 f32)]
+	//         | [dref values (f32)]
+	char buffer[XPC_DEFAULT_MTU + 16 * 256] = "TRAJ";
+	buffer[5] = ac;
+	buffer[7] = (char)drefCount;
+	unsigned int total = (unsigned int)count;
+	memcpy(buffer + 8, &total, 4);
+	int namesLen = 0;
+	int i; // iterator
+	for (i = 0; i < drefCount; ++i)
+	{
+		size_t drefLen = strnlen(drefs[i], 256);
+		if (drefLen > 255)
+		{
+			printError("sendTRAJ", "dref %d is too long.", i);
+			return -4;
+		}
+		namesLen += 1 + (int)drefLen;
+	}
+	int sampleSize = 48 + (ctrl ? 28 : 0) + 4 * drefCount;
+	int perChunk = (XPC_DEFAULT_MTU - 18) / sampleSize;
+
+	int windowStart = 0;
+	while (windowStart < count)
+	{
+		int attempt;
+		int windowEnd = windowStart;
+		for (attempt = 0; attempt < ATTEMPTS; ++attempt)
+		{
+			int chunk;
+			int first = windowStart;
+			for (chunk = 0; chunk < WINDOW_CHUNKS && first < count; ++chunk)
+			{
+				int cur = 18;
+				int n = perChunk;
+				char flags = ctrl ? 1 : 0;
+				if (first == 0)
+				{
+					// The first chunk begins the upload and names the datarefs.
+					flags |= 2;
+					for (i = 0; i < drefCount; ++i)
+					{
+						size_t drefLen = strlen(drefs[i]);
+						buffer[cur++] = (unsigned char)drefLen;
+						memcpy(buffer + cur, drefs[i], drefLen);
+						cur += (int)drefLen;
+					}
+					n = (XPC_DEFAULT_MTU - 18 - namesLen) / sampleSize;
+					n = n < 1 ? 1 : n;
+				}
+				n = n < count - first ? n : count - first;
+				if (chunk == WINDOW_CHUNKS - 1 || first + n == count)
+				{
+					flags |= 4;
+				}
+				buffer[6] = flags;
+				unsigned int firstIndex = (unsigned int)first;
+				unsigned short chunkCount = (unsigned short)n;
+				memcpy(buffer + 12, &firstIndex, 4);
+				memcpy(buffer + 16, &chunkCount, 2);
+				for (i = first; i < first + n; ++i)
+				{
+					memcpy(buffer + cur, &time[i], sizeof(double));
+					memcpy(buffer + cur + 8, posi[i], 3 * sizeof(double));
+					cur += 32;
+					int j; // iterator
+					for (j = 3; j < 7; ++j)
+					{
+						float f = (float)posi[i][j];
+						memcpy(buffer + cur, &f, sizeof(float));
+						cur += sizeof(float);
+					}
+					if (ctrl)
+					{
+						memcpy(buffer + cur, ctrl[i], 7 * sizeof(float));
+						cur += 7 * sizeof(float);
+					}
+					if (drefCount > 0)
+					{
+						memcpy(buffer + cur, drefValues + (size_t)i * drefCount, drefCount * sizeof(float));
+						cur += drefCount * sizeof(float);
+					}
+				}
+				if (sendUDP(sock, buffer, cur) < 0)
+				{
+					printError("sendTRAJ", "Failed to send command");
+					return -5;
+				}
+				first += n;
+			}
+			windowEnd = first;
+
+			// Wait for the plugin to confirm the window.
+			// Format: TRAK\0 | aircraft (1) | received (i32)
+			char reply[10];
+			int received = -1;
+			if (readUDP(sock, reply, 10) == 10 && strncmp(reply, "TRAK", 4) == 0)
+			{
+				memcpy(&received, reply + 6, 4);
+			}
+			if (received >= windowEnd)
+			{
+				break;
+			}
+		}
+		if (attempt == ATTEMPTS)
+		{
+			printError("sendTRAJ", "The plugin did not confirm samples %d-%d.", windowStart, windowEnd);
+			return -6;
+		}
+		windowStart = windowEnd;
+	}
+	return 0;
+}
+
+int sendPLAY(XPCSocket sock, PLAY_OP op, double value, char ac)
+{
+	// Validate input
+	if (ac < 0 || ac > 19)
+	{
+		printError("sendPLAY", "aircraft should be a value between 0 and 19.");
+		return -1;
+	}
+
+	// Setup command
+	// Format: PLAY\0 | aircraft (1) | op (1) | value (f64)
+	char buffer[15] = "PLAY";
+	buffer[5] = ac;
+	buffer[6] = (char)op;
+	memcpy(buffer + 7, &value, sizeof(double));
+
+	// Send Command
+	if (sendUDP(sock, buffer, 15) < 0)
+	{
+		printError("sendPLAY", "Failed to send command");
+		return -2;
+	}
+	return 0;
+}
+/*****************************************************************************/
+/****                      End Playback functions                         ****/
+/*****************************************************************************/
+
+/*****************************************************************************/
+/****                       Recording functions                           ****/
+/*****************************************************************************/
+int startRECD(XPCSocket sock, const char* path, const char* drefs[], unsigned char count, unsigned short divisor)
+{
+	// Validate input
+	if (count == 0)
+	{
+		printError("startRECD", "count should be a value between 1 and 255.");
+		return -1;
+	}
+	if (divisor == 0)
+	{
+		printError("startRECD", "divisor should be at least 1.");
+		return -2;
+	}
+	size_t pathLen = strnlen(path, 256);
+	if (pathLen > 255)
+	{
+		printError("startRECD", "path is too long.");
+		return -3;
+	}
+
+	// Setup command
+	// Format: RECD\0 | op (1) | divisor (u16) | count (1) | path length (1) | path | drefs
+	char buffer[65536] = "RECD";
+	buffer[5] = 1;
+	memcpy(buffer + 6, &divisor, 2);
+	buffer[8] = count;
+	buffer[9] = (unsigned char)pathLen;
+	memcpy(buffer + 10, path, pathLen);
+	int len = 10 + (int)pathLen;
+	int i; // Iterator
+	for (i = 0; i < count; ++i)
+	{
+		size_t drefLen = strnlen(drefs[i], 256);
+		if (drefLen > 255)
+		{
+			printError("startRECD", "dref %d is too long.", i);
+			return -4;
+		}
+		buffer[len++] = (unsigned char)drefLen;
+		memcpy(buffer + len, drefs[i], drefLen);
+		len += (int)drefLen;
+	}
+
+	// Send Command
+	if (sendUDP(sock, buffer, len) < 0)
+	{
+		printError("startRECD", "Failed to send command");
+		return -5;
+	}
+	return 0;
+}
+
+int stopRECD(XPCSocket sock)
+{
+	// Format: RECD\0 | op (1)
+	char buffer[6] = "RECD";
+	buffer[5] = 2;
+	if (sendUDP(sock, buffer, 6) < 0)
+	{
+		printError("stopRECD", "Failed to send command");
+		return -1;
+	}
+	return 0;
+}
+
+int getRECD(XPCSocket sock, XPCRecorderStatus* status)
+{
+	// Send request
+	// Format: RECD\0 | op (1)
+	char buffer[32] = "RECD";
+	buffer[5] = 3;
+	if (sendUDP(sock, buffer, 6) < 0)
+	{
+		printError("getRECD", "Failed to send command");
+		return -1;
+	}
+
+	// Read response
+	// Format: RECS\0 | state (1) | reserved (2) | samples (u64) | written (u64) | dropped (u64)
+	int result = readUDP(sock, buffer, 32);
+	if (result < 32 || strncmp(buffer, "RECS", 4) != 0)
+	{
+		printError("getRECD", "Failed to read response.");
+		return -2;
+	}
+	status->state = buffer[5];
+	memcpy(&status->samples, buffer + 8, 8);
+	memcpy(&status->written, buffer + 16, 8);
+	memcpy(&status->dropped, buffer + 24, 8);
+	return 0;
+}
+/*****************************************************************************/
+/****                     End Recording functions                         ****/
+/*****************************************************************************/
+
+/*****************************************************************************/
+/****                        History functions                            ****/
+/*****************************************************************************/
+int setHIST(XPCSocket sock, float seconds, const char* drefs[], unsigned char count)
+{
+	// Setup command
+	// Format: HIST\0 | op (1) | seconds (f32) | count (1) | drefs
+	char buffer[65536] = "HIST";
+	buffer[5] = 1;
+	memcpy(buffer + 6, &seconds, sizeof(float));
+	buffer[10] = count;
+	int len = 11;
+	int i; // Iterator
+	for (i = 0; i < count; ++i)
+	{
+		size_t drefLen = strnlen(drefs[i], 256);
+		if (drefLen > 255)
+		{
+			printError("setHIST", "dref %d is too long.", i);
+			return -1;
+		}
+		buffer[len++] = (unsigned char)drefLen;
+		memcpy(buffer + len, drefs[i], drefLen);
+		len += (int)drefLen;
+	}
+
+	// Send Command
+	if (sendUDP(sock, buffer, len) < 0)
+	{
+		printError("setHIST", "Failed to send command");
+		return -2;
+	}
+	return 0;
+}
+
+int getHIST(XPCSocket sock, double from, double to, int relative, double times[], int rows, float values[],
+	int size, int* width)
+{
+	static unsigned short lastSeq = 0;
+	FragmentReader reader;
+	unsigned short mtu = XPC_DEFAULT_MTU;
+	unsigned int offset = 0;
+	unsigned int totalRows = 0;
+	char buffer[65536] = "HIST";
+	*width = 0;
+
+	// Large ranges come back a page at a time. Each page after the first is
+	// requested with the absolute times the plugin resolved for the first.
+	for (;;)
+	{
+		unsigned short seq = ++lastSeq;
+
+		// Setup command
+		// Format: HIST\0 | op (1) | seq (2) | mtu (2) | flags (1) | from (f64) | to (f64) | offset (u32)
+		memcpy(buffer, "HIST", 5);
+		buffer[5] = 2;
+		memcpy(buffer + 6, &seq, 2);
+		memcpy(buffer + 8, &mtu, 2);
+		buffer[10] = relative ? 1 : 0;
+		memcpy(buffer + 11, &from, sizeof(double));
+		memcpy(buffer + 19, &to, sizeof(double));
+		memcpy(buffer + 27, &offset, 4);
+
+		// Send command
+		if (sendUDP(sock, buffer, 31) < 0)
+		{
+			printError("getHIST", "Failed to send command");
+			return -1;
+		}
+
+		// Read response
+		// Format: HISR\0 | seq (2) | index (u16) | total (u16) | width (u16) | rows (u16) | flags (1)
+		//         | first row (u32) | total rows (u32) | from (f64) | to (f64)
+		//         | rows: time (f64) | values (width * f32)
+		// Flags: 1 a row doesn't fit in mtu bytes, so no rows were sent
+		beginFragments(&reader, "HISR", seq, 40, 1);
+		unsigned int pageEnd = offset;
+		int tooWide = 0;
+		while (reader.total < 0 || reader.seen < reader.total)
+		{
+			int index;
+			int result = readFragment(sock, "getHIST", &reader, buffer, &index);
+			if (result < 0)
+			{
+				return result == -2 ? -4 : -2;
+			}
+			tooWide = buffer[15] & 1;
+			unsigned short header[4]; // index, total, width, rows
+			unsigned int firstRow;
+			memcpy(header, buffer + 7, sizeof(header));
+			memcpy(&firstRow, buffer + 16, 4);
+			memcpy(&totalRows, buffer + 20, 4);
+			memcpy(&from, buffer + 24, sizeof(double));
+			memcpy(&to, buffer + 32, sizeof(double));
+			int rowSize = (int)sizeof(double) + header[2] * (int)sizeof(float);
+			if (40 + header[3] * rowSize > result)
+			{
+				printError("getHIST", "Fragment %d is malformed.", index);
+				return -3;
+			}
+			*width = header[2];
+			if (firstRow + header[3] > pageEnd)
+			{
+				pageEnd = firstRow + header[3];
+			}
+
+			// Copy as many rows as we have room for.
+			int cur = 40;
+			int i; // Iterator
+			for (i = 0; i < header[3]; ++i, cur += rowSize)
+			{
+				long long row = (long long)firstRow + i;
+				if (row >= rows || (row + 1) * header[2] > size)
+				{
+					break;
+				}
+				memcpy(times + row, buffer + cur, sizeof(double));
+				memcpy(values + row * header[2], buffer + cur + sizeof(double), header[2] * sizeof(float));
+			}
+		}
+
+		// Rows too wide for the default MTU are sent in the largest datagrams
+		// UDP allows instead, leaving it to IP to fragment them.
+		if (tooWide)
+		{
+			if (mtu == XPC_MAX_MTU)
+			{
+				printError("getHIST", "Rows of %d values are too large to send.", *width);
+				return -5;
+			}
+			mtu = XPC_MAX_MTU;
+			relative = 0;
+			continue;
+		}
+
+		// Stop once every row has arrived or there is no room for more.
+		if (pageEnd <= offset || pageEnd >= totalRows || pageEnd >= (unsigned int)rows
+			|| (*width > 0 && (long long)pageEnd * *width >= size))
+		{
+			break;
+		}
+		offset = pageEnd;
+		relative = 0;
+	}
+
+	long long stored = totalRows;
+	if (stored > rows)
+	{
+		stored = rows;
+	}
+	if (*width > 0 && stored > size / *width)
+	{
+		stored = size / *width;
+	}
+	if (stored < totalRows)
+	{
+		printError("getHIST", "times or values is too small. Got %u rows of %d values, only stored %d.",
+			totalRows, *width, (int)stored);
+	}
+	return (int)stored;
+}
+/*****************************************************************************/
+/****                      End History functions                          ****/
+/*****************************************************************************/
+
+/*****************************************************************************/
+/****                          TERR functions                             ****/
+/*****************************************************************************/
+int sendTERRRequest(XPCSocket sock, double posi[3], char ac)
+{
+	// Setup send command
+	char buffer[30] = "GETT";
+	buffer[5] = ac;
+	memcpy(&buffer[6], posi, 3 * sizeof(double));
+
+	// Send command
+	if (sendUDP(sock, buffer, 30) < 0)
+	{
+		printError("getTERR", "Failed to send command.");
+		return -1;
 	}
 	return 0;
 }
@@ -694,6 +1999,81 @@ int getTERRResponse(XPCSocket sock, double values[11], char ac)
 	return 0;
 }
 
+int getTERRs(XPCSocket sock, double points[][3], int count, double values[][11])
+{
+	static unsigned short lastSeq = 0;
+	unsigned short seq = ++lastSeq;
+	unsigned short mtu = XPC_DEFAULT_MTU;
+
+	// Validate input
+	if (count < 0 || count > 2729)
+	{
+		printError("getTERRs", "count should be a value between 0 and 2729.");
+		return -1;
+	}
+
+	// Setup command
+	// Format: GTRS\0 | seq (2) | mtu (2) | count (u16) | points: lat, lon, alt (f64 each)
+	char buffer[65536] = "GTRS";
+	unsigned short n = (unsigned short)count;
+	memcpy(buffer + 5, &seq, 2);
+	memcpy(buffer + 7, &mtu, 2);
+	memcpy(buffer + 9, &n, 2);
+	memcpy(buffer + 11, points, count * 3 * sizeof(double));
+
+	// Send command
+	if (sendUDP(sock, buffer, 11 + count * 3 * (int)sizeof(double)) < 0)
+	{
+		printError("getTERRs", "Failed to send command");
+		return -2;
+	}
+
+	// Read response
+	// Format: TERS\0 | seq (2) | index (u16) | total (u16) | first point (u16) | points (u16)
+	//         | reserved (1) | points: lat, lon, alt (f64 each) | normal x, y, z (f32 each)
+	//         | velocity x, y, z (f32 each) | wet (i32) | probe result (i32)
+	FragmentReader reader;
+	beginFragments(&reader, "TERS", seq, 16, 1);
+	while (reader.total < 0 || reader.seen < reader.total)
+	{
+		int index;
+		int result = readFragment(sock, "getTERRs", &reader, buffer, &index);
+		if (result < 0)
+		{
+			return result == -2 ? -5 : -3;
+		}
+		unsigned short header[4]; // index, total, first point, points
+		memcpy(header, buffer + 7, sizeof(header));
+		if (16 + header[3] * 56 > result || header[2] + header[3] > count)
+		{
+			printError("getTERRs", "Fragment %d is malformed.", index);
+			return -4;
+		}
+
+		int i; // Iterator
+		for (i = 0; i < header[3]; ++i)
+		{
+			const char* point = buffer + 16 + i * 56;
+			double* row = values[header[2] + i];
+			float f[6];
+			int wet;
+			int rc;
+			memcpy(row, point, 3 * sizeof(double));
+			memcpy(f, point + 24, 6 * sizeof(float));
+			memcpy(&wet, point + 48, sizeof(int));
+			memcpy(&rc, point + 52, sizeof(int));
+			int j; // Iterator
+			for (j = 0; j < 6; ++j)
+			{
+				row[3 + j] = (double)f[j];
+			}
+			row[9] = (double)wet;
+			row[10] = (double)rc;
+		}
+	}
+	return 0;
+}
+
 int sendPOST(XPCSocket sock, double posi[], int size, double values[11], char ac)
 {
 	// Validate input
@@ -55,6 +55,108 @@ typedef struct xpcSocket
 #endif
 } XPCSocket;
 
+/// The id returned by resolveDREFs for datarefs that do not exist.
+#define XPC_INVALID_DREF_ID 0xFFFF
+
+/// The largest datagram getDREFsFragmented asks the plugin to send by default. Fits in a standard
+/// Ethernet frame with the IP and UDP headers.
+#define XPC_DEFAULT_MTU 1472
+
+/// The largest datagram the plugin can be asked to send.
+#define XPC_MAX_MTU 65507
+
+/// How long functions that read responses spanning several datagrams wait for the next datagram
+/// before giving up, in milliseconds.
+#define XPC_FRAGMENT_TIMEOUT_MS 2000
+
+typedef enum
+{
+	XPC_TYPE_NONE = 0,
+	XPC_TYPE_INT = 1,
+	XPC_TYPE_FLOAT = 2,
+	XPC_TYPE_DOUBLE = 3,
+	XPC_TYPE_BYTES = 4
+} DREF_TYPE;
+
+/// Handling time statistics for one kind of work done by the plugin, as returned by getLatency.
+typedef struct
+{
+	/// The message header, or "loop" for the whole flight loop callback and "wait" for the time
+	/// messages wait to be handled after they are received.
+	char name[5];
+	/// The number of times recorded.
+	unsigned int count;
+	/// Percentiles and maximum of the recorded times, in microseconds.
+	float p50;
+	float p99;
+	float p999;
+	float max;
+} XPCLatency;
+
+/// Health counters kept by the plugin, as returned by getSTATS. All counts are totals since the
+/// plugin was enabled.
+typedef struct
+{
+	unsigned long long datagramsReceived;
+	unsigned long long bytesReceived;
+	unsigned long long receiveErrors;
+	/// Datagrams discarded because they were too short to be messages.
+	unsigned long long runtsDropped;
+	unsigned long long messagesHandled;
+	/// Messages with a header that the plugin does not recognize.
+	unsigned long long unknownMessages;
+	/// Frames in which the plugin ran out of time and left messages for the next frame.
+	unsigned long long budgetExhausted;
+	/// Requests for datarefs that do not exist.
+	unsigned long long invalidDrefs;
+	unsigned long long datagramsSent;
+	unsigned long long bytesSent;
+	unsigned long long sendErrors;
+	/// The number of clients the plugin currently has connection records for.
+	unsigned long long connections;
+	/// Lines left out of the plugin log because it could not keep up.
+	unsigned long long logLinesDropped;
+} XPCStats;
+
+/// The state of several aircraft, as returned by getPOSIs. Each field holds one value per aircraft,
+/// in the same order as aircraft.
+typedef struct
+{
+	/// The number of aircraft.
+	int count;
+	/// The aircraft numbers. 0 is the main/user's aircraft.
+	char aircraft[20];
+	/// Position in degrees and meters above sea level.
+	double lat[20];
+	double lon[20];
+	double alt[20];
+	/// Orientation in degrees.
+	float pitch[20];
+	float roll[20];
+	float heading[20];
+	/// Velocity in meters per second along the local OpenGL axes.
+	float vx[20];
+	float vy[20];
+	float vz[20];
+	/// Gear deployment ratio.
+	float gear[20];
+} XPCAircraftStates;
+
+/// The state of the plugin's recorder, as returned by getRECD.
+typedef struct
+{
+	/// 0 if the recorder is idle, 1 if it is recording, and 2 if the recording could not be
+	/// written.
+	int state;
+	/// The number of samples taken by the current or last recording.
+	unsigned long long samples;
+	/// The number of samples written to the recording file.
+	unsigned long long written;
+	/// The number of samples dropped because the plugin could not write them fast enough or the
+	/// file could not be written.
+	unsigned long long dropped;
+} XPCRecorderStatus;
+
 typedef enum
 {
 	XPC_WYPT_ADD = 1,
@@ -62,6 +164,16 @@ typedef enum
 	XPC_WYPT_CLR = 3
 } WYPT_OP;
 
+typedef enum
+{
+	XPC_PLAY_STOP = 0,
+	XPC_PLAY_START = 1,
+	XPC_PLAY_PAUSE = 2,
+	XPC_PLAY_RESUME = 3,
+	XPC_PLAY_SEEK = 4,
+	XPC_PLAY_RATE = 5
+} PLAY_OP;
+
 typedef enum
 {
 	XPC_VIEW_FORWARDS = 73,
@@ -116,6 +228,33 @@ int setCONN(XPCSocket* sock, unsigned short port);
 /// \returns     0 if successful, otherwise a negative value.
 int pauseSim(XPCSocket sock, char pause);
 
+/// Sets how much detail the plugin writes to its log file.
+///
+/// \details Levels are 0 (off), 1 (fatal), 2 (error), 3 (warn), 4 (info), 5 (debug) and
+///          6 (trace). The plugin never logs more than the level it was built with.
+/// \param sock  The socket to use to send the command.
+/// \param level The most verbose level to write.
+/// \returns     0 if successful, otherwise a negative value.
+int setLogLevel(XPCSocket sock, unsigned char level);
+
+/// Gets statistics about how long the plugin takes to handle each type of message.
+///
+/// \param sock  The socket to use to send the command and receive the response.
+/// \param stats An array in which the statistics will be stored.
+/// \param count The number of elements in stats. Set to the number of elements filled in.
+/// \param reset Non-zero to clear the statistics in the plugin once they have been read.
+/// \returns     0 if successful, otherwise a negative value.
+int getLatency(XPCSocket sock, XPCLatency stats[], int* count, char reset);
+
+/// Gets the plugin's health counters.
+///
+/// \details Counters that the plugin does not report, such as when talking to an older version,
+///          are set to 0.
+/// \param sock  The socket to use to send the command and receive the response.
+/// \param stats The location in which the counters will be stored.
+/// \returns     0 if successful, otherwise a negative value.
+int getSTATS(XPCSocket sock, XPCStats* stats);
+
 // X-Plane UDP DATA
 
 /// Reads X-Plane data from the specified socket.
@@ -194,6 +333,133 @@ int getDREF(XPCSocket sock, const char* dref, float values[], int* size);
 /// \returns      0 if successful, otherwise a negative value.
 int getDREFs(XPCSocket sock, const char* drefs[], float* values[], unsigned char count, int sizes[]);
 
+/// Gets the values of the specified datarefs in their native types.
+///
+/// \details Unlike getDREFs, the plugin sends each dataref in the type X-Plane stores it in, so
+///          large integers and doubles such as sim/flightmodel/position/latitude arrive without
+///          losing precision. Every type is converted to double, which holds all of them exactly.
+///          Byte array datarefs are returned one byte per element.
+/// \param sock   The socket to use to send the command.
+/// \param drefs  The names of the datarefs to get.
+/// \param values A 2D array in which the values of the datarefs will be stored.
+/// \param types  An array in which the type of each dataref will be stored, or NULL. Datarefs
+///               that do not exist have the type XPC_TYPE_NONE.
+/// \param count  The number of datarefs being requested.
+/// \param sizes  The number of elements in each row of values. The size of each row will be set
+///               to the actual number of elements copied in for that row.
+/// \returns      0 if successful, otherwise a negative value.
+int getDREFsTyped(XPCSocket sock, const char* drefs[], double* values[], DREF_TYPE types[], unsigned char count, int sizes[]);
+
+/// Gets the values of the specified datarefs, allowing the response to span several datagrams.
+///
+/// \details Use this instead of getDREFs when the values might not fit in one datagram, e.g. when
+///          requesting many large arrays. The plugin splits the response into datagrams of at
+///          most mtu bytes, so they are never fragmented by IP. Each datagram is copied straight
+///          into values as it arrives, in whatever order they arrive.
+/// \param sock   The socket to use to send the command.
+/// \param drefs  The names of the datarefs to get.
+/// \param values A 2D array in which the values of the datarefs will be stored.
+/// \param count  The number of datarefs being requested.
+/// \param sizes  The number of elements in each row of values. The size of each row will be set
+///               to the actual number of elements copied in for that row.
+/// \param mtu    The largest datagram the plugin should send, in bytes, or 0 to use
+///               XPC_DEFAULT_MTU.
+/// \returns      0 if successful, otherwise a negative value. If a row had more elements than
+///               values had room for, the values that fit are still stored and -6 is returned.
+///               If no datagram of the response arrives for XPC_FRAGMENT_TIMEOUT_MS, -7 is
+///               returned. The plugin doesn't respond if mtu is too small or the response would
+///               need more than 255 datagrams.
+int getDREFsFragmented(XPCSocket sock, const char* drefs[], float* values[], unsigned char count, int sizes[],
+	unsigned short mtu);
+
+/// Looks up the specified datarefs and gets numeric ids that can be used to get and set them
+/// without sending their names.
+///
+/// \details Ids are assigned by the plugin to the connection, so they are only valid for sock.
+///          Resolving a dataref that was already resolved returns the same id.
+/// \param sock  The socket to use to send the command and receive the response.
+/// \param drefs The names of the datarefs to resolve.
+/// \param ids   An array in which the ids of the datarefs will be stored. Datarefs that do not
+///              exist are given the id XPC_INVALID_DREF_ID.
+/// \param sizes An array in which the number of elements in each dataref will be stored, or
+///              NULL.
+/// \param count The number of datarefs to resolve.
+/// \returns     0 if successful, otherwise a negative value.
+int resolveDREFs(XPCSocket sock, const char* drefs[], unsigned short ids[], int sizes[], unsigned char count);
+
+/// Gets the values of datarefs previously resolved with resolveDREFs.
+///
+/// \param sock   The socket used to resolve the datarefs.
+/// \param ids    The ids of the datarefs to get.
+/// \param values A 2D array in which the values of the datarefs will be stored.
+/// \param count  The number of datarefs being requested.
+/// \param sizes  The number of elements in each row of values. The size of each row will be set
+///               to the actual number of elements copied in for that row.
+/// \returns      0 if successful, otherwise a negative value.
+int getDREFsById(XPCSocket sock, const unsigned short ids[], float* values[], unsigned char count, int sizes[]);
+
+/// Sets the values of datarefs previously resolved with resolveDREFs.
+///
+/// \param sock   The socket used to resolve the datarefs.
+/// \param ids    The ids of the datarefs to set.
+/// \param values A 2D array containing the values for each dataref to set.
+/// \param sizes  The number of elements in each array in values
+/// \param count  The number of datarefs being set.
+/// \returns      0 if successful, otherwise a negative value.
+int sendDREFsById(XPCSocket sock, const unsigned short ids[], float* values[], int sizes[], int count);
+
+/// Subscribes to the values of the specified datarefs. Once subscribed, the plugin sends the
+/// values every divisor frames without being asked. Use readDREFs to receive them.
+///
+/// \details The subscription is cancelled if the plugin does not receive any message from the
+///          client for 30 seconds. To keep a subscription alive, or to change its rate, call this
+///          function again with count set to 0. The previous list of datarefs is kept.
+/// \param sock    The socket to use to send the command.
+/// \param drefs   The names of the datarefs to subscribe to.
+/// \param count   The number of datarefs, or 0 to renew the previous subscription.
+/// \param divisor The number of frames between updates. Must be at least 1.
+/// \param port    The port to send updates to, or 0 to send them to the port of sock.
+/// \returns       0 if successful, otherwise a negative value.
+int subscribeDREFs(XPCSocket sock, const char* drefs[], unsigned char count, unsigned short divisor, unsigned short port);
+
+/// Subscribes to changes in the values of the specified datarefs.
+///
+/// \details Works like subscribeDREFs, except that after the first update the plugin only sends
+///          the elements that have moved further than their deadband since they were last sent,
+///          plus a full update every keyframe updates. Nothing is sent when no values change.
+///          readDREFs applies these partial updates to values, so the arrays passed to it act as
+///          a local cache and must be kept between calls.
+/// \param sock      The socket to use to send the command.
+/// \param drefs     The names of the datarefs to subscribe to.
+/// \param deadbands How far each dataref must move before it is sent again. Use 0 to send any
+///                  change.
+/// \param count     The number of datarefs, or 0 to renew the previous subscription.
+/// \param divisor   The number of frames between checks for changes. Must be at least 1.
+/// \param keyframe  The number of updates between full updates, or 0 to use the plugin's default
+///                  of 100. Full updates resynchronize the values if a partial update is lost.
+/// \param port      The port to send updates to, or 0 to send them to the port of sock.
+/// \returns         0 if successful, otherwise a negative value.
+int subscribeDREFChanges(XPCSocket sock, const char* drefs[], float deadbands[], unsigned char count,
+	unsigned short divisor, unsigned short keyframe, unsigned short port);
+
+/// Cancels the dataref subscription for the specified socket.
+///
+/// \param sock The socket used to subscribe.
+/// \returns    0 if successful, otherwise a negative value.
+int unsubscribeDREFs(XPCSocket sock);
+
+/// Reads the next update for a dataref subscription. Full updates overwrite values. Partial
+/// updates from subscribeDREFChanges only overwrite the elements that changed.
+///
+/// \param sock   The socket updates are sent to.
+/// \param values A 2D array in which the values of the datarefs will be stored.
+/// \param count  The number of datarefs subscribed to.
+/// \param sizes  The number of elements in each row of values. The size of each row will be set
+///               to the actual number of elements copied in for that row.
+/// \returns      1 if an update was read, 0 if no update arrived before the read timed out,
+///               otherwise a negative value.
+int readDREFs(XPCSocket sock, float* values[], unsigned char count, int sizes[]);
+
 // Position
 
 /// Gets the position and orientation of the specified aircraft.
@@ -216,6 +482,154 @@ int getPOSI(XPCSocket sock, double values[7], char ac);
 /// \returns      0 if successful, otherwise a negative value.
 int sendPOSI(XPCSocket sock, double values[], int size, char ac);
 
+/// Gets the position, orientation, velocity and gear of several aircraft with a single request.
+///
+/// \details All values are read by the plugin in the same frame, so they are consistent with
+///          each other. This replaces one getPOSI call per aircraft.
+/// \param sock   The socket used to send the command and receive the response.
+/// \param ac     The aircraft numbers to get, or NULL to get all 20 aircraft.
+/// \param count  The number of aircraft in ac. Ignored if ac is NULL.
+/// \param states The location in which the states will be stored.
+/// \returns      0 if successful, otherwise a negative value.
+int getPOSIs(XPCSocket sock, const char ac[], int count, XPCAircraftStates* states);
+
+/// Sets the position and orientation, and optionally the control surfaces, of several aircraft
+/// with a single message.
+///
+/// \details This is equivalent to calling sendPOSI and sendCTRL for each aircraft, but the plugin
+///          receives everything in one datagram and applies it in one pass. Values of -998 are
+///          left unchanged, as for sendPOSI and sendCTRL.
+/// \param sock  The socket to use to send the command.
+/// \param ac    The aircraft numbers to set. 0 for the main/user's aircraft.
+/// \param posi  The position of each aircraft, in the format used by sendPOSI:
+///              [Lat, Lon, Alt, Pitch, Roll, Yaw, Gear].
+/// \param ctrl  The controls of each aircraft, in the format used by sendCTRL: [Elevator, Aileron,
+///              Rudder, Throttle, Gear, Flaps, Speed Brakes], or NULL to leave controls unchanged.
+/// \param count The number of aircraft to set, between 1 and 20.
+/// \returns     0 if successful, otherwise a negative value.
+int sendPOSIs(XPCSocket sock, const char ac[], double posi[][7], float ctrl[][7], int count);
+
+/// Sends a timestamped state for an aircraft, which the plugin moves the aircraft along smoothly.
+///
+/// \details Unlike sendPOSI, the aircraft is not moved immediately. The plugin keeps the last few
+///          states sent for each aircraft and moves the aircraft every frame to where it should be,
+///          interpolating between states. Clients that can only send positions a few times a second
+///          should use this instead of sendPOSI. Times are on the client's clock; the plugin
+///          estimates the offset to its own clock. Calling sendPOSI or sendPOSIs for the aircraft
+///          stops the smoothing.
+/// \param sock   The socket to use to send the command.
+/// \param time   The time of the state in seconds. Must increase from one state to the next.
+/// \param values The state in the format used by sendPOSI: [Lat, Lon, Alt, Pitch, Roll, Yaw, Gear].
+///               Unlike sendPOSI, all values except gear are required.
+/// \param delay  How far behind the newest state the aircraft is placed, in seconds. About one and
+///               a half times the interval between states gives smooth motion. 0 places the
+///               aircraft at the newest state, extrapolating from the previous ones.
+/// \param ac     The aircraft number. 0 for the main/user's aircraft.
+/// \returns      0 if successful, otherwise a negative value.
+int sendTPOS(XPCSocket sock, double time, double values[7], double delay, char ac);
+
+/// Uploads a trajectory for an aircraft, to be played back by the plugin with sendPLAY.
+///
+/// \details The trajectory is sent in chunks, and the plugin confirms every few chunks that it has
+///          received them. Chunks that are lost are sent again. Once uploaded, the trajectory can be
+///          played any number of times without further network traffic. Uploading a trajectory
+///          replaces any trajectory the aircraft already has and stops its playback.
+/// \param sock       The socket to use to send the command.
+/// \param time       The time of each sample in seconds. Must increase from one sample to the next.
+/// \param posi       The state at each sample in the format used by sendPOSI: [Lat, Lon, Alt, Pitch,
+///                   Roll, Yaw, Gear].
+/// \param ctrl       The controls at each sample in the format used by sendCTRL: [Elevator, Aileron,
+///                   Rudder, Throttle, Gear, Flaps, Speed Brakes], or NULL to leave controls unchanged.
+/// \param count      The number of samples, between 1 and 1048576.
+/// \param drefs      The names of datarefs to set during playback, or NULL.
+/// \param drefValues The value of each dataref at each sample: drefCount values for the first sample,
+///                   then drefCount values for the second, and so on.
+/// \param drefCount  The number of datarefs, between 0 and 16.
+/// \param ac         The aircraft number. 0 for the main/user's aircraft.
+/// \returns          0 if successful, otherwise a negative value.
+int sendTRAJ(XPCSocket sock, const double time[], double posi[][7], float ctrl[][7], int count,
+	const char* drefs[], const float drefValues[], int drefCount, char ac);
+
+/// Controls playback of a trajectory uploaded with sendTRAJ.
+///
+/// \details Playback follows X-Plane's flight time, so it stops while the simulation is paused.
+///          Calling sendPOSI, sendPOSIs or sendTPOS for the aircraft stops playback.
+/// \param sock  The socket to use to send the command.
+/// \param op    The operation to perform. XPC_PLAY_START and XPC_PLAY_SEEK go to the trajectory time
+///              given by value. XPC_PLAY_RATE sets how fast playback runs relative to flight time;
+///              negative rates play backwards. Playback starts at a rate of 1.
+/// \param value The time in seconds or the rate, depending on op. Ignored by other operations.
+/// \param ac    The aircraft number. 0 for the main/user's aircraft.
+/// \returns     0 if successful, otherwise a negative value.
+int sendPLAY(XPCSocket sock, PLAY_OP op, double value, char ac);
+
+// Recording
+
+/// Starts recording datarefs in the plugin, stopping any recording in progress.
+///
+/// \details The plugin samples the datarefs in the flight loop and writes them to a recording file
+///          in the format read by openRecording in xplaneRecording.h. Sample times are X-Plane's
+///          total running time in seconds. Use getRECD to check that recording started.
+/// \param sock    The socket to use to send the command.
+/// \param path    The file name of the recording. The plugin writes recordings to
+///                Output/XPlaneConnect in the X-Plane directory, so the name must not contain path
+///                separators or "..".
+/// \param drefs   The names of the datarefs to record.
+/// \param count   The number of datarefs, between 1 and 255.
+/// \param divisor Record every divisor'th frame. 1 records every frame.
+/// \returns       0 if successful, otherwise a negative value. The plugin won't start a new
+///                recording until the last one has been finished.
+int startRECD(XPCSocket sock, const char* path, const char* drefs[], unsigned char count, unsigned short divisor);
+
+/// Stops recording in the plugin and finishes the recording file.
+///
+/// \details The plugin finishes the file in the background. getRECD reports that the recorder is
+///          recording until it is done.
+/// \param sock The socket to use to send the command.
+/// \returns    0 if successful, otherwise a negative value.
+int stopRECD(XPCSocket sock);
+
+/// Gets the state of the plugin's recorder.
+///
+/// \param sock   The socket to use to send the command.
+/// \param status The location in which the state will be stored.
+/// \returns      0 if successful, otherwise a negative value.
+int getRECD(XPCSocket sock, XPCRecorderStatus* status);
+
+/// Starts keeping a rolling history of datarefs in the plugin, discarding any history kept so far.
+///
+/// \details The plugin stores the values of the datarefs every frame, so getHIST can fetch what
+///          happened in the last few seconds at full frame rate without polling. Times are
+///          the sim's flight time in seconds, so nothing is kept while the sim is paused.
+/// \param sock    The socket to use to send the command.
+/// \param seconds How many seconds of history to keep.
+/// \param drefs   The names of the datarefs to keep history for.
+/// \param count   The number of datarefs. 0 stops keeping history.
+/// \returns       0 if successful, otherwise a negative value.
+int setHIST(XPCSocket sock, float seconds, const char* drefs[], unsigned char count);
+
+/// Gets the rows of history kept since setHIST with times in a range.
+///
+/// \details Each row holds the values of every dataref passed to setHIST, in order. Datarefs that
+///          don't exist have no values. The plugin sends large ranges a page at a time, and getHIST
+///          requests pages until every row has arrived or times and values are full. Rows too wide
+///          for XPC_DEFAULT_MTU are requested in datagrams of up to XPC_MAX_MTU bytes.
+/// \param sock     The socket to use to send the command.
+/// \param from     The earliest time to get.
+/// \param to       The latest time to get.
+/// \param relative If non-zero, from and to are relative to the time of the newest row, so -1 and 0
+///                 get the last second of history.
+/// \param times    An array in which the time of each row will be stored.
+/// \param rows     The number of elements in times.
+/// \param values   An array in which the values of each row will be stored, one row after another.
+/// \param size     The number of elements in values.
+/// \param width    The location in which the number of values in each row will be stored.
+/// \returns        The number of rows stored if successful, otherwise a negative value. -4 means no
+///                 datagram of the response arrived for XPC_FRAGMENT_TIMEOUT_MS, and -5 that a row
+///                 is too large to fit in one datagram.
+int getHIST(XPCSocket sock, double from, double to, int relative, double times[], int rows, float values[],
+	int size, int* width);
+
 // Terrain
 
 /// Sets the position and orientation and gets the terrain information of the specified aircraft.
@@ -251,6 +665,21 @@ int sendPOST(XPCSocket sock, double posi[], int size, double values[11], char ac
 /// \returns      0 if successful, otherwise a negative value.
 int getTERR(XPCSocket sock, double posi[3], double values[11], char ac);
 
+/// Gets the terrain information at many points with one request.
+///
+/// \details The plugin probes every point with the same terrain probe and splits the response
+///          across as many datagrams as needed. Use this instead of calling getTERR in a loop to
+///          check a planned path or many vehicles at once.
+/// \param sock   The socket to use to send the command.
+/// \param points The points to probe, each [Lat, Lon, Alt].
+/// \param count  The number of points, at most 2729 so that the request fits in one datagram.
+/// \param values An array in which the terrain information for each point will be stored, in the
+///               same format as getTERR. The wet variable is 0.0 if the terrain is dry and 1.0 if
+///               wet. Points the probe misses have a Lat, Lon and Alt of -998 and a non-zero result.
+/// \returns      0 if successful, otherwise a negative value. -5 means no datagram of the response
+///               arrived for XPC_FRAGMENT_TIMEOUT_MS.
+int getTERRs(XPCSocket sock, double points[][3], int count, double values[][11]);
+
 // Controls
 
 /// Gets the control surface information for the specified aircraft.
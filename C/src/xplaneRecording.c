@@ -0,0 +1,617 @@
+//Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+//National Aeronautics and Space Administration. All Rights Reserved.
+//
+//DISCLAIMERS
+//    No Warranty: THE SUBJECT SOFTWARE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY OF ANY KIND,
+//    EITHER EXPRESSED, IMPLIED, OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, ANY WARRANTY THAT
+//    THE SUBJECT SOFTWARE WILL CONFORM TO SPECIFICATIONS, ANY IMPLIED WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, OR FREEDOM FROM INFRINGEMENT, ANY WARRANTY
+//    THAT THE SUBJECT SOFTWARE WILL BE ERROR FREE, OR ANY WARRANTY THAT DOCUMENTATION, IF PROVIDED,
+//    WILL CONFORM TO THE SUBJECT SOFTWARE. THIS AGREEMENT DOES NOT, IN ANY MANNER, CONSTITUTE AN
+//    ENDORSEMENT BY GOVERNMENT AGENCY OR ANY PRIOR RECIPIENT OF ANY RESULTS, RESULTING DESIGNS,
+//    HARDWARE, SOFTWARE PRODUCTS OR ANY OTHER APPLICATIONS RESULTING FROM USE OF THE SUBJECT
+//    SOFTWARE.  FURTHER, GOVERNMENT AGENCY DISCLAIMS ALL WARRANTIES AND LIABILITIES REGARDING
+//    THIRD-PARTY SOFTWARE, IF PRESENT IN THE ORIGINAL SOFTWARE, AND DISTRIBUTES IT "AS IS."
+//
+//    Waiver and Indemnity: RECIPIENT AGREES TO WAIVE ANY AND ALL CLAIMS AGAINST THE UNITED STATES
+//    GOVERNMENT, ITS CONTRACTORS AND SUBCONTRACTORS, AS WELL AS ANY PRIOR RECIPIENT.  IF
+//    RECIPIENT'S USE OF THE SUBJECT SOFTWARE RESULTS IN ANY LIABILITIES, DEMANDS, DAMAGES, EXPENSES
+//    OR LOSSES ARISING FROM SUCH USE, INCLUDING ANY DAMAGES FROM PRODUCTS BASED ON, OR RESULTING
+//    FROM, RECIPIENT'S USE OF THE SUBJECT SOFTWARE, RECIPIENT SHALL INDEMNIFY AND HOLD HARMLESS THE
+//    UNITED STATES GOVERNMENT, ITS CONTRACTORS AND SUBCONTRACTORS, AS WELL AS ANY PRIOR RECIPIENT,
+//    TO THE EXTENT PERMITTED BY LAW.  RECIPIENT'S SOLE REMEDY FOR ANY SUCH MATTER SHALL BE THE
+//    IMMEDIATE, UNILATERAL TERMINATION OF THIS AGREEMENT.
+
+//  X-Plane Connect Recordings
+//
+//  DESCRIPTION
+//      Writes and reads binary flight recordings. See xplaneRecording.h for the format.
+
+#include "xplaneRecording.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define HEADER_SIZE 48
+#define WRITE_BUFFER_SIZE (64 * 1024)
+
+// The plugin builds this file on its own, without xplaneConnect.c, so errors are printed here.
+static void printError(char *functionName, char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	printf("[%s] ERROR: ", functionName);
+	vprintf(format, args);
+	printf("\n");
+
+	va_end(args);
+}
+
+struct xpcRecordingWriter
+{
+	FILE* file;
+	int channelCount;
+	XPCChannel* channels;
+	int recordSize;
+	long long recordCount;
+	unsigned long long dataOffset;
+	double lastTime;
+
+	// Records not yet written to the file
+	unsigned char* buffer;
+	int bufferSize;
+	int buffered;
+
+	// The time of every XPC_RECORDING_INDEX_INTERVAL'th record
+	double* index;
+	long long indexCount;
+	long long indexCapacity;
+};
+
+struct xpcRecording
+{
+	int channelCount;
+	XPCChannel* channels;
+	int recordSize;
+	long long recordCount;
+	const unsigned char* records;
+	const double* index;
+	long long indexCount;
+	int indexInterval;
+
+	const unsigned char* map;
+	size_t mapSize;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+};
+
+static int typeSize(DREF_TYPE type)
+{
+	switch (type)
+	{
+	case XPC_TYPE_INT:
+	case XPC_TYPE_FLOAT:
+		return 4;
+	case XPC_TYPE_DOUBLE:
+		return 8;
+	default:
+		return 0;
+	}
+}
+
+// Assigns each channel an offset aligned to its type and returns the record size, which is a
+// multiple of 8 so that every record starts aligned. Returns a negative value if a channel is
+// invalid.
+static int layoutChannels(XPCChannel channels[], int count)
+{
+	int size = sizeof(double);
+	int i; // iterator
+	for (i = 0; i < count; ++i)
+	{
+		int elementSize = typeSize(channels[i].type);
+		if (elementSize == 0 || channels[i].count < 1 || channels[i].count > 65535)
+		{
+			return -1;
+		}
+		size = (size + elementSize - 1) / elementSize * elementSize;
+		channels[i].offset = size;
+		size += elementSize * channels[i].count;
+	}
+	return (size + 7) / 8 * 8;
+}
+
+/*****************************************************************************/
+/****                              Writing                                ****/
+/*****************************************************************************/
+static int writeHeader(XPCRecordingWriter* writer, unsigned long long recordCount, unsigned long long indexOffset)
+{
+	unsigned char header[HEADER_SIZE] = "XPCR";
+	unsigned short version = XPC_RECORDING_VERSION;
+	unsigned short channelCount = (unsigned short)writer->channelCount;
+	unsigned int recordSize = (unsigned int)writer->recordSize;
+	unsigned int indexInterval = XPC_RECORDING_INDEX_INTERVAL;
+	memcpy(header + 4, &version, 2);
+	memcpy(header + 6, &channelCount, 2);
+	memcpy(header + 8, &recordSize, 4);
+	memcpy(header + 12, &indexInterval, 4);
+	memcpy(header + 16, &recordCount, 8);
+	memcpy(header + 24, &writer->dataOffset, 8);
+	memcpy(header + 32, &indexOffset, 8);
+	return fwrite(header, 1, HEADER_SIZE, writer->file) == HEADER_SIZE ? 0 : -1;
+}
+
+static int flushRecords(XPCRecordingWriter* writer)
+{
+	if (writer->buffered > 0 && fwrite(writer->buffer, 1, writer->buffered, writer->file) != (size_t)writer->buffered)
+	{
+		return -1;
+	}
+	writer->buffered = 0;
+	return 0;
+}
+
+static void freeWriter(XPCRecordingWriter* writer)
+{
+	if (writer->file)
+	{
+		fclose(writer->file);
+	}
+	free(writer->channels);
+	free(writer->buffer);
+	free(writer->index);
+	free(writer);
+}
+
+XPCRecordingWriter* createRecording(const char* path, const XPCChannel channels[], int count)
+{
+	// Validate input
+	if (count < 1 || count > 65535)
+	{
+		printError("createRecording", "count should be a value between 1 and 65535.");
+		return NULL;
+	}
+
+	XPCRecordingWriter* writer = (XPCRecordingWriter*)calloc(1, sizeof(XPCRecordingWriter));
+	if (!writer)
+	{
+		printError("createRecording", "Out of memory.");
+		return NULL;
+	}
+	writer->channelCount = count;
+	writer->channels = (XPCChannel*)malloc(count * sizeof(XPCChannel));
+	if (!writer->channels)
+	{
+		printError("createRecording", "Out of memory.");
+		freeWriter(writer);
+		return NULL;
+	}
+	memcpy(writer->channels, channels, count * sizeof(XPCChannel));
+	writer->recordSize = layoutChannels(writer->channels, count);
+	if (writer->recordSize < 0)
+	{
+		printError("createRecording", "Channels must have a numeric type and between 1 and 65535 values.");
+		freeWriter(writer);
+		return NULL;
+	}
+	writer->bufferSize = writer->recordSize > WRITE_BUFFER_SIZE ? writer->recordSize : WRITE_BUFFER_SIZE;
+	writer->buffer = (unsigned char*)malloc(writer->bufferSize);
+	writer->file = fopen(path, "wb");
+	if (!writer->buffer || !writer->file)
+	{
+		printError("createRecording", "Unable to create %s.", path);
+		freeWriter(writer);
+		return NULL;
+	}
+
+	// Schema
+	unsigned long long schemaSize = 0;
+	int i; // iterator
+	for (i = 0; i < count; ++i)
+	{
+		schemaSize += 4 + strnlen(writer->channels[i].name, 255);
+	}
+	writer->dataOffset = (HEADER_SIZE + schemaSize + 7) / 8 * 8;
+	int result = writeHeader(writer, 0, 0);
+	for (i = 0; result == 0 && i < count; ++i)
+	{
+		const XPCChannel* channel = &writer->channels[i];
+		unsigned char entry[4 + 255];
+		size_t nameLen = strnlen(channel->name, 255);
+		unsigned short elementCount = (unsigned short)channel->count;
+		entry[0] = (unsigned char)channel->type;
+		entry[1] = (unsigned char)nameLen;
+		memcpy(entry + 2, &elementCount, 2);
+		memcpy(entry + 4, channel->name, nameLen);
+		result = fwrite(entry, 1, 4 + nameLen, writer->file) == 4 + nameLen ? 0 : -1;
+	}
+	const unsigned char padding[8] = { 0 };
+	size_t paddingSize = (size_t)(writer->dataOffset - HEADER_SIZE - schemaSize);
+	if (result < 0 || fwrite(padding, 1, paddingSize, writer->file) != paddingSize)
+	{
+		printError("createRecording", "Unable to write to %s.", path);
+		freeWriter(writer);
+		return NULL;
+	}
+	return writer;
+}
+
+int appendRecord(XPCRecordingWriter* writer, double time, const void* values[])
+{
+	// Validate input
+	if (writer->recordCount > 0 && !(time >= writer->lastTime))
+	{
+		printError("appendRecord", "Record times must not decrease.");
+		return -1;
+	}
+
+	if (writer->recordCount % XPC_RECORDING_INDEX_INTERVAL == 0)
+	{
+		if (writer->indexCount == writer->indexCapacity)
+		{
+			long long capacity = writer->indexCapacity ? writer->indexCapacity * 2 : 256;
+			double* index = (double*)realloc(writer->index, (size_t)capacity * sizeof(double));
+			if (!index)
+			{
+				printError("appendRecord", "Out of memory.");
+				return -2;
+			}
+			writer->index = index;
+			writer->indexCapacity = capacity;
+		}
+		writer->index[writer->indexCount++] = time;
+	}
+
+	if (writer->buffered + writer->recordSize > writer->bufferSize && flushRecords(writer) < 0)
+	{
+		printError("appendRecord", "Unable to write record.");
+		return -3;
+	}
+	unsigned char* record = writer->buffer + writer->buffered;
+	memset(record, 0, writer->recordSize);
+	memcpy(record, &time, sizeof(double));
+	int i; // iterator
+	for (i = 0; i < writer->channelCount; ++i)
+	{
+		const XPCChannel* channel = &writer->channels[i];
+		memcpy(record + channel->offset, values[i], typeSize(channel->type) * channel->count);
+	}
+	writer->buffered += writer->recordSize;
+	writer->lastTime = time;
+	++writer->recordCount;
+	return 0;
+}
+
+int closeRecordingWriter(XPCRecordingWriter* writer)
+{
+	int result = flushRecords(writer);
+	unsigned long long indexOffset = writer->dataOffset + (unsigned long long)writer->recordCount * writer->recordSize;
+	if (result == 0 && writer->indexCount > 0 &&
+		fwrite(writer->index, sizeof(double), (size_t)writer->indexCount, writer->file) != (size_t)writer->indexCount)
+	{
+		result = -1;
+	}
+	if (result == 0 && (fseek(writer->file, 0, SEEK_SET) != 0 ||
+		writeHeader(writer, writer->recordCount, writer->indexCount > 0 ? indexOffset : 0) < 0))
+	{
+		result = -1;
+	}
+	if (fclose(writer->file) != 0)
+	{
+		result = -1;
+	}
+	writer->file = NULL;
+	freeWriter(writer);
+	if (result < 0)
+	{
+		printError("closeRecordingWriter", "Unable to finish the recording.");
+	}
+	return result;
+}
+
+/*****************************************************************************/
+/****                              Reading                                ****/
+/*****************************************************************************/
+static void unmapRecording(XPCRecording* recording)
+{
+#ifdef _WIN32
+	if (recording->map)
+	{
+		UnmapViewOfFile(recording->map);
+	}
+	if (recording->mapping)
+	{
+		CloseHandle(recording->mapping);
+	}
+	if (recording->file && recording->file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(recording->file);
+	}
+#else
+	if (recording->map)
+	{
+		munmap((void*)recording->map, recording->mapSize);
+	}
+#endif
+	recording->map = NULL;
+}
+
+// Maps the whole file into memory. Returns 0 if successful.
+static int mapRecording(XPCRecording* recording, const char* path)
+{
+#ifdef _WIN32
+	recording->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if (recording->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(recording->file, &size))
+	{
+		return -1;
+	}
+	recording->mapSize = (size_t)size.QuadPart;
+	if (recording->mapSize < HEADER_SIZE)
+	{
+		return -1;
+	}
+	recording->mapping = CreateFileMappingA(recording->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!recording->mapping)
+	{
+		return -1;
+	}
+	recording->map = (const unsigned char*)MapViewOfFile(recording->mapping, FILE_MAP_READ, 0, 0, 0);
+	return recording->map ? 0 : -1;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+	{
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < HEADER_SIZE)
+	{
+		close(fd);
+		return -1;
+	}
+	recording->mapSize = (size_t)st.st_size;
+	void* map = mmap(NULL, recording->mapSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		return -1;
+	}
+	recording->map = (const unsigned char*)map;
+	return 0;
+#endif
+}
+
+XPCRecording* openRecording(const char* path)
+{
+	XPCRecording* recording = (XPCRecording*)calloc(1, sizeof(XPCRecording));
+	if (!recording)
+	{
+		printError("openRecording", "Out of memory.");
+		return NULL;
+	}
+	if (mapRecording(recording, path) < 0)
+	{
+		printError("openRecording", "Unable to open %s.", path);
+		closeRecording(recording);
+		return NULL;
+	}
+
+	// Header
+	const unsigned char* header = recording->map;
+	unsigned short version;
+	unsigned short channelCount;
+	unsigned int recordSize;
+	unsigned int indexInterval;
+	unsigned long long recordCount;
+	unsigned long long dataOffset;
+	unsigned long long indexOffset;
+	memcpy(&version, header + 4, 2);
+	memcpy(&channelCount, header + 6, 2);
+	memcpy(&recordSize, header + 8, 4);
+	memcpy(&indexInterval, header + 12, 4);
+	memcpy(&recordCount, header + 16, 8);
+	memcpy(&dataOffset, header + 24, 8);
+	memcpy(&indexOffset, header + 32, 8);
+	if (memcmp(header, "XPCR", 4) != 0 || version != XPC_RECORDING_VERSION || channelCount == 0 ||
+		dataOffset > recording->mapSize || dataOffset % 8 != 0)
+	{
+		printError("openRecording", "%s is not a recording.", path);
+		closeRecording(recording);
+		return NULL;
+	}
+
+	// Schema
+	recording->channelCount = channelCount;
+	recording->channels = (XPCChannel*)calloc(channelCount, sizeof(XPCChannel));
+	if (!recording->channels)
+	{
+		printError("openRecording", "Out of memory.");
+		closeRecording(recording);
+		return NULL;
+	}
+	size_t cur = HEADER_SIZE;
+	int i; // iterator
+	for (i = 0; i < channelCount; ++i)
+	{
+		XPCChannel* channel = &recording->channels[i];
+		unsigned short elementCount;
+		if (cur + 4 > dataOffset || cur + 4 + recording->map[cur + 1] > dataOffset)
+		{
+			break;
+		}
+		channel->type = (DREF_TYPE)recording->map[cur];
+		memcpy(&elementCount, recording->map + cur + 2, 2);
+		channel->count = elementCount;
+		memcpy(channel->name, recording->map + cur + 4, recording->map[cur + 1]);
+		cur += 4 + recording->map[cur + 1];
+	}
+	if (i < channelCount || layoutChannels(recording->channels, channelCount) != (int)recordSize)
+	{
+		printError("openRecording", "The schema of %s is invalid.", path);
+		closeRecording(recording);
+		return NULL;
+	}
+
+	// Records and index
+	recording->recordSize = (int)recordSize;
+	recording->records = recording->map + dataOffset;
+	unsigned long long available = (recording->mapSize - dataOffset) / recordSize;
+	if (indexOffset == 0)
+	{
+		// The writer did not finish. Use every complete record.
+		recording->recordCount = (long long)available;
+	}
+	else
+	{
+		unsigned long long indexCount = indexInterval ? (recordCount + indexInterval - 1) / indexInterval : 0;
+		if (recordCount > available || indexOffset < dataOffset + recordCount * recordSize ||
+			indexOffset + indexCount * sizeof(double) > recording->mapSize || indexOffset % 8 != 0)
+		{
+			printError("openRecording", "%s is truncated.", path);
+			closeRecording(recording);
+			return NULL;
+		}
+		recording->recordCount = (long long)recordCount;
+		recording->index = (const double*)(recording->map + indexOffset);
+		recording->indexCount = (long long)indexCount;
+		recording->indexInterval = (int)indexInterval;
+	}
+	return recording;
+}
+
+void closeRecording(XPCRecording* recording)
+{
+	if (!recording)
+	{
+		return;
+	}
+	unmapRecording(recording);
+	free(recording->channels);
+	free(recording);
+}
+
+int getRecordingChannels(const XPCRecording* recording, const XPCChannel** channels)
+{
+	*channels = recording->channels;
+	return recording->channelCount;
+}
+
+long long getRecordCount(const XPCRecording* recording)
+{
+	return recording->recordCount;
+}
+
+double getRecordTime(const XPCRecording* recording, long long index)
+{
+	double time;
+	memcpy(&time, recording->records + index * recording->recordSize, sizeof(double));
+	return time;
+}
+
+long long findRecord(const XPCRecording* recording, double time)
+{
+	long long lo = 0;
+	long long hi = recording->recordCount;
+	if (recording->index)
+	{
+		// Find the block of records from the index first, so that only one block of the file is
+		// touched by the search.
+		long long blockLo = 0;
+		long long blockHi = recording->indexCount;
+		while (blockLo < blockHi)
+		{
+			long long mid = blockLo + (blockHi - blockLo) / 2;
+			if (recording->index[mid] <= time)
+			{
+				blockLo = mid + 1;
+			}
+			else
+			{
+				blockHi = mid;
+			}
+		}
+		if (blockLo == 0)
+		{
+			return -1;
+		}
+		lo = (blockLo - 1) * recording->indexInterval;
+		hi = blockLo * recording->indexInterval;
+		hi = hi < recording->recordCount ? hi : recording->recordCount;
+	}
+
+	// Find the first record after time.
+	while (lo < hi)
+	{
+		long long mid = lo + (hi - lo) / 2;
+		if (getRecordTime(recording, mid) <= time)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo - 1;
+}
+
+const void* getRecordValues(const XPCRecording* recording, long long index, int channel)
+{
+	if (index < 0 || index >= recording->recordCount || channel < 0 || channel >= recording->channelCount)
+	{
+		return NULL;
+	}
+	return recording->records + index * recording->recordSize + recording->channels[channel].offset;
+}
+
+int readRecord(const XPCRecording* recording, long long index, int channel, float values[], int size)
+{
+	const unsigned char* data = (const unsigned char*)getRecordValues(recording, index, channel);
+	if (!data)
+	{
+		printError("readRecord", "Invalid record or channel.");
+		return -1;
+	}
+	const XPCChannel* info = &recording->channels[channel];
+	int count = info->count < size ? info->count : size;
+	int i; // iterator
+	for (i = 0; i < count; ++i)
+	{
+		switch (info->type)
+		{
+		case XPC_TYPE_INT:
+		{
+			int value;
+			memcpy(&value, data + i * 4, 4);
+			values[i] = (float)value;
+			break;
+		}
+		case XPC_TYPE_DOUBLE:
+		{
+			double value;
+			memcpy(&value, data + i * 8, 8);
+			values[i] = (float)value;
+			break;
+		}
+		default:
+			memcpy(&values[i], data + i * 4, 4);
+			break;
+		}
+	}
+	return count;
+}
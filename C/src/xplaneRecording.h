@@ -0,0 +1,165 @@
+//Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+//National Aeronautics and Space Administration. All Rights Reserved.
+//
+//DISCLAIMERS
+//    No Warranty: THE SUBJECT SOFTWARE IS PROVIDED "AS IS" WITHOUT ANY WARRANTY OF ANY KIND,
+//    EITHER EXPRESSED, IMPLIED, OR STATUTORY, INCLUDING, BUT NOT LIMITED TO, ANY WARRANTY THAT
+//    THE SUBJECT SOFTWARE WILL CONFORM TO SPECIFICATIONS, ANY IMPLIED WARRANTIES OF
+//    MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, OR FREEDOM FROM INFRINGEMENT, ANY WARRANTY
+//    THAT THE SUBJECT SOFTWARE WILL BE ERROR FREE, OR ANY WARRANTY THAT DOCUMENTATION, IF PROVIDED,
+//    WILL CONFORM TO THE SUBJECT SOFTWARE. THIS AGREEMENT DOES NOT, IN ANY MANNER, CONSTITUTE AN
+//    ENDORSEMENT BY GOVERNMENT AGENCY OR ANY PRIOR RECIPIENT OF ANY RESULTS, RESULTING DESIGNS,
+//    HARDWARE, SOFTWARE PRODUCTS OR ANY OTHER APPLICATIONS RESULTING FROM USE OF THE SUBJECT
+//    SOFTWARE.  FURTHER, GOVERNMENT AGENCY DISCLAIMS ALL WARRANTIES AND LIABILITIES REGARDING
+//    THIRD-PARTY SOFTWARE, IF PRESENT IN THE ORIGINAL SOFTWARE, AND DISTRIBUTES IT "AS IS."
+//
+//    Waiver and Indemnity: RECIPIENT AGREES TO WAIVE ANY AND ALL CLAIMS AGAINST THE UNITED STATES
+//    GOVERNMENT, ITS CONTRACTORS AND SUBCONTRACTORS, AS WELL AS ANY PRIOR RECIPIENT.  IF
+//    RECIPIENT'S USE OF THE SUBJECT SOFTWARE RESULTS IN ANY LIABILITIES, DEMANDS, DAMAGES, EXPENSES
+//    OR LOSSES ARISING FROM SUCH USE, INCLUDING ANY DAMAGES FROM PRODUCTS BASED ON, OR RESULTING
+//    FROM, RECIPIENT'S USE OF THE SUBJECT SOFTWARE, RECIPIENT SHALL INDEMNIFY AND HOLD HARMLESS THE
+//    UNITED STATES GOVERNMENT, ITS CONTRACTORS AND SUBCONTRACTORS, AS WELL AS ANY PRIOR RECIPIENT,
+//    TO THE EXTENT PERMITTED BY LAW.  RECIPIENT'S SOLE REMEDY FOR ANY SUCH MATTER SHALL BE THE
+//    IMMEDIATE, UNILATERAL TERMINATION OF THIS AGREEMENT.
+#ifndef xplaneRecording_h
+#define xplaneRecording_h
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "xplaneConnect.h"
+
+/// Binary flight recordings.
+///
+/// A recording is a header, a schema listing the channels recorded, fixed size records and a
+/// sparse index of record times. Every record starts with its time in seconds as a double,
+/// followed by the values of each channel in the channel's own type. Records are written through
+/// a buffered writer and read through a memory map, so opening a recording reads nothing but the
+/// header and schema, and finding the record at a time is a binary search over the index and then
+/// over one block of records. All values are stored in the byte order of the machine that wrote
+/// the recording.
+///
+/// File layout:
+///     Header (48 bytes): "XPCR" | version (u16) | channel count (u16) | record size (u32)
+///                        | index interval (u32) | record count (u64) | data offset (u64)
+///                        | index offset (u64) | reserved (8)
+///     Schema:            type (u8) | name length (u8) | element count (u16) | name, per channel
+///     Records:           starting at data offset, record size bytes each
+///     Index:             starting at index offset, the time of every index interval'th record
+///                        (f64)
+/// The record count and index offset are written when the writer is closed. If they are 0, the
+/// writer did not finish, and readers use every complete record in the file without an index.
+
+/// The version of the recording format written by this library.
+#define XPC_RECORDING_VERSION 1
+
+/// The number of records between entries in the index of a recording.
+#define XPC_RECORDING_INDEX_INTERVAL 1024
+
+/// Describes one channel of a recording.
+typedef struct
+{
+	/// The name of the channel, usually the name of the dataref recorded.
+	char name[256];
+	/// The type of each value. XPC_TYPE_INT, XPC_TYPE_FLOAT or XPC_TYPE_DOUBLE.
+	DREF_TYPE type;
+	/// The number of values in the channel, between 1 and 65535.
+	int count;
+	/// The offset of the channel's first value from the start of a record, in bytes. Set by
+	/// createRecording and openRecording.
+	int offset;
+} XPCChannel;
+
+/// A recording being written. Created by createRecording.
+typedef struct xpcRecordingWriter XPCRecordingWriter;
+
+/// A recording opened for reading. Created by openRecording.
+typedef struct xpcRecording XPCRecording;
+
+// Writing
+
+/// Creates a new recording, replacing any file at the specified path.
+///
+/// \param path     The path of the recording.
+/// \param channels The channels to record. The offset of each channel is ignored.
+/// \param count    The number of channels, between 1 and 65535.
+/// \returns        The new writer, or NULL if the recording could not be created.
+XPCRecordingWriter* createRecording(const char* path, const XPCChannel channels[], int count);
+
+/// Appends a record to a recording.
+///
+/// \param writer The recording to append to.
+/// \param time   The time of the record in seconds. Must not be less than the time of the
+///               previous record.
+/// \param values The values of each channel: for each channel, a pointer to count values of the
+///               channel's type.
+/// \returns      0 if successful, otherwise a negative value.
+int appendRecord(XPCRecordingWriter* writer, double time, const void* values[]);
+
+/// Writes any buffered records and the index, and closes a recording. The writer is freed.
+///
+/// \param writer The recording to close.
+/// \returns      0 if successful, otherwise a negative value.
+int closeRecordingWriter(XPCRecordingWriter* writer);
+
+// Reading
+
+/// Opens a recording for reading.
+///
+/// \param path The path of the recording.
+/// \returns    The recording, or NULL if the file could not be opened or is not a recording.
+XPCRecording* openRecording(const char* path);
+
+/// Closes a recording opened with openRecording. The recording is freed.
+void closeRecording(XPCRecording* recording);
+
+/// Gets the channels of a recording.
+///
+/// \param recording The recording.
+/// \param channels  The location in which a pointer to the channels will be stored. The channels
+///                  are valid until the recording is closed.
+/// \returns         The number of channels.
+int getRecordingChannels(const XPCRecording* recording, const XPCChannel** channels);
+
+/// Gets the number of records in a recording.
+long long getRecordCount(const XPCRecording* recording);
+
+/// Gets the time of a record in seconds.
+///
+/// \param recording The recording.
+/// \param index     The index of the record, between 0 and getRecordCount() - 1.
+double getRecordTime(const XPCRecording* recording, long long index);
+
+/// Finds the record at a time.
+///
+/// \param recording The recording.
+/// \param time      The time in seconds.
+/// \returns         The index of the last record with a time less than or equal to time, or -1
+///                  if time is before the first record.
+long long findRecord(const XPCRecording* recording, double time);
+
+/// Gets the values of one channel of a record without copying them.
+///
+/// \param recording The recording.
+/// \param index     The index of the record.
+/// \param channel   The index of the channel.
+/// \returns         A pointer to the channel's values, in the channel's type, or NULL if the
+///                  index or channel are invalid. Valid until the recording is closed.
+const void* getRecordValues(const XPCRecording* recording, long long index, int channel);
+
+/// Reads the values of one channel of a record as floats.
+///
+/// \param recording The recording.
+/// \param index     The index of the record.
+/// \param channel   The index of the channel.
+/// \param values    The array in which the values will be stored.
+/// \param size      The size of values.
+/// \returns         The number of values stored, or a negative value if the index or channel
+///                  are invalid.
+int readRecord(const XPCRecording* recording, long long index, int channel, float values[], int size);
+
+#ifdef __cplusplus
+    }
+#endif
+#endif
@@ -171,6 +171,48 @@ int testGETD_Types()
 	return 0;
 }
 
+int testGETD_Limit()
+{
+	// 255 float[4] drefs don't fit in one response, so the plugin truncates
+	// the later ones but still returns a row for each.
+	const char* drefs[255];
+	float* data[255];
+	int sizes[255];
+	for (int i = 0; i < 255; ++i)
+	{
+		drefs[i] = "sim/cockpit2/switches/panel_brightness_ratio";
+		data[i] = (float*)malloc(sizeof(float) * 4);
+		sizes[i] = 4;
+	}
+
+	// Execute command
+	XPCSocket sock = openUDP(IP);
+	int result = getDREFs(sock, drefs, data, 255, sizes);
+	closeUDP(sock);
+	for (int i = 0; i < 255; ++i)
+	{
+		free(data[i]);
+	}
+
+	// Tests
+	if (result < 0)
+	{
+		return -1;
+	}
+	if (sizes[0] != 4 || sizes[254] != 0)
+	{
+		return -2;
+	}
+	for (int i = 1; i < 255; ++i)
+	{
+		if (sizes[i] > sizes[i - 1])
+		{
+			return -3;
+		}
+	}
+	return 0;
+}
+
 int testDREF()
 {
 	const char* drefs[] =
@@ -244,4 +286,236 @@ int testDREF()
 	return doDREFTest(drefs, values, expected, 6, sizes);
 }
 
+int testGETY()
+{
+	const char* drefs[] =
+	{
+		"sim/cockpit/switches/gear_handle_status", //int
+		"sim/cockpit/autopilot/altitude", //float
+		"sim/flightmodel/position/elevation", //double
+		"sim/not/a/real/dref"
+	};
+	DREF_TYPE expected[4] = { XPC_TYPE_INT, XPC_TYPE_FLOAT, XPC_TYPE_DOUBLE, XPC_TYPE_NONE };
+	double gear[1];
+	double alt[1];
+	double elev[1];
+	double none[1];
+	double* values[4] = { gear, alt, elev, none };
+	DREF_TYPE types[4];
+	int sizes[4] = { 1, 1, 1, 1 };
+
+	XPCSocket sock = openUDP(IP);
+	int result = getDREFsTyped(sock, drefs, values, types, 4, sizes);
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return -1;
+	}
+	int i;
+	for (i = 0; i < 4; ++i)
+	{
+		if (types[i] != expected[i])
+		{
+			return -2;
+		}
+	}
+	if (sizes[0] != 1 || sizes[1] != 1 || sizes[2] != 1 || sizes[3] != 0)
+	{
+		return -3;
+	}
+	return 0;
+}
+
+int testGETF()
+{
+	const char* drefs[] =
+	{
+		"sim/test/test_float", //float
+		"sim/cockpit2/switches/panel_brightness_ratio", //float[4]
+		"sim/aircraft/prop/acf_prop_type" //int[8]
+	};
+	float tf[1] = { 7.5F };
+	float pbr[4] = { 0.25F, 0.5F, 0.75F, 1.0F };
+	float apt[8] = { 1, 0, 1, 0, 1, 0, 1, 0 };
+	float* expected[3] = { tf, pbr, apt };
+	int esizes[3] = { 1, 4, 8 };
+	float atf[1];
+	float apbr[4];
+	float aapt[8];
+	float* actual[3] = { atf, apbr, aapt };
+	int asizes[3] = { 1, 4, 8 };
+
+	XPCSocket sock = openUDP(IP);
+	int result = sendDREFs(sock, drefs, expected, esizes, 3);
+	if (result >= 0)
+	{
+		// Small enough that the response has to be split across several
+		// datagrams.
+		result = getDREFsFragmented(sock, drefs, actual, 3, asizes, 64);
+	}
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return -1;
+	}
+	return compareArrays(expected, esizes, actual, asizes, 3);
+}
+
+int testRSLV()
+{
+	const char* drefs[] =
+	{
+		"sim/test/test_float", //float
+		"sim/cockpit2/switches/panel_brightness_ratio", //float[4]
+		"sim/not/a/real/dref"
+	};
+	unsigned short ids[3];
+	int sizes[3];
+	float tf[1] = { 12.5F };
+	float pbr[4] = { 0.5F, 0.5F, 0.5F, 0.5F };
+	float* values[2] = { tf, pbr };
+	float atf[1];
+	float apbr[4];
+	float* actual[2] = { atf, apbr };
+	int asizes[2] = { 1, 4 };
+	float* expected[2] = { tf, pbr };
+	int esizes[2] = { 1, 4 };
+
+	XPCSocket sock = openUDP(IP);
+	int result = resolveDREFs(sock, drefs, ids, sizes, 3);
+	if (result < 0)
+	{
+		closeUDP(sock);
+		return -1;
+	}
+	if (ids[0] == XPC_INVALID_DREF_ID || ids[1] == XPC_INVALID_DREF_ID || ids[2] != XPC_INVALID_DREF_ID)
+	{
+		closeUDP(sock);
+		return -2;
+	}
+	if (sizes[0] != 1 || sizes[1] != 4)
+	{
+		closeUDP(sock);
+		return -3;
+	}
+
+	result = sendDREFsById(sock, ids, values, esizes, 2);
+	if (result >= 0)
+	{
+		result = getDREFsById(sock, ids, actual, 2, asizes);
+	}
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return -4;
+	}
+	return compareArrays(expected, esizes, actual, asizes, 2);
+}
+
+int testSUBS()
+{
+	const char* drefs[] =
+	{
+		"sim/test/test_float", //float
+		"sim/cockpit2/switches/panel_brightness_ratio" //float[4]
+	};
+	float tf[1];
+	float pbr[4];
+	float* data[2] = { tf, pbr };
+	int sizes[2];
+
+	// Subscribe and wait for a few updates
+	XPCSocket sock = openUDP(IP);
+	int result = subscribeDREFs(sock, drefs, 2, 1, 0);
+	int updates = 0;
+	for (int i = 0; result >= 0 && i < 50 && updates < 3; ++i)
+	{
+		sizes[0] = 1;
+		sizes[1] = 4;
+		result = readDREFs(sock, data, 2, sizes);
+		if (result > 0)
+		{
+			++updates;
+		}
+	}
+	if (result < 0)
+	{
+		closeUDP(sock);
+		return -1;
+	}
+	if (updates < 3)
+	{
+		closeUDP(sock);
+		return -2;
+	}
+	if (sizes[0] != 1 || sizes[1] != 4)
+	{
+		closeUDP(sock);
+		return -3;
+	}
+
+	// Unsubscribe and make sure updates stop
+	if (unsubscribeDREFs(sock) < 0)
+	{
+		closeUDP(sock);
+		return -4;
+	}
+	crossPlatformUSleep(SLEEP_AMOUNT);
+	while (readDREFs(sock, data, 2, sizes) > 0)
+	{
+		// Drain updates sent before the unsubscribe was handled
+	}
+	result = readDREFs(sock, data, 2, sizes);
+	closeUDP(sock);
+	return result == 0 ? 0 : -5;
+}
+
+int testSUBS_Changes()
+{
+	const char* drefs[] =
+	{
+		"sim/test/test_float", //float
+		"sim/cockpit2/switches/panel_brightness_ratio" //float[4]
+	};
+	float deadbands[2] = { 0.0F, 0.0F };
+	float tf[1] = { NAN };
+	float pbr[4] = { NAN, NAN, NAN, NAN };
+	float* data[2] = { tf, pbr };
+	int sizes[2] = { 1, 4 };
+	float value = 42.0F;
+
+	// Subscribe and wait for the initial full update
+	XPCSocket sock = openUDP(IP);
+	int result = subscribeDREFChanges(sock, drefs, deadbands, 2, 1, 1000, 0);
+	for (int i = 0; result == 0 && i < 50; ++i)
+	{
+		result = readDREFs(sock, data, 2, sizes);
+	}
+	if (result <= 0 || isnan(pbr[0]))
+	{
+		closeUDP(sock);
+		return -1;
+	}
+
+	// Change one value and wait for the partial update
+	pbr[0] = NAN;
+	result = sendDREF(sock, drefs[0], &value, 1);
+	for (int i = 0; result >= 0 && i < 50 && tf[0] != value; ++i)
+	{
+		result = readDREFs(sock, data, 2, sizes);
+	}
+	unsubscribeDREFs(sock);
+	closeUDP(sock);
+	if (result < 0 || tf[0] != value)
+	{
+		return -2;
+	}
+	// Values that didn't change are left alone
+	if (!isnan(pbr[0]))
+	{
+		return -3;
+	}
+	return 0;
+}
+
 #endif
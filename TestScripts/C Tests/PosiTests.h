@@ -155,4 +155,207 @@ int testGetPOSI_NonPlayer()
 	return doGETPTest(POSI, 3, POSI);
 }
 
+int testPOSIs()
+{
+	char ac[2] = { 0, 2 };
+	double POSI[2][7] =
+	{
+		{ 37.524, -122.06899, 2500, 0, 0, 0, 1 },
+		{ 37.624, -122.06899, 1500, 5, -5, 10, 1 }
+	};
+	double actual[7];
+
+	// Execute Test
+	XPCSocket sock = openUDP(IP);
+	pauseSim(sock, 1);
+	int result = sendPOSIs(sock, ac, POSI, NULL, 2);
+	for (int i = 0; result >= 0 && i < 2; ++i)
+	{
+		result = getPOSI(sock, actual, ac[i]);
+		for (int j = 0; result >= 0 && j < 7; ++j)
+		{
+			if (fabs(POSI[i][j] - actual[j]) > 1e-4)
+			{
+				result = -10 * (i + 1) - j;
+			}
+		}
+	}
+	pauseSim(sock, 0);
+	closeUDP(sock);
+	return result < 0 ? result : 0;
+}
+
+int testGETS()
+{
+	char ac[2] = { 0, 2 };
+	double POSI[2][7] =
+	{
+		{ 37.524, -122.06899, 2500, 0, 0, 0, 1 },
+		{ 37.624, -122.06899, 1500, 5, -5, 10, 1 }
+	};
+	XPCAircraftStates states;
+
+	// Execute Test
+	XPCSocket sock = openUDP(IP);
+	pauseSim(sock, 1);
+	int result = sendPOSIs(sock, ac, POSI, NULL, 2);
+	if (result >= 0)
+	{
+		result = getPOSIs(sock, ac, 2, &states);
+	}
+	pauseSim(sock, 0);
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return -1;
+	}
+
+	// Test values
+	if (states.count != 2 || states.aircraft[0] != 0 || states.aircraft[1] != 2)
+	{
+		return -2;
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		double actual[7] =
+		{
+			states.lat[i], states.lon[i], states.alt[i],
+			states.pitch[i], states.roll[i], states.heading[i], states.gear[i]
+		};
+		for (int j = 0; j < 7; ++j)
+		{
+			if (fabs(POSI[i][j] - actual[j]) > 1e-4)
+			{
+				return -10 * (i + 1) - j;
+			}
+		}
+	}
+	return 0;
+}
+
+int testTPOS()
+{
+	double POSI[7] = { 37.624, -122.06899, 1500, 5, -5, 10, 1 };
+	double actual[7];
+
+	// Execute Test
+	XPCSocket sock = openUDP(IP);
+	int result = sendTPOS(sock, 0.0, POSI, 0, 2);
+	if (result >= 0)
+	{
+		result = sendTPOS(sock, 0.1, POSI, 0, 2);
+	}
+	if (result >= 0)
+	{
+		crossPlatformUSleep(SLEEP_AMOUNT);
+		result = getPOSI(sock, actual, 2);
+	}
+	// Stop smoothing
+	sendPOSI(sock, POSI, 7, 2);
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return -1;
+	}
+
+	// Test values
+	for (int j = 0; j < 7; ++j)
+	{
+		if (fabs(POSI[j] - actual[j]) > 1e-4)
+		{
+			return -10 - j;
+		}
+	}
+	return 0;
+}
+
+int testTRAJ()
+{
+	double time[3] = { 0, 10, 20 };
+	double POSI[3][7] =
+	{
+		{ 37.524, -122.06899, 2500, 0, 0, 0, 1 },
+		{ 37.574, -122.06899, 2000, 2, -2, 5, 1 },
+		{ 37.624, -122.06899, 1500, 4, -4, 10, 1 }
+	};
+	double actual[7];
+
+	// Execute Test
+	XPCSocket sock = openUDP(IP);
+	int result = sendTRAJ(sock, time, POSI, NULL, 3, NULL, NULL, 0, 2);
+	if (result >= 0)
+	{
+		result = sendPLAY(sock, XPC_PLAY_START, 10, 2);
+	}
+	if (result >= 0)
+	{
+		result = sendPLAY(sock, XPC_PLAY_PAUSE, 0, 2);
+	}
+	if (result >= 0)
+	{
+		// Undo any time played before the pause.
+		result = sendPLAY(sock, XPC_PLAY_SEEK, 10, 2);
+	}
+	if (result >= 0)
+	{
+		crossPlatformUSleep(SLEEP_AMOUNT);
+		result = getPOSI(sock, actual, 2);
+	}
+	sendPLAY(sock, XPC_PLAY_STOP, 0, 2);
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return -1;
+	}
+
+	// Test values
+	for (int j = 0; j < 7; ++j)
+	{
+		if (fabs(POSI[1][j] - actual[j]) > 1e-4)
+		{
+			return -10 - j;
+		}
+	}
+	return 0;
+}
+
+int testGETTs()
+{
+	double points[100][3];
+	double values[100][11];
+	for (int i = 0; i < 100; ++i)
+	{
+		points[i][0] = 37.524 + i * 0.001;
+		points[i][1] = -122.06899;
+		points[i][2] = 0.0;
+	}
+
+	// Execute Test
+	XPCSocket sock = openUDP(IP);
+	int result = getTERRs(sock, points, 100, values);
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return -1;
+	}
+
+	// Test values
+	for (int i = 0; i < 100; ++i)
+	{
+		if (values[i][10] != 0)
+		{
+			return -2;
+		}
+		if (fabs(values[i][0] - points[i][0]) > 1e-4 || fabs(values[i][1] - points[i][1]) > 1e-4)
+		{
+			return -3;
+		}
+		if (values[i][4] <= 0)
+		{
+			return -4;
+		}
+	}
+	return 0;
+}
+
 #endif
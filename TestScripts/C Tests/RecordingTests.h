@@ -0,0 +1,170 @@
+//Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+//National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef RECORDINGTESTS_H
+#define RECORDINGTESTS_H
+
+#include "Test.h"
+#include "xplaneRecording.h"
+
+#define RECORDING_PATH "xpcTestRecording.xpcr"
+
+int testRecording()
+{
+	// Several index blocks, with the last one partly full
+	const int count = 3 * XPC_RECORDING_INDEX_INTERVAL + 10;
+	XPCChannel channels[2] =
+	{
+		{ "posi", XPC_TYPE_DOUBLE, 3, 0 },
+		{ "sim/cockpit/switches/gear_handle_status", XPC_TYPE_INT, 1, 0 }
+	};
+
+	// Write
+	XPCRecordingWriter* writer = createRecording(RECORDING_PATH, channels, 2);
+	if (!writer)
+	{
+		return -1;
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		double posi[3] = { 37.5 + i * 1e-5, -122.0, 1000.0 + i };
+		int gear = i % 2;
+		const void* values[2] = { posi, &gear };
+		if (appendRecord(writer, i / 60.0, values) < 0)
+		{
+			closeRecordingWriter(writer);
+			return -2;
+		}
+	}
+	if (closeRecordingWriter(writer) < 0)
+	{
+		return -3;
+	}
+
+	// Read
+	XPCRecording* recording = openRecording(RECORDING_PATH);
+	if (!recording)
+	{
+		return -4;
+	}
+	int result = 0;
+	const XPCChannel* actualChannels;
+	if (getRecordingChannels(recording, &actualChannels) != 2 || strcmp(actualChannels[1].name, channels[1].name) != 0 ||
+		actualChannels[0].count != 3 || getRecordCount(recording) != count)
+	{
+		result = -5;
+	}
+
+	// Seek
+	long long indices[4] = { 0, XPC_RECORDING_INDEX_INTERVAL - 1, XPC_RECORDING_INDEX_INTERVAL, count - 1 };
+	for (int i = 0; result == 0 && i < 4; ++i)
+	{
+		// Halfway between records finds the earlier one.
+		long long found = findRecord(recording, (indices[i] + 0.5) / 60.0);
+		float gear;
+		const double* posi = (const double*)getRecordValues(recording, found, 0);
+		if (found != indices[i] || !posi || posi[2] != 1000.0 + indices[i])
+		{
+			result = -10 - i;
+		}
+		else if (readRecord(recording, found, 1, &gear, 1) != 1 || gear != indices[i] % 2)
+		{
+			result = -20 - i;
+		}
+	}
+	if (result == 0 && findRecord(recording, -1.0) != -1)
+	{
+		result = -6;
+	}
+	closeRecording(recording);
+	remove(RECORDING_PATH);
+	return result;
+}
+
+int testRECD()
+{
+	const char* drefs[2] =
+	{
+		"sim/flightmodel/position/latitude",
+		"sim/cockpit2/controls/yoke_pitch_ratio"
+	};
+	XPCRecorderStatus status;
+
+	// Execute Test
+	XPCSocket sock = openUDP(IP);
+	int result = startRECD(sock, "xpcTestRecording.xpcr", drefs, 2, 1);
+	if (result >= 0)
+	{
+		crossPlatformUSleep(SLEEP_AMOUNT);
+		result = getRECD(sock, &status);
+	}
+	if (result >= 0 && (status.state != 1 || status.samples == 0))
+	{
+		result = -2;
+	}
+	if (result >= 0)
+	{
+		result = stopRECD(sock);
+	}
+	if (result >= 0)
+	{
+		// The file is finished in the background.
+		crossPlatformUSleep(SLEEP_AMOUNT);
+		result = getRECD(sock, &status);
+	}
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return result;
+	}
+
+	// Test values
+	if (status.state != 0 || status.written + status.dropped != status.samples)
+	{
+		return -3;
+	}
+	return 0;
+}
+
+int testHIST()
+{
+	const char* drefs[2] =
+	{
+		"sim/flightmodel/position/latitude",
+		"sim/cockpit2/controls/yoke_pitch_ratio"
+	};
+	double times[256];
+	float values[512];
+	int width = -1;
+
+	// Execute Test
+	XPCSocket sock = openUDP(IP);
+	int result = setHIST(sock, 2.0F, drefs, 2);
+	if (result >= 0)
+	{
+		crossPlatformUSleep(SLEEP_AMOUNT);
+		result = getHIST(sock, -1.0, 0.0, 1, times, 256, values, 512, &width);
+	}
+	setHIST(sock, 0.0F, NULL, 0);
+	closeUDP(sock);
+	if (result < 0)
+	{
+		return result;
+	}
+
+	// Test values
+	if (result == 0 || width != 2)
+	{
+		return -3;
+	}
+	int i; // Iterator
+	for (i = 1; i < result; ++i)
+	{
+		if (times[i] < times[i - 1])
+		{
+			return -4;
+		}
+	}
+	return 0;
+}
+
+#endif
@@ -52,4 +52,121 @@ int testCONN()
 	return 0;
 }
 
+int testLOGL()
+{
+	// Initialize
+	const char* dref = "sim/cockpit/switches/gear_handle_status";
+	float data[1];
+	int size = 1;
+	XPCSocket sock = openUDP(IP);
+
+	// Execution
+	if (setLogLevel(sock, 7) != -2) // Out of range
+	{
+		closeUDP(sock);
+		return -1;
+	}
+	int result = setLogLevel(sock, 2);
+	if (result >= 0)
+	{
+		// The plugin should keep answering requests with logging turned down.
+		result = getDREF(sock, dref, data, &size);
+	}
+	setLogLevel(sock, 6);
+
+	// Close
+	closeUDP(sock);
+
+	// Test
+	if (result < 0)
+	{
+		return -2;
+	}
+	return 0;
+}
+
+int testSTAT()
+{
+	// Initialize
+	const char* dref = "sim/cockpit/switches/gear_handle_status";
+	float data[1];
+	int size = 1;
+	XPCLatency stats[64];
+	int count = 64;
+	XPCSocket sock = openUDP(IP);
+
+	// Execution
+	int result = getDREF(sock, dref, data, &size);
+	if (result >= 0)
+	{
+		result = getLatency(sock, stats, &count, 0);
+	}
+
+	// Close
+	closeUDP(sock);
+
+	// Test
+	if (result < 0)
+	{
+		return -1;
+	}
+	if (count < 3 || strcmp(stats[0].name, "loop") != 0 || strcmp(stats[1].name, "wait") != 0)
+	{
+		return -2;
+	}
+	int i;
+	for (i = 2; i < count; ++i)
+	{
+		if (strcmp(stats[i].name, "GETD") == 0)
+		{
+			if (stats[i].count == 0 || stats[i].p50 > stats[i].max)
+			{
+				return -3;
+			}
+			return 0;
+		}
+	}
+	return -4;
+}
+
+int testSTAT_Counters()
+{
+	// Initialize
+	const char* drefs[] = { "sim/not/a/real/dref" };
+	float data[1];
+	float* values[1] = { data };
+	int sizes[1] = { 1 };
+	XPCStats before;
+	XPCStats after;
+	XPCSocket sock = openUDP(IP);
+
+	// Execution
+	int result = getSTATS(sock, &before);
+	if (result >= 0)
+	{
+		result = getDREFs(sock, drefs, values, 1, sizes);
+	}
+	if (result >= 0)
+	{
+		result = getSTATS(sock, &after);
+	}
+
+	// Close
+	closeUDP(sock);
+
+	// Test
+	if (result < 0)
+	{
+		return -1;
+	}
+	if (after.datagramsReceived < before.datagramsReceived + 2 ||
+		after.datagramsSent < before.datagramsSent + 2 ||
+		after.invalidDrefs < before.invalidDrefs + 1 ||
+		after.connections < 1)
+	{
+		return -2;
+	}
+	return 0;
+}
+
 #endif
@@ -10,6 +10,7 @@
 #include "TextTests.h"
 #include "ViewTests.h"
 #include "WyptTests.h"
+#include "RecordingTests.h"
 
 int main(int argc, const char * argv[]) {
     printf("XPC Tests-c ");
@@ -29,6 +30,12 @@ int main(int argc, const char * argv[]) {
     crossPlatformUSleep(SLEEP_AMOUNT);
 	runTest(testClose, "close");
     crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testLOGL, "LOGL");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testSTAT, "STAT");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testSTAT_Counters, "STAT (counters)");
+    crossPlatformUSleep(SLEEP_AMOUNT);
 
 	// Datarefs
 	runTest(testGETD_Basic, "GETD");
@@ -36,8 +43,20 @@ int main(int argc, const char * argv[]) {
 	runTest(testGETD_Types, "GETD (types)");
     crossPlatformUSleep(SLEEP_AMOUNT);
 	runTest(testGETD_TestFloat, "GETD (test float)");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testGETD_Limit, "GETD (limit)");
     crossPlatformUSleep(SLEEP_AMOUNT);
 	runTest(testDREF, "DREF");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testRSLV, "RSLV");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testGETY, "GETY");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testGETF, "GETF");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testSUBS, "SUBS");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+	runTest(testSUBS_Changes, "SUBS (changes only)");
 	// Pause
     crossPlatformUSleep(SLEEP_AMOUNT);
     runTest(testSIMU_Basic, "SIMU");
@@ -63,6 +82,13 @@ int main(int argc, const char * argv[]) {
     runTest(testGetPOSI_Player, "GETP (player)");
     crossPlatformUSleep(SLEEP_AMOUNT);
     runTest(testGetPOSI_NonPlayer, "GETP (non-player)");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+    runTest(testPOSIs, "BPOS");
+    crossPlatformUSleep(SLEEP_AMOUNT);
+    runTest(testGETS, "GETS");
+    runTest(testTPOS, "TPOS");
+    runTest(testTRAJ, "TRAJ");
+    runTest(testGETTs, "GTRS");
 	// Data
     crossPlatformUSleep(SLEEP_AMOUNT);
     runTest(testDATA, "DATA");
@@ -78,6 +104,10 @@ int main(int argc, const char * argv[]) {
 	// setConn
     crossPlatformUSleep(SLEEP_AMOUNT);
     runTest(testCONN, "CONN");
+	// Recordings
+    runTest(testRecording, "Recording");
+    runTest(testRECD, "RECD");
+    runTest(testHIST, "HIST");
 
     printf( "----------------\nTest Summary\n\tFailed: %i\n\tPassed: %i\n", testFailed, testPassed );
 	printf("Press any key to exit.");
@@ -0,0 +1,129 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+//
+// Measures the per-message cost of looking up a message handler from a raw
+// datagram header. Compares the original approach (copy the header into a
+// std::string and look it up in a std::map) with MessageHandlers::GetHandler,
+// the packed tag and sorted table the plugin ships with.
+//
+// The benchmark links the plugin's sources, but only calls GetHandler, which
+// does not touch X-Plane. XPLM symbols are left unresolved at link time.
+//
+// Build with `cmake --build . --target dispatch_benchmark` and run the
+// resulting executable. Optionally pass the number of iterations.
+#include "Message.h"
+#include "MessageHandlers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+
+namespace
+{
+	using XPC::MessageHandler;
+	using XPC::MessageHandlers;
+
+	volatile MessageHandler sink;
+
+	const char* heads[] =
+	{
+		"BOAT", "BPOS", "CHAR", "COMM", "CONN", "CTRL", "DATA", "DCOC",
+		"DREF", "DREI", "DSEL", "FAIL", "GETC", "GETD", "GETF", "GETI",
+		"GETP", "GETS", "GETT", "GETY", "GSET", "GTRS", "HIST", "ISET",
+		"LOGL", "MENU", "MOUS", "OBJL", "OBJN", "PAPT", "PLAY", "POSI",
+		"POST", "RECD", "RECO", "RSLV", "SIMU", "SOUN", "STAT", "SUBS",
+		"TEXT", "TPOS", "TRAJ", "UCOC", "USEL", "VEH1", "VEHA", "VEHN",
+		"VIEW", "WYPT",
+	};
+	const std::size_t headCount = sizeof(heads) / sizeof(heads[0]);
+
+	// Traffic is dominated by a handful of message types in practice, with the
+	// odd unknown header mixed in.
+	const char* traffic[] =
+	{
+		"POSI", "CTRL", "GETD", "DREF", "POSI", "GETD", "CTRL", "DREF",
+		"POSI", "GETD", "SIMU", "TEXT", "GETP", "GETC", "DATA", "XXXX",
+	};
+	const std::size_t trafficCount = sizeof(traffic) / sizeof(traffic[0]);
+
+	std::uint32_t ReadTag(const unsigned char* buf)
+	{
+		return (std::uint32_t)buf[0] << 24 | (std::uint32_t)buf[1] << 16 |
+			(std::uint32_t)buf[2] << 8 | (std::uint32_t)buf[3];
+	}
+
+	double RunStringMap(unsigned char (*msgs)[8], long iterations)
+	{
+		std::map<std::string, MessageHandler> handlers;
+		for (std::size_t i = 0; i < headCount; ++i)
+		{
+			handlers.insert(std::make_pair(heads[i], MessageHandlers::GetHandler(ReadTag((const unsigned char*)heads[i]))));
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long i = 0; i < iterations; ++i)
+		{
+			const unsigned char* buf = msgs[i % trafficCount];
+			std::string head((const char*)buf, 4);
+			std::map<std::string, MessageHandler>::iterator iter = handlers.find(head);
+			sink = iter != handlers.end() ? iter->second : NULL;
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count() / iterations;
+	}
+
+	double RunGetHandler(unsigned char (*msgs)[8], long iterations)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long i = 0; i < iterations; ++i)
+		{
+			const unsigned char* buf = msgs[i % trafficCount];
+			sink = MessageHandlers::GetHandler(ReadTag(buf));
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		return elapsed.count() / iterations;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	long iterations = argc > 1 ? std::atol(argv[1]) : 10000000;
+	if (iterations <= 0)
+	{
+		std::fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	// Sanity check that the compile time tags match the runtime encoding and
+	// that every header is known to the plugin.
+	static_assert(XPC::MessageTag("CONN") < XPC::MessageTag("CTRL"), "Tags must sort like headers");
+	if (ReadTag((const unsigned char*)"POSI") != XPC::MessageTag("POSI"))
+	{
+		std::fprintf(stderr, "Tag encoding mismatch\n");
+		return 1;
+	}
+	for (std::size_t i = 0; i < headCount; ++i)
+	{
+		if (!MessageHandlers::GetHandler(ReadTag((const unsigned char*)heads[i])))
+		{
+			std::fprintf(stderr, "No handler for %s\n", heads[i]);
+			return 1;
+		}
+	}
+
+	unsigned char msgs[sizeof(traffic) / sizeof(traffic[0])][8] = { { 0 } };
+	for (std::size_t i = 0; i < trafficCount; ++i)
+	{
+		std::copy(traffic[i], traffic[i] + 4, msgs[i]);
+	}
+
+	double before = RunStringMap(msgs, iterations);
+	double after = RunGetHandler(msgs, iterations);
+	std::printf("%-34s %8.2f ns/message\n", "std::string + std::map", before);
+	std::printf("%-34s %8.2f ns/message\n", "MessageHandlers::GetHandler", after);
+	std::printf("Speedup: %.1fx\n", before / after);
+	return 0;
+}
@@ -0,0 +1,145 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "ConnectionTable.h"
+#include "Log.h"
+
+#include <utility>
+
+namespace XPC
+{
+	static const char* const tag = "CONN";
+
+	ConnectionTable::ConnectionTable() : nextId(0) {}
+
+	std::uint64_t ConnectionTable::MakeKey(const sockaddr& addr)
+	{
+		// Plugin sockets are IPv4, so the family, port, and address together
+		// fit in 64 bits. The port and address are left in network order;
+		// only equality matters here.
+		std::uint64_t key = (std::uint64_t)addr.sa_family << 48;
+		if (addr.sa_family == AF_INET)
+		{
+			const sockaddr_in* sin = reinterpret_cast<const sockaddr_in*>(&addr);
+			key |= (std::uint64_t)sin->sin_port << 32;
+			key |= (std::uint64_t)sin->sin_addr.s_addr;
+		}
+		else
+		{
+			// Not expected on a plugin socket. Fold in the raw address bytes.
+			std::uint64_t data = 0;
+			for (std::size_t i = 0; i < sizeof(addr.sa_data); ++i)
+			{
+				data = data * 31 + (unsigned char)addr.sa_data[i];
+			}
+			key |= data & 0xFFFFFFFFFFFFULL;
+		}
+		return key;
+	}
+
+	std::size_t ConnectionTable::KeyHash::operator()(std::uint64_t key) const
+	{
+		// Final mixing step from MurmurHash3. Clients on one host differ only
+		// in a few port bits, so spread those over the whole hash.
+		key ^= key >> 33;
+		key *= 0xFF51AFD7ED558CCDULL;
+		key ^= key >> 33;
+		key *= 0xC4CEB9FE1A85EC53ULL;
+		key ^= key >> 33;
+		return (std::size_t)key;
+	}
+
+	ConnectionInfo* ConnectionTable::Get(const sockaddr& addr, bool& isNew)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::uint64_t key = MakeKey(addr);
+		Map::iterator iter = connections.find(key);
+		if (iter != connections.end())
+		{
+			isNew = false;
+			iter->second->lastSeen = now;
+			return iter->second.get();
+		}
+
+		isNew = true;
+		ConnectionInfo* conn = new ConnectionInfo();
+		conn->id = nextId++;
+		conn->addr = addr;
+		conn->lastSeen = now;
+		conn->getdSize = 0;
+		conn->getySize = 0;
+		conn->subs.size = 0;
+		conn->subs.divisor = 0;
+		conn->subs.frames = 0;
+		conn->subs.port = 0;
+		conn->subs.changesOnly = false;
+		conn->subs.keyframeInterval = 0;
+		conn->subs.sinceKeyframe = 0;
+		connections[key].reset(conn);
+		return conn;
+	}
+
+	void ConnectionTable::Rebind(ConnectionInfo* conn, const sockaddr& addr)
+	{
+		std::uint64_t oldKey = MakeKey(conn->addr);
+		std::uint64_t newKey = MakeKey(addr);
+		if (oldKey == newKey)
+		{
+			return;
+		}
+
+		Map::iterator iter = connections.find(oldKey);
+		if (iter == connections.end() || iter->second.get() != conn)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Connection %u is not in the connection table", conn->id);
+			return;
+		}
+		std::unique_ptr<ConnectionInfo> owned(iter->second.release());
+		connections.erase(iter);
+
+		conn->addr = addr;
+		std::unique_ptr<ConnectionInfo>& slot = connections[newKey];
+		if (slot)
+		{
+			Log::FormatLine(LOG_DEBUG, tag, "Connection %u replaces connection %u", conn->id, slot->id);
+		}
+		slot = std::move(owned);
+	}
+
+	std::size_t ConnectionTable::EvictIdle(std::chrono::seconds maxIdle)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now < nextSweep)
+		{
+			return 0;
+		}
+		nextSweep = now + std::chrono::seconds(1);
+
+		std::size_t removed = 0;
+		std::chrono::steady_clock::time_point cutoff = now - maxIdle;
+		Map::iterator iter = connections.begin();
+		while (iter != connections.end())
+		{
+			if (iter->second->lastSeen < cutoff)
+			{
+				Log::FormatLine(LOG_DEBUG, tag, "Removing idle connection. ID=%u", iter->second->id);
+				iter = connections.erase(iter);
+				++removed;
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		return removed;
+	}
+
+	void ConnectionTable::Clear()
+	{
+		connections.clear();
+	}
+
+	std::size_t ConnectionTable::Size() const
+	{
+		return connections.size();
+	}
+}
@@ -0,0 +1,182 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_CONNECTIONTABLE_H_
+#define XPCPLUGIN_CONNECTIONTABLE_H_
+
+#include "DataManager.h"
+#include "UDPSocket.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace XPC
+{
+	/// One dataref in a compiled GETD request.
+	struct GetdPlanEntry
+	{
+		/// The dataref to read. The count is limited to what fits in the
+		/// response.
+		ResolvedDref dref;
+
+		/// The offset in the RESP message of the element count for this
+		/// dataref. The values immediately follow the count.
+		std::size_t offset;
+	};
+
+	/// A request from a client to be sent the values of a set of datarefs
+	/// periodically without asking for them.
+	struct Subscription
+	{
+		/// The datarefs to send, compiled as for GETD.
+		std::vector<GetdPlanEntry> plan;
+
+		/// The size in bytes of the RESP message produced by plan.
+		std::size_t size;
+
+		/// Values are sent once every divisor frames. 0 if the client is not
+		/// subscribed.
+		unsigned short divisor;
+
+		/// The number of frames since values were last sent.
+		unsigned short frames;
+
+		/// The port to send values to, or 0 to use the connection's port.
+		unsigned short port;
+
+		/// If true, only values that have moved further than their deadband
+		/// since they were last sent are sent, as RESD messages, with a full
+		/// RESP message sent periodically as a keyframe.
+		bool changesOnly;
+
+		/// The number of updates between keyframes. At least 1 whenever
+		/// changesOnly is set.
+		unsigned short keyframeInterval;
+
+		/// The number of updates sent since the last keyframe.
+		unsigned short sinceKeyframe;
+
+		/// The deadband for each dataref in plan. A value is sent when it
+		/// differs from the last value sent by more than its deadband.
+		std::vector<float> deadbands;
+
+		/// The last value sent for each element of each dataref in plan.
+		/// Empty until the first keyframe is sent.
+		std::vector<float> lastSent;
+	};
+
+	/// Per-client state kept between messages.
+	struct ConnectionInfo
+	{
+		/// A unique id for the connection. Ids are never reused while the
+		/// plugin is enabled.
+		std::uint32_t id;
+
+		/// The address responses are sent to.
+		sockaddr addr;
+
+		/// The last time a message was received from the client.
+		std::chrono::steady_clock::time_point lastSeen;
+
+		/// The last GETD request from the client, compiled so that it can be
+		/// repeated without looking up any datarefs.
+		std::vector<GetdPlanEntry> getdPlan;
+
+		/// The size in bytes of the RESP message produced by getdPlan.
+		std::size_t getdSize;
+
+		/// The last GETY request from the client, compiled as for GETD but
+		/// laid out for a typed REST response.
+		std::vector<GetdPlanEntry> getyPlan;
+
+		/// The size in bytes of the REST message produced by getyPlan.
+		std::size_t getySize;
+
+		/// The last GETF request from the client. Not limited to what fits
+		/// in one datagram, since the response is split into fragments.
+		std::vector<GetdPlanEntry> getfPlan;
+
+		/// The client's dataref subscription, if any.
+		Subscription subs;
+
+		/// Datarefs resolved by RSLV messages. The index of each dataref is
+		/// the id the client uses to refer to it.
+		std::vector<ResolvedDref> drefIds;
+	};
+
+	/// Tracks the clients the plugin has received messages from.
+	///
+	/// \details Connections are keyed on the binary address and port of the
+	///          client, so looking up an existing connection does not format
+	///          or allocate anything. Records are heap allocated once when a
+	///          client first connects and never move afterwards, so pointers
+	///          returned by the table stay valid until the connection is
+	///          evicted or the table is cleared.
+	class ConnectionTable
+	{
+	public:
+		/// Initializes a new, empty connection table.
+		ConnectionTable();
+
+		/// Gets the connection for the specified remote address, creating it
+		/// if the address has not been seen before, and marks it as active.
+		///
+		/// \param addr  The address of the client.
+		/// \param isNew Set to true if a new connection was created.
+		/// \returns     The connection record. Never NULL.
+		ConnectionInfo* Get(const sockaddr& addr, bool& isNew);
+
+		/// Changes the address of an existing connection, e.g. when a client
+		/// asks for responses to be sent to a different port. Any other
+		/// connection already using the new address is removed.
+		///
+		/// \param conn The connection to update.
+		/// \param addr The new address.
+		void Rebind(ConnectionInfo* conn, const sockaddr& addr);
+
+		/// Removes connections that have not sent a message in the specified
+		/// amount of time.
+		///
+		/// \details Sweeping is rate limited to once per second, so it is safe
+		///          to call this every frame.
+		/// \param maxIdle How long a connection may be idle before it is removed.
+		/// \returns       The number of connections removed.
+		std::size_t EvictIdle(std::chrono::seconds maxIdle);
+
+		/// Removes all connections.
+		void Clear();
+
+		/// Calls the specified function once for each connection.
+		///
+		/// \param visit A callable taking a ConnectionInfo&. Must not add or
+		///              remove connections.
+		template <typename Visitor>
+		void ForEach(Visitor visit)
+		{
+			for (Map::iterator iter = connections.begin(); iter != connections.end(); ++iter)
+			{
+				visit(*iter->second);
+			}
+		}
+
+		/// Gets the number of connections in the table.
+		std::size_t Size() const;
+
+	private:
+		static std::uint64_t MakeKey(const sockaddr& addr);
+
+		struct KeyHash
+		{
+			std::size_t operator()(std::uint64_t key) const;
+		};
+
+		typedef std::unordered_map<std::uint64_t, std::unique_ptr<ConnectionInfo>, KeyHash> Map;
+
+		Map connections;
+		std::uint32_t nextId;
+		std::chrono::steady_clock::time_point nextSweep;
+	};
+}
+#endif
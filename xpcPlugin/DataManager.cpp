@@ -16,6 +16,7 @@
 //     Laminar Research, respectively.
 #include "DataManager.h"
 #include "Log.h"
+#include "Statistics.h"
 
 #include "XPLMDataAccess.h"
 #include "XPLMGraphics.h"
@@ -23,7 +24,9 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <map>
 
 namespace XPC
@@ -31,168 +34,196 @@ namespace XPC
 	using namespace std;
 
 	const size_t PLANE_COUNT = 20;
-	static map<DREF, XPLMDataRef> drefs;
-	static map<DREF, XPLMDataRef> mdrefs[PLANE_COUNT];
 	static map<string, XPLMDataRef> sdrefs;
 
+	struct DrefName
+	{
+		DREF dref;
+		const char* name;
+	};
+
+	// Names of the named datarefs for the player aircraft.
+	static const DrefName playerNames[] =
+	{
+		{ DREF_None, "sim/test/test_float" },
+		{ DREF_Pause, "sim/operation/override/override_planepath" },
+		{ DREF_PauseAI, "sim/operation/override/override_plane_ai_autopilot" },
+		{ DREF_TotalRuntime, "sim/time/total_running_time_sec" },
+		{ DREF_TotalFlighttime, "sim/time/total_flight_time_sec" },
+		{ DREF_TimerElapsedtime, "sim/time/timer_elapsed_time_sec" },
+		{ DREF_IndicatedAirspeed, "sim/flightmodel/position/indicated_airspeed" },
+		{ DREF_TrueAirspeed, "sim/flightmodel/position/true_airspeed" },
+		{ DREF_GroundSpeed, "sim/flightmodel/position/groundspeed" },
+		{ DREF_MachNumber, "sim/flightmodel/misc/machno" },
+		{ DREF_GForceNormal, "sim/flightmodel2/misc/gforce_normal" },
+		{ DREF_GForceAxial, "sim/flightmodel2/misc/gforce_axial" },
+		{ DREF_GForceSide, "sim/flightmodel2/misc/gforce_side" },
+		{ DREF_BarometerSealevelInHg, "sim/weather/barometer_sealevel_inhg" },
+		{ DREF_TemperaturSealevelC, "sim/weather/temperature_sealevel_c" },
+		{ DREF_WindSpeedKts, "sim/cockpit2/gauges/indicators/wind_speed_kts" },
+		{ DREF_YokePitch, "sim/joystick/yoke_pitch_ratio" },
+		{ DREF_YokeRoll, "sim/joystick/yoke_roll_ratio" },
+		{ DREF_YokeHeading, "sim/joystick/yoke_heading_ratio" },
+		{ DREF_Elevator, "sim/cockpit2/controls/yoke_pitch_ratio" },
+		{ DREF_Aileron, "sim/cockpit2/controls/yoke_roll_ratio" },
+		{ DREF_Rudder, "sim/cockpit2/controls/yoke_heading_ratio" },
+		{ DREF_FlapSetting, "sim/flightmodel/controls/flaprqst" },
+		{ DREF_FlapActual, "sim/flightmodel/controls/flaprat" },
+		{ DREF_SpeedBrakeSet, "sim/flightmodel/controls/sbrkrqst" },
+		{ DREF_SpeedBrakeActual, "sim/flightmodel/controls/sbrkrat" },
+		{ DREF_GearDeploy, "sim/aircraft/parts/acf_gear_deploy" },
+		{ DREF_GearHandle, "sim/cockpit/switches/gear_handle_status" },
+		{ DREF_BrakeParking, "sim/flightmodel/controls/parkbrakel" },
+		{ DREF_BrakeLeft, "sim/cockpit2/controls/left_brake_ratio" },
+		{ DREF_BrakeRight, "sim/cockpit2/controls/right_brake_ratio" },
+		{ DREF_M, "sim/flightmodel/position/M" },
+		{ DREF_L, "sim/flightmodel/position/L" },
+		{ DREF_N, "sim/flightmodel/position/N" },
+		{ DREF_QRad, "sim/flightmodel/position/Qrad" },
+		{ DREF_PRad, "sim/flightmodel/position/Prad" },
+		{ DREF_RRad, "sim/flightmodel/position/Rrad" },
+		{ DREF_Q, "sim/flightmodel/position/Q" },
+		{ DREF_P, "sim/flightmodel/position/P" },
+		{ DREF_R, "sim/flightmodel/position/R" },
+		{ DREF_Pitch, "sim/flightmodel/position/theta" },
+		{ DREF_Roll, "sim/flightmodel/position/phi" },
+		{ DREF_HeadingTrue, "sim/flightmodel/position/psi" },
+		{ DREF_HeadingMag, "sim/flightmodel/position/magpsi" },
+		{ DREF_Quaternion, "sim/flightmodel/position/q" },
+		{ DREF_AngleOfAttack, "sim/flightmodel/position/alpha" },
+		{ DREF_Sideslip, "sim/cockpit2/gauges/indicators/sideslip_degrees" },
+		{ DREF_HPath, "sim/flightmodel/position/hpath" },
+		{ DREF_VPath, "sim/flightmodel/position/vpath" },
+		{ DREF_MagneticVariation, "sim/flightmodel/position/magnetic_variation" },
+		{ DREF_Latitude, "sim/flightmodel/position/latitude" },
+		{ DREF_Longitude, "sim/flightmodel/position/longitude" },
+		{ DREF_AGL, "sim/flightmodel/position/y_agl" },
+		{ DREF_Elevation, "sim/flightmodel/position/elevation" },
+		{ DREF_LocalX, "sim/flightmodel/position/local_x" },
+		{ DREF_LocalY, "sim/flightmodel/position/local_y" },
+		{ DREF_LocalZ, "sim/flightmodel/position/local_z" },
+		{ DREF_LocalVX, "sim/flightmodel/position/local_vx" },
+		{ DREF_LocalVY, "sim/flightmodel/position/local_vy" },
+		{ DREF_LocalVZ, "sim/flightmodel/position/local_vz" },
+		{ DREF_ThrottleSet, "sim/flightmodel/engine/ENGN_thro" },
+		{ DREF_ThrottleActual, "sim/flightmodel2/engines/throttle_used_ratio" },
+		{ DREF_MP1Lat, "sim/multiplayer/position/plane1_lat" },
+		{ DREF_MP2Lat, "sim/multiplayer/position/plane2_lat" },
+		{ DREF_MP3Lat, "sim/multiplayer/position/plane3_lat" },
+		{ DREF_MP4Lat, "sim/multiplayer/position/plane4_lat" },
+		{ DREF_MP5Lat, "sim/multiplayer/position/plane5_lat" },
+		{ DREF_MP6Lat, "sim/multiplayer/position/plane6_lat" },
+		{ DREF_MP7Lat, "sim/multiplayer/position/plane7_lat" },
+		{ DREF_MP1Lon, "sim/multiplayer/position/plane1_lon" },
+		{ DREF_MP2Lon, "sim/multiplayer/position/plane2_lon" },
+		{ DREF_MP3Lon, "sim/multiplayer/position/plane3_lon" },
+		{ DREF_MP4Lon, "sim/multiplayer/position/plane4_lon" },
+		{ DREF_MP5Lon, "sim/multiplayer/position/plane5_lon" },
+		{ DREF_MP6Lon, "sim/multiplayer/position/plane6_lon" },
+		{ DREF_MP7Lon, "sim/multiplayer/position/plane7_lon" },
+		{ DREF_MP1Alt, "sim/multiplayer/position/plane1_el" },
+		{ DREF_MP2Alt, "sim/multiplayer/position/plane2_el" },
+		{ DREF_MP3Alt, "sim/multiplayer/position/plane3_el" },
+		{ DREF_MP4Alt, "sim/multiplayer/position/plane4_el" },
+		{ DREF_MP5Alt, "sim/multiplayer/position/plane5_el" },
+		{ DREF_MP6Alt, "sim/multiplayer/position/plane6_el" },
+		{ DREF_MP7Alt, "sim/multiplayer/position/plane7_el" },
+	};
+
+	// Suffixes of the sim/multiplayer/position/plane<n>_ datarefs for the
+	// other aircraft.
+	static const DrefName multiplayerNames[] =
+	{
+		{ DREF_LocalX, "x" },
+		{ DREF_LocalY, "y" },
+		{ DREF_LocalZ, "z" },
+		{ DREF_LocalVX, "v_x" },
+		{ DREF_LocalVY, "v_y" },
+		{ DREF_LocalVZ, "v_z" },
+		{ DREF_Latitude, "lat" },
+		{ DREF_Longitude, "lon" },
+		{ DREF_Elevation, "el" },
+		{ DREF_Pitch, "the" },
+		{ DREF_Roll, "phi" },
+		{ DREF_HeadingTrue, "psi" },
+		{ DREF_GearDeploy, "gear_deploy" },
+		{ DREF_FlapActual, "flap_ratio" },
+		{ DREF_FlapSetting, "flap_ratio" }, // Can't set the actual flap setting on npc aircraft
+		{ DREF_FlapActual2, "flap_ratio2" },
+		{ DREF_Spoiler, "spoiler_ratio" },
+		{ DREF_SpeedBrakeSet, "speedbrake_ratio" },
+		{ DREF_Slats, "slat_ratio" },
+		{ DREF_Sweep, "wing_sweep" },
+		{ DREF_ThrottleActual, "throttle" },
+		{ DREF_ThrottleSet, "throttle" }, // No throttle set for multiplayer planes.
+		{ DREF_YokePitch, "yolk_pitch" },
+		{ DREF_YokeRoll, "yolk_roll" },
+		{ DREF_YokeHeading, "yolk_yaw" },
+	};
+
+	// A named dataref for one aircraft, resolved the first time it is used.
+	struct DrefSlot
+	{
+		XPLMDataRef xdref;
+		bool resolved;
+	};
+
+	static DrefSlot slots[PLANE_COUNT][DREF_Count];
+
+	// Gets the X-Plane handle for a named dataref, looking it up if this is
+	// the first time it has been used since the aircraft was loaded.
+	static const DrefSlot& GetSlot(DREF dref, char aircraft)
+	{
+		static const DrefSlot invalid = { NULL, true };
+		unsigned char ac = (unsigned char)aircraft;
+		if (ac >= PLANE_COUNT || dref < DREF_None || dref >= DREF_Count)
+		{
+			return invalid;
+		}
+		DrefSlot& slot = slots[ac][dref];
+		if (slot.resolved)
+		{
+			return slot;
+		}
+
+		slot.resolved = true;
+		slot.xdref = NULL;
+		if (ac == 0)
+		{
+			for (size_t i = 0; i < sizeof(playerNames) / sizeof(playerNames[0]); ++i)
+			{
+				if (playerNames[i].dref == dref)
+				{
+					slot.xdref = XPLMFindDataRef(playerNames[i].name);
+					break;
+				}
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < sizeof(multiplayerNames) / sizeof(multiplayerNames[0]); ++i)
+			{
+				if (multiplayerNames[i].dref == dref)
+				{
+					char name[256];
+					sprintf(name, "sim/multiplayer/position/plane%i_%s", ac, multiplayerNames[i].name);
+					slot.xdref = XPLMFindDataRef(name);
+					break;
+				}
+			}
+		}
+		Log::FormatLine(LOG_TRACE, "DMAN", "Resolved DREF %i for a/c %i (x:%X)", dref, ac, slot.xdref);
+		return slot;
+	}
+
 	DREF XPData[134][8] = { DREF_None };
 
 	void DataManager::Initialize()
 	{
 		Log::WriteLine(LOG_TRACE, "DMAN", "Initializing drefs");
 
-		drefs.insert(make_pair(DREF_None, XPLMFindDataRef("sim/test/test_float")));
-
-		drefs.insert(make_pair(DREF_Pause, XPLMFindDataRef("sim/operation/override/override_planepath")));
-		drefs.insert(make_pair(DREF_PauseAI, XPLMFindDataRef("sim/operation/override/override_plane_ai_autopilot")));
-
-		drefs.insert(make_pair(DREF_TotalRuntime, XPLMFindDataRef("sim/time/total_running_time_sec")));
-		drefs.insert(make_pair(DREF_TotalFlighttime, XPLMFindDataRef("sim/time/total_flight_time_sec")));
-		drefs.insert(make_pair(DREF_TimerElapsedtime, XPLMFindDataRef("sim/time/timer_elapsed_time_sec")));
-
-		drefs.insert(make_pair(DREF_IndicatedAirspeed, XPLMFindDataRef("sim/flightmodel/position/indicated_airspeed")));
-		drefs.insert(make_pair(DREF_TrueAirspeed, XPLMFindDataRef("sim/flightmodel/position/true_airspeed")));
-		drefs.insert(make_pair(DREF_GroundSpeed, XPLMFindDataRef("sim/flightmodel/position/groundspeed")));
-
-		drefs.insert(make_pair(DREF_MachNumber, XPLMFindDataRef("sim/flightmodel/misc/machno")));
-		drefs.insert(make_pair(DREF_GForceNormal, XPLMFindDataRef("sim/flightmodel2/misc/gforce_normal")));
-		drefs.insert(make_pair(DREF_GForceAxial, XPLMFindDataRef("sim/flightmodel2/misc/gforce_axial")));
-		drefs.insert(make_pair(DREF_GForceSide, XPLMFindDataRef("sim/flightmodel2/misc/gforce_side")));
-
-		drefs.insert(make_pair(DREF_BarometerSealevelInHg, XPLMFindDataRef("sim/weather/barometer_sealevel_inhg")));
-		drefs.insert(make_pair(DREF_TemperaturSealevelC, XPLMFindDataRef("sim/weather/temperature_sealevel_c")));
-		drefs.insert(make_pair(DREF_WindSpeedKts, XPLMFindDataRef("sim/cockpit2/gauges/indicators/wind_speed_kts")));
-
-		drefs.insert(make_pair(DREF_YokePitch, XPLMFindDataRef("sim/joystick/yoke_pitch_ratio")));
-		drefs.insert(make_pair(DREF_YokeRoll, XPLMFindDataRef("sim/joystick/yoke_roll_ratio")));
-		drefs.insert(make_pair(DREF_YokeHeading, XPLMFindDataRef("sim/joystick/yoke_heading_ratio")));
-
-		drefs.insert(make_pair(DREF_Elevator, XPLMFindDataRef("sim/cockpit2/controls/yoke_pitch_ratio")));
-		drefs.insert(make_pair(DREF_Aileron, XPLMFindDataRef("sim/cockpit2/controls/yoke_roll_ratio")));
-		drefs.insert(make_pair(DREF_Rudder, XPLMFindDataRef("sim/cockpit2/controls/yoke_heading_ratio")));
-
-		drefs.insert(make_pair(DREF_FlapSetting, XPLMFindDataRef("sim/flightmodel/controls/flaprqst")));
-		drefs.insert(make_pair(DREF_FlapActual, XPLMFindDataRef("sim/flightmodel/controls/flaprat")));
-
-		drefs.insert(make_pair(DREF_SpeedBrakeSet, XPLMFindDataRef("sim/flightmodel/controls/sbrkrqst")));
-		drefs.insert(make_pair(DREF_SpeedBrakeActual, XPLMFindDataRef("sim/flightmodel/controls/sbrkrat")));
-
-		drefs.insert(make_pair(DREF_GearDeploy, XPLMFindDataRef("sim/aircraft/parts/acf_gear_deploy")));
-		drefs.insert(make_pair(DREF_GearHandle, XPLMFindDataRef("sim/cockpit/switches/gear_handle_status")));
-		drefs.insert(make_pair(DREF_BrakeParking, XPLMFindDataRef("sim/flightmodel/controls/parkbrakel")));
-		drefs.insert(make_pair(DREF_BrakeLeft, XPLMFindDataRef("sim/cockpit2/controls/left_brake_ratio")));
-		drefs.insert(make_pair(DREF_BrakeRight, XPLMFindDataRef("sim/cockpit2/controls/right_brake_ratio")));
-
-		drefs.insert(make_pair(DREF_M, XPLMFindDataRef("sim/flightmodel/position/M")));
-		drefs.insert(make_pair(DREF_L, XPLMFindDataRef("sim/flightmodel/position/L")));
-		drefs.insert(make_pair(DREF_N, XPLMFindDataRef("sim/flightmodel/position/N")));
-
-		drefs.insert(make_pair(DREF_QRad, XPLMFindDataRef("sim/flightmodel/position/Qrad")));
-		drefs.insert(make_pair(DREF_PRad, XPLMFindDataRef("sim/flightmodel/position/Prad")));
-		drefs.insert(make_pair(DREF_RRad, XPLMFindDataRef("sim/flightmodel/position/Rrad")));
-		drefs.insert(make_pair(DREF_Q, XPLMFindDataRef("sim/flightmodel/position/Q")));
-		drefs.insert(make_pair(DREF_P, XPLMFindDataRef("sim/flightmodel/position/P")));
-		drefs.insert(make_pair(DREF_R, XPLMFindDataRef("sim/flightmodel/position/R")));
-
-		drefs.insert(make_pair(DREF_Pitch, XPLMFindDataRef("sim/flightmodel/position/theta")));
-		drefs.insert(make_pair(DREF_Roll, XPLMFindDataRef("sim/flightmodel/position/phi")));
-		drefs.insert(make_pair(DREF_HeadingTrue, XPLMFindDataRef("sim/flightmodel/position/psi")));
-		drefs.insert(make_pair(DREF_HeadingMag, XPLMFindDataRef("sim/flightmodel/position/magpsi")));
-		drefs.insert(make_pair(DREF_Quaternion, XPLMFindDataRef("sim/flightmodel/position/q")));
-
-		drefs.insert(make_pair(DREF_AngleOfAttack, XPLMFindDataRef("sim/flightmodel/position/alpha")));
-		drefs.insert(make_pair(DREF_Sideslip, XPLMFindDataRef("sim/cockpit2/gauges/indicators/sideslip_degrees")));
-		drefs.insert(make_pair(DREF_HPath, XPLMFindDataRef("sim/flightmodel/position/hpath")));
-		drefs.insert(make_pair(DREF_VPath, XPLMFindDataRef("sim/flightmodel/position/vpath")));
-
-		drefs.insert(make_pair(DREF_MagneticVariation, XPLMFindDataRef("sim/flightmodel/position/magnetic_variation")));
-
-		drefs.insert(make_pair(DREF_Latitude, XPLMFindDataRef("sim/flightmodel/position/latitude")));
-		drefs.insert(make_pair(DREF_Longitude, XPLMFindDataRef("sim/flightmodel/position/longitude")));
-		drefs.insert(make_pair(DREF_AGL, XPLMFindDataRef("sim/flightmodel/position/y_agl")));
-		drefs.insert(make_pair(DREF_Elevation, XPLMFindDataRef("sim/flightmodel/position/elevation")));
-
-		drefs.insert(make_pair(DREF_LocalX, XPLMFindDataRef("sim/flightmodel/position/local_x")));
-		drefs.insert(make_pair(DREF_LocalY, XPLMFindDataRef("sim/flightmodel/position/local_y")));
-		drefs.insert(make_pair(DREF_LocalZ, XPLMFindDataRef("sim/flightmodel/position/local_z")));
-		drefs.insert(make_pair(DREF_LocalVX, XPLMFindDataRef("sim/flightmodel/position/local_vx")));
-		drefs.insert(make_pair(DREF_LocalVY, XPLMFindDataRef("sim/flightmodel/position/local_vy")));
-		drefs.insert(make_pair(DREF_LocalVZ, XPLMFindDataRef("sim/flightmodel/position/local_vz")));
-
-		drefs.insert(make_pair(DREF_ThrottleSet, XPLMFindDataRef("sim/flightmodel/engine/ENGN_thro")));
-		drefs.insert(make_pair(DREF_ThrottleActual, XPLMFindDataRef("sim/flightmodel2/engines/throttle_used_ratio")));
-
-		drefs.insert(make_pair(DREF_MP1Lat, XPLMFindDataRef("sim/multiplayer/position/plane1_lat")));
-		drefs.insert(make_pair(DREF_MP2Lat, XPLMFindDataRef("sim/multiplayer/position/plane2_lat")));
-		drefs.insert(make_pair(DREF_MP3Lat, XPLMFindDataRef("sim/multiplayer/position/plane3_lat")));
-		drefs.insert(make_pair(DREF_MP4Lat, XPLMFindDataRef("sim/multiplayer/position/plane4_lat")));
-		drefs.insert(make_pair(DREF_MP5Lat, XPLMFindDataRef("sim/multiplayer/position/plane5_lat")));
-		drefs.insert(make_pair(DREF_MP6Lat, XPLMFindDataRef("sim/multiplayer/position/plane6_lat")));
-		drefs.insert(make_pair(DREF_MP7Lat, XPLMFindDataRef("sim/multiplayer/position/plane7_lat")));
-
-		drefs.insert(make_pair(DREF_MP1Lon, XPLMFindDataRef("sim/multiplayer/position/plane1_lon")));
-		drefs.insert(make_pair(DREF_MP2Lon, XPLMFindDataRef("sim/multiplayer/position/plane2_lon")));
-		drefs.insert(make_pair(DREF_MP3Lon, XPLMFindDataRef("sim/multiplayer/position/plane3_lon")));
-		drefs.insert(make_pair(DREF_MP4Lon, XPLMFindDataRef("sim/multiplayer/position/plane4_lon")));
-		drefs.insert(make_pair(DREF_MP5Lon, XPLMFindDataRef("sim/multiplayer/position/plane5_lon")));
-		drefs.insert(make_pair(DREF_MP6Lon, XPLMFindDataRef("sim/multiplayer/position/plane6_lon")));
-		drefs.insert(make_pair(DREF_MP7Lon, XPLMFindDataRef("sim/multiplayer/position/plane7_lon")));
-
-		drefs.insert(make_pair(DREF_MP1Alt, XPLMFindDataRef("sim/multiplayer/position/plane1_el")));
-		drefs.insert(make_pair(DREF_MP2Alt, XPLMFindDataRef("sim/multiplayer/position/plane2_el")));
-		drefs.insert(make_pair(DREF_MP3Alt, XPLMFindDataRef("sim/multiplayer/position/plane3_el")));
-		drefs.insert(make_pair(DREF_MP4Alt, XPLMFindDataRef("sim/multiplayer/position/plane4_el")));
-		drefs.insert(make_pair(DREF_MP5Alt, XPLMFindDataRef("sim/multiplayer/position/plane5_el")));
-		drefs.insert(make_pair(DREF_MP6Alt, XPLMFindDataRef("sim/multiplayer/position/plane6_el")));
-		drefs.insert(make_pair(DREF_MP7Alt, XPLMFindDataRef("sim/multiplayer/position/plane7_el")));
-
-		char multi[256];
-		for (int i = 1; i < PLANE_COUNT; i++)
-		{
-			sprintf(multi, "sim/multiplayer/position/plane%i_x", i);
-			mdrefs[i][DREF_LocalX] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_y", i);
-			mdrefs[i][DREF_LocalY] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_z", i);
-			mdrefs[i][DREF_LocalZ] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_lat", i);
-			mdrefs[i][DREF_Latitude] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_lon", i);
-			mdrefs[i][DREF_Longitude] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_el", i);
-			mdrefs[i][DREF_Elevation] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_the", i);
-			mdrefs[i][DREF_Pitch] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_phi", i);
-			mdrefs[i][DREF_Roll] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_psi", i);
-			mdrefs[i][DREF_HeadingTrue] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_gear_deploy", i);
-			mdrefs[i][DREF_GearDeploy] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_flap_ratio", i);
-			mdrefs[i][DREF_FlapActual] = XPLMFindDataRef(multi);
-			mdrefs[i][DREF_FlapSetting] = mdrefs[i][DREF_FlapActual]; // Can't set the actual flap setting on npc aircraft
-			sprintf(multi, "sim/multiplayer/position/plane%i_flap_ratio2", i);
-			mdrefs[i][DREF_FlapActual2] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_spoiler_ratio", i);
-			mdrefs[i][DREF_Spoiler] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_speedbrake_ratio", i);
-			mdrefs[i][DREF_SpeedBrakeSet] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_slat_ratio", i);
-			mdrefs[i][DREF_Slats] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_wing_sweep", i);
-			mdrefs[i][DREF_Sweep] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_throttle", i);
-			mdrefs[i][DREF_ThrottleActual] = XPLMFindDataRef(multi);
-			mdrefs[i][DREF_ThrottleSet] = mdrefs[i][DREF_ThrottleActual]; // No throttle set for multiplayer planes.
-			sprintf(multi, "sim/multiplayer/position/plane%i_yolk_pitch", i);
-			mdrefs[i][DREF_YokePitch] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_yolk_roll", i);
-			mdrefs[i][DREF_YokeRoll] = XPLMFindDataRef(multi);
-			sprintf(multi, "sim/multiplayer/position/plane%i_yolk_yaw", i);
-			mdrefs[i][DREF_YokeHeading] = XPLMFindDataRef(multi);
-		}
-
+		// Named datarefs are looked up on first use, so only the XPData map
+		// needs to be set up here.
 		// Row 0: Frame Rates
 		// Row 1: Times
 		XPData[1][1] = DREF_TotalRuntime;
@@ -305,9 +336,42 @@ namespace XPC
 		XPData[26][0] = DREF_ThrottleActual;
 	}
 
+	void DataManager::Invalidate(int aircraft)
+	{
+		if (aircraft < 0 || (size_t)aircraft >= PLANE_COUNT)
+		{
+			return;
+		}
+		Log::FormatLine(LOG_TRACE, "DMAN", "Invalidating drefs for a/c %i", aircraft);
+		for (int i = 0; i < DREF_Count; ++i)
+		{
+			slots[aircraft][i].resolved = false;
+		}
+	}
+
 	int DataManager::Get(const string& dref, float values[], int size)
 	{
 		Log::WriteLine(LOG_TRACE, "DMAN", "Entered Get(string, float*, int)");
+		ResolvedDref resolved = Resolve(dref);
+		if (!resolved.xdref)
+		{
+			return 0;
+		}
+
+		Log::FormatLine(LOG_INFO, "DMAN", "Get DREF %s (x:%X) Type: %i", dref.c_str(), resolved.xdref, resolved.type);
+		if (resolved.count > size)
+		{
+			Log::WriteLine(LOG_WARN, "DMAN", "Warning: dref size is larger than available space");
+			Log::FormatLine(LOG_DEBUG, "DMAN", "Actual dref size : %i, Available size : %i", resolved.count, size);
+		}
+		int count = Read(resolved, values, size);
+		Log::FormatLine(LOG_INFO, "DMAN", " -- value count was %i", count);
+		return count;
+	}
+
+	ResolvedDref DataManager::Resolve(const string& dref, bool native)
+	{
+		ResolvedDref resolved = { NULL, xplmType_Unknown, 0 };
 		XPLMDataRef& xdref = sdrefs[dref];
 		if (xdref == NULL)
 		{
@@ -315,105 +379,436 @@ namespace XPC
 		}
 		if (!xdref) // DREF does not exist
 		{
+			Statistics::Increment(COUNTER_InvalidDrefs);
 			Log::FormatLine(LOG_ERROR, "DMAN", "ERROR: invalid DREF %s", dref.c_str());
-			return 0;
+			return resolved;
 		}
 
-		XPLMDataTypeID dataType = XPLMGetDataRefTypes(xdref);
-		Log::FormatLine(LOG_INFO, "DMAN", "Get DREF %s (x:%X) Type: %i", dref.c_str(), xdref, dataType);
 		// XPLMDataTypeID is a bit flag, so it may contain more than one of the
-		// following types. We prefer types as close to float as possible.
-		if ((dataType & 2) == 2) // Float
+		// following types. We prefer types as close to float as possible,
+		// unless the dataref will be read natively, in which case we prefer
+		// double. Float still comes before int so fractions aren't truncated.
+		XPLMDataTypeID dataType = XPLMGetDataRefTypes(xdref);
+		resolved.xdref = xdref;
+		resolved.count = 1;
+		if (native && (dataType & xplmType_Double) == xplmType_Double)
 		{
-			values[0] = XPLMGetDataf(xdref);
-			Log::FormatLine(LOG_INFO, "DMAN", " -- value was %f", values[0]);
+			resolved.type = xplmType_Double;
+		}
+		else if ((dataType & xplmType_Float) == xplmType_Float)
+		{
+			resolved.type = xplmType_Float;
+		}
+		else if ((dataType & xplmType_FloatArray) == xplmType_FloatArray)
+		{
+			resolved.type = xplmType_FloatArray;
+			resolved.count = XPLMGetDatavf(xdref, NULL, 0, 0);
+		}
+		else if ((dataType & xplmType_Double) == xplmType_Double)
+		{
+			resolved.type = xplmType_Double;
+		}
+		else if ((dataType & xplmType_Int) == xplmType_Int)
+		{
+			resolved.type = xplmType_Int;
+		}
+		else if ((dataType & xplmType_IntArray) == xplmType_IntArray)
+		{
+			resolved.type = xplmType_IntArray;
+			resolved.count = XPLMGetDatavi(xdref, NULL, 0, 0);
+		}
+		else if ((dataType & xplmType_Data) == xplmType_Data)
+		{
+			resolved.type = xplmType_Data;
+			resolved.count = XPLMGetDatab(xdref, NULL, 0, 0);
+		}
+		else
+		{
+			Log::FormatLine(LOG_ERROR, "DMAN", "ERROR: Unrecognized data type %i for DREF %s", dataType, dref.c_str());
+			resolved.count = 0;
+		}
+		return resolved;
+	}
+
+	// Reads a resolved dataref from X-Plane as floats, bypassing the snapshot.
+	static int ReadFloats(const ResolvedDref& dref, float values[], int size)
+	{
+		// Array elements are converted through a small buffer so that arrays
+		// of any length can be read without a heap allocation.
+		const int TMP_SIZE = 64;
+		int count = dref.count < size ? dref.count : size;
+		switch (dref.type)
+		{
+		case xplmType_Float:
+			values[0] = XPLMGetDataf(dref.xdref);
+			return 1;
+		case xplmType_Double:
+			values[0] = (float)XPLMGetDatad(dref.xdref);
 			return 1;
+		case xplmType_Int:
+			values[0] = (float)XPLMGetDatai(dref.xdref);
+			return 1;
+		case xplmType_FloatArray:
+			return XPLMGetDatavf(dref.xdref, values, 0, count);
+		case xplmType_IntArray:
+		{
+			int iValues[TMP_SIZE];
+			for (int offset = 0; offset < count; offset += TMP_SIZE)
+			{
+				int chunk = count - offset < TMP_SIZE ? count - offset : TMP_SIZE;
+				int read = XPLMGetDatavi(dref.xdref, iValues, offset, chunk);
+				for (int i = 0; i < read; ++i)
+				{
+					values[offset + i] = (float)iValues[i];
+				}
+				if (read < chunk)
+				{
+					return offset + read;
+				}
+			}
+			return count;
 		}
-		if ((dataType & 8) == 8) // Float array
+		case xplmType_Data:
 		{
-			int drefSize = XPLMGetDatavf(xdref, NULL, 0, 0);
-			if (drefSize > size)
+			char bValues[TMP_SIZE];
+			for (int offset = 0; offset < count; offset += TMP_SIZE)
 			{
-				Log::WriteLine(LOG_WARN, "DMAN", "Warning: dref size is larger than available space");
-				Log::FormatLine(LOG_DEBUG, "DMAN", "Actual dref size : %i, Available size : %i", drefSize, size);
-				drefSize = size;
+				int chunk = count - offset < TMP_SIZE ? count - offset : TMP_SIZE;
+				int read = XPLMGetDatab(dref.xdref, bValues, offset, chunk);
+				for (int i = 0; i < read; ++i)
+				{
+					values[offset + i] = (float)bValues[i];
+				}
+				if (read < chunk)
+				{
+					return offset + read;
+				}
 			}
-			XPLMGetDatavf(xdref, values, 0, drefSize);
-			Log::FormatLine(LOG_INFO, "DMAN", " -- value count was %i", drefSize);
-			return drefSize;
+			return count;
 		}
-		if ((dataType & 4) == 4) // Double
+		default:
+			return 0;
+		}
+	}
+
+	// Reads a resolved dataref from X-Plane in its native type, bypassing the
+	// snapshot.
+	static int ReadNativeDirect(const ResolvedDref& dref, unsigned char* out, int size)
+	{
+		// X-Plane needs aligned buffers for arrays, so copy through a small
+		// buffer rather than reading straight into out.
+		const int TMP_SIZE = 64;
+		int count = dref.count < size ? dref.count : size;
+		switch (dref.type)
 		{
-			values[0] = (float)XPLMGetDatad(xdref);
-			Log::FormatLine(LOG_INFO, "DMAN", " -- value was %f", values[0]);
+		case xplmType_Float:
+		{
+			float value = XPLMGetDataf(dref.xdref);
+			memcpy(out, &value, sizeof(value));
 			return 1;
 		}
-		if ((dataType & 1) == 1) // Integer
+		case xplmType_Double:
 		{
-			int iValue = XPLMGetDatai(xdref);
-			values[0] = (float)iValue;
-			Log::FormatLine(LOG_INFO, "DMAN", " -- Real value was %i, cast to %f", iValue, values[0]);
+			double value = XPLMGetDatad(dref.xdref);
+			memcpy(out, &value, sizeof(value));
 			return 1;
 		}
-		if ((dataType & 16) == 16) // Integer array
+		case xplmType_Int:
+		{
+			int value = XPLMGetDatai(dref.xdref);
+			memcpy(out, &value, sizeof(value));
+			return 1;
+		}
+		case xplmType_FloatArray:
+		{
+			float fValues[TMP_SIZE];
+			for (int offset = 0; offset < count; offset += TMP_SIZE)
+			{
+				int chunk = count - offset < TMP_SIZE ? count - offset : TMP_SIZE;
+				int read = XPLMGetDatavf(dref.xdref, fValues, offset, chunk);
+				memcpy(out + offset * sizeof(float), fValues, read * sizeof(float));
+				if (read < chunk)
+				{
+					return offset + read;
+				}
+			}
+			return count;
+		}
+		case xplmType_IntArray:
 		{
-			const std::size_t TMP_SIZE = 200;
 			int iValues[TMP_SIZE];
-			int drefSize = XPLMGetDatavi(xdref, NULL, 0, 0);
-			if (drefSize > size)
+			for (int offset = 0; offset < count; offset += TMP_SIZE)
 			{
-				Log::WriteLine(LOG_WARN, "DMAN", "Warning: dref size is larger than available space");
-				Log::FormatLine(LOG_DEBUG, "DMAN", "Actual dref size : %i, Available size : %i", drefSize, size);
-				drefSize = size;
+				int chunk = count - offset < TMP_SIZE ? count - offset : TMP_SIZE;
+				int read = XPLMGetDatavi(dref.xdref, iValues, offset, chunk);
+				memcpy(out + offset * sizeof(int), iValues, read * sizeof(int));
+				if (read < chunk)
+				{
+					return offset + read;
+				}
 			}
-			if (drefSize > TMP_SIZE)
+			return count;
+		}
+		case xplmType_Data:
+			return XPLMGetDatab(dref.xdref, out, 0, count);
+		default:
+			return 0;
+		}
+	}
+
+	// Values of resolved datarefs read during the current frame, so that every
+	// client asking for a dataref in the same frame gets the same value and
+	// X-Plane's accessor only runs once. Entries are stored in an open
+	// addressed table keyed on the X-Plane handle, with the values in native
+	// form in a byte arena. Bumping the generation empties the whole table at
+	// once without touching it.
+	struct SnapshotEntry
+	{
+		XPLMDataRef xdref;
+		unsigned int generation;
+		XPLMDataTypeID type;
+		int requested;
+		int read;
+		size_t offset;
+	};
+
+	static const size_t SNAPSHOT_ENTRIES = 1024; // Must be a power of two
+	static const size_t SNAPSHOT_MAX_USED = SNAPSHOT_ENTRIES / 4 * 3;
+	static const size_t SNAPSHOT_ARENA_SIZE = 256 * 1024;
+	static SnapshotEntry snapshot[SNAPSHOT_ENTRIES];
+	alignas(8) static unsigned char snapshotArena[SNAPSHOT_ARENA_SIZE];
+	static size_t snapshotArenaUsed;
+	static size_t snapshotCount;
+	// Starts at 1 so that zero-initialized entries are empty.
+	static unsigned int snapshotGeneration = 1;
+
+	// Gets the first count elements of dref as of this frame, reading them
+	// from X-Plane if this is the first time they have been asked for. read
+	// is set to the number of elements available. Returns NULL if the values
+	// can't be cached, in which case the caller should read them directly.
+	static const unsigned char* ReadSnapshot(const ResolvedDref& dref, int count, int& read)
+	{
+		int elementSize = DataManager::ElementSize(dref.type);
+		if (!dref.xdref || elementSize == 0)
+		{
+			return NULL;
+		}
+		if (count > dref.count)
+		{
+			count = dref.count;
+		}
+
+		size_t hash = (size_t)(((uintptr_t)dref.xdref >> 4) * 2654435761u);
+		size_t i = hash & (SNAPSHOT_ENTRIES - 1);
+		while (snapshot[i].generation == snapshotGeneration && snapshot[i].xdref != dref.xdref)
+		{
+			i = (i + 1) & (SNAPSHOT_ENTRIES - 1);
+		}
+		SnapshotEntry& entry = snapshot[i];
+		bool found = entry.generation == snapshotGeneration;
+		if (found && entry.type == dref.type && entry.requested >= count)
+		{
+			read = entry.read < count ? entry.read : count;
+			return snapshotArena + entry.offset;
+		}
+
+		// Not read yet this frame, or not enough of it. Read it into the arena
+		// unless the table or arena is full.
+		size_t bytes = ((size_t)count * elementSize + 7) & ~(size_t)7;
+		if ((!found && snapshotCount >= SNAPSHOT_MAX_USED) || snapshotArenaUsed + bytes > SNAPSHOT_ARENA_SIZE)
+		{
+			return NULL;
+		}
+		if (!found)
+		{
+			++snapshotCount;
+		}
+		entry.xdref = dref.xdref;
+		entry.generation = snapshotGeneration;
+		entry.type = dref.type;
+		entry.requested = count;
+		entry.offset = snapshotArenaUsed;
+		entry.read = count > 0 ? ReadNativeDirect(dref, snapshotArena + entry.offset, count) : 0;
+		snapshotArenaUsed += bytes;
+		read = entry.read;
+		return snapshotArena + entry.offset;
+	}
+
+	void DataManager::ClearSnapshot()
+	{
+		++snapshotGeneration;
+		if (snapshotGeneration == 0)
+		{
+			// Wrapped around. Old entries could look current again.
+			memset(snapshot, 0, sizeof(snapshot));
+			snapshotGeneration = 1;
+		}
+		snapshotCount = 0;
+		snapshotArenaUsed = 0;
+	}
+
+	int DataManager::Read(const ResolvedDref& dref, float values[], int size)
+	{
+		if (size <= 0)
+		{
+			return 0;
+		}
+
+		int read;
+		const unsigned char* cached = ReadSnapshot(dref, size, read);
+		if (!cached)
+		{
+			return ReadFloats(dref, values, size);
+		}
+		for (int i = 0; i < read; ++i)
+		{
+			switch (dref.type)
 			{
-				Log::WriteLine(LOG_WARN, "DMAN", "Warning: dref size is larger than temp buffer");
-				Log::FormatLine(LOG_DEBUG, "DMAN", "Actual dref size : %i, Temp buffer size: %u", drefSize, TMP_SIZE);
-				drefSize = TMP_SIZE;
+			case xplmType_Float:
+			case xplmType_FloatArray:
+				memcpy(&values[i], cached + i * sizeof(float), sizeof(float));
+				break;
+			case xplmType_Int:
+			case xplmType_IntArray:
+			{
+				int value;
+				memcpy(&value, cached + i * sizeof(int), sizeof(int));
+				values[i] = (float)value;
+				break;
 			}
-			XPLMGetDatavi(xdref, iValues, 0, drefSize);
-			for (int i = 0; i < drefSize; ++i)
+			case xplmType_Double:
 			{
-				values[i] = (float)iValues[i];
+				double value;
+				memcpy(&value, cached + i * sizeof(double), sizeof(double));
+				values[i] = (float)value;
+				break;
+			}
+			default:
+				values[i] = (float)(char)cached[i];
+				break;
 			}
-			Log::FormatLine(LOG_INFO, "DMAN", " -- value count was %i", drefSize);
-			return drefSize;
 		}
-		if ((dataType & 32) == 32) // Byte array
+		return read;
+	}
+
+	int DataManager::ReadNative(const ResolvedDref& dref, unsigned char* out, int size)
+	{
+		if (size <= 0)
 		{
-			const std::size_t TMP_SIZE = 1024;
-			char bValues[TMP_SIZE];
-			int drefSize = XPLMGetDatab(xdref, NULL, 0, 0);
-			if (drefSize > size)
-			{
-				Log::WriteLine(LOG_WARN, "DMAN", "Warning: dref size is larger than available space");
-				Log::FormatLine(LOG_DEBUG, "DMAN", "Actual dref size : %i, Available size : %i", drefSize, size);
-				drefSize = size;
-			}
-			if (drefSize > TMP_SIZE)
+			return 0;
+		}
+
+		int read;
+		const unsigned char* cached = ReadSnapshot(dref, size, read);
+		if (!cached)
+		{
+			return ReadNativeDirect(dref, out, size);
+		}
+		memcpy(out, cached, read * ElementSize(dref.type));
+		return read;
+	}
+
+	int DataManager::ElementSize(XPLMDataTypeID type)
+	{
+		switch (type)
+		{
+		case xplmType_Float:
+		case xplmType_FloatArray:
+			return sizeof(float);
+		case xplmType_Int:
+		case xplmType_IntArray:
+			return sizeof(int);
+		case xplmType_Double:
+			return sizeof(double);
+		case xplmType_Data:
+			return 1;
+		default:
+			return 0;
+		}
+	}
+
+	// Writes floats to a resolved dataref without clearing the snapshot.
+	static void WriteFloats(const ResolvedDref& dref, float values[], int size)
+	{
+		if (size <= 0 || !dref.xdref)
+		{
+			return;
+		}
+		if (std::isnan(values[0]))
+		{
+			Log::WriteLine(LOG_ERROR, "DMAN", "ERROR: Value must be a number (NaN received)");
+			return;
+		}
+
+		// Array elements are converted through a small buffer so that arrays
+		// of any length can be written without a heap allocation.
+		const int TMP_SIZE = 64;
+		int count = dref.count < size ? dref.count : size;
+		switch (dref.type)
+		{
+		case xplmType_Float:
+			XPLMSetDataf(dref.xdref, values[0]);
+			break;
+		case xplmType_Double:
+			XPLMSetDatad(dref.xdref, values[0]);
+			break;
+		case xplmType_Int:
+			XPLMSetDatai(dref.xdref, (int)values[0]);
+			break;
+		case xplmType_FloatArray:
+			XPLMSetDatavf(dref.xdref, values, 0, count);
+			break;
+		case xplmType_IntArray:
+		{
+			int iValues[TMP_SIZE];
+			for (int offset = 0; offset < count; offset += TMP_SIZE)
 			{
-				Log::WriteLine(LOG_WARN, "DMAN", "Warning: dref size is larger than temp buffer");
-				Log::FormatLine(LOG_DEBUG, "DMAN", "Actual dref size : %i, Temp buffer size: %u", drefSize, TMP_SIZE);
-				drefSize = TMP_SIZE;
+				int chunk = count - offset < TMP_SIZE ? count - offset : TMP_SIZE;
+				for (int i = 0; i < chunk; ++i)
+				{
+					iValues[i] = (int)values[offset + i];
+				}
+				XPLMSetDatavi(dref.xdref, iValues, offset, chunk);
 			}
-			XPLMGetDatab(xdref, bValues, 0, drefSize);
-			for (int i = 0; i < drefSize; ++i)
+			break;
+		}
+		case xplmType_Data:
+		{
+			char bValues[TMP_SIZE];
+			for (int offset = 0; offset < count; offset += TMP_SIZE)
 			{
-				values[i] = (float)bValues[i];
+				int chunk = count - offset < TMP_SIZE ? count - offset : TMP_SIZE;
+				for (int i = 0; i < chunk; ++i)
+				{
+					bValues[i] = (char)values[offset + i];
+				}
+				XPLMSetDatab(dref.xdref, bValues, offset, chunk);
 			}
-			Log::FormatLine(LOG_INFO, "DMAN", " -- value count was %i", drefSize);
-			return drefSize;
+			break;
+		}
+		default:
+			break;
 		}
+	}
 
-		// No match
-		Log::WriteLine(LOG_ERROR, "DMAN", "ERROR: Unrecognized data type.");
-		return 0;
+	void DataManager::Write(const ResolvedDref& dref, float values[], int size)
+	{
+		ClearSnapshot();
+		WriteFloats(dref, values, size);
+	}
+
+	void DataManager::WriteEach(const ResolvedDref drefs[], float values[], int count)
+	{
+		ClearSnapshot();
+		for (int i = 0; i < count; ++i)
+		{
+			WriteFloats(drefs[i], values + i, 1);
+		}
 	}
 
 	double DataManager::GetDouble(DREF dref, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		double value = XPLMGetDatad(xdref);
 		Log::FormatLine(LOG_INFO, "DMAN", "Get DREF %i (x:%X) result %f for a/c %i",
 			dref, xdref, value, aircraft);
@@ -422,7 +817,7 @@ namespace XPC
 
 	float DataManager::GetFloat(DREF dref, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		float value = XPLMGetDataf(xdref);
 		Log::FormatLine(LOG_INFO, "DMAN", "Get DREF %i (x:%X) result %f for a/c %i",
 			dref, xdref, value, aircraft);
@@ -431,7 +826,7 @@ namespace XPC
 
 	int DataManager::GetInt(DREF dref, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		int value = XPLMGetDatai(xdref);
 		Log::FormatLine(LOG_INFO, "DMAN", "Get DREF %i (x:%X) result %i for a/c %i",
 			dref, xdref, value, aircraft);
@@ -440,7 +835,7 @@ namespace XPC
 
 	int DataManager::GetFloatArray(DREF dref, float values[], int size, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		int resultSize = XPLMGetDatavf(xdref, values, 0, size);
 		Log::FormatLine(LOG_INFO, "DMAN", "Get DREF %i (x:%X) result size %i for a/c %i",
 			dref, xdref, resultSize, aircraft);
@@ -449,7 +844,7 @@ namespace XPC
 
 	int DataManager::GetIntArray(DREF dref, int values[], int size, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		int resultSize = XPLMGetDatavi(xdref, values, 0, size);
 		Log::FormatLine(LOG_INFO, "DMAN", "Get DREF %i (x:%X) result size %i for a/c %i",
 			dref, xdref, resultSize, aircraft);
@@ -458,7 +853,8 @@ namespace XPC
 
 	void DataManager::Set(DREF dref, double value, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		ClearSnapshot();
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting DREF %i (x:%X) to %f for a/c %i",
 			dref, xdref, value, aircraft);
 		XPLMSetDatad(xdref, value);
@@ -466,7 +862,8 @@ namespace XPC
 
 	void DataManager::Set(DREF dref, float value, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		ClearSnapshot();
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting DREF %i (x:%X) to %f for a/c %i",
 			dref, xdref, value, aircraft);
 		XPLMSetDataf(xdref, value);
@@ -474,7 +871,8 @@ namespace XPC
 
 	void DataManager::Set(DREF dref, int value, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		ClearSnapshot();
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting DREF %i (x:%X) to %i for a/c %i",
 			dref, xdref, value, aircraft);
 		XPLMSetDatai(xdref, value);
@@ -482,7 +880,8 @@ namespace XPC
 
 	void DataManager::Set(DREF dref, float values[], int size, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		ClearSnapshot();
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting DREF %i (x:%X) (%i values) for a/c %i",
 			dref, xdref, size, aircraft);
 		int drefSize = XPLMGetDatavf(xdref, NULL, 0, 0);
@@ -497,7 +896,8 @@ namespace XPC
 
 	void DataManager::Set(DREF dref, int values[], int size, char aircraft)
 	{
-		const XPLMDataRef& xdref = aircraft == 0 ? drefs[dref] : mdrefs[aircraft][dref];
+		ClearSnapshot();
+		XPLMDataRef xdref = GetSlot(dref, aircraft).xdref;
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting DREF %i (x:%X) (%i values) for a/c %i",
 			dref, xdref, size, aircraft);
 		int drefSize = XPLMGetDatavi(xdref, NULL, 0, 0);
@@ -512,6 +912,7 @@ namespace XPC
 
 	void DataManager::Set(const string& dref, float values[], int size)
 	{
+		ClearSnapshot();
 		XPLMDataRef& xdref = sdrefs[dref];
 		if (xdref == NULL)
 		{
@@ -520,6 +921,7 @@ namespace XPC
 		if (!xdref)
 		{
 			// DREF does not exist
+			Statistics::Increment(COUNTER_InvalidDrefs);
 			Log::FormatLine(LOG_ERROR, "DMAN", "ERROR: invalid DREF %s", dref.c_str());
 			return;
 		}
@@ -625,6 +1027,7 @@ namespace XPC
 
 	void DataManager::SetGear(float gear, bool immediate, char aircraft)
 	{
+		ClearSnapshot();
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting gear (value:%f, immediate:%i) for aircraft %i",
 			gear, immediate, aircraft);
 
@@ -661,6 +1064,7 @@ namespace XPC
 
 	void DataManager::SetPosition(double pos[3], char aircraft)
 	{
+		ClearSnapshot();
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting position (%f, %f, %f) for aircraft %i",
 			pos[0], pos[1], pos[2], aircraft);
 		if (std::isnan(pos[0] + pos[1] + pos[2]))
@@ -716,6 +1120,7 @@ namespace XPC
 
 	void DataManager::SetOrientation(float orient[3], char aircraft)
 	{
+		ClearSnapshot();
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting orientation (%f, %f, %f) for aircraft %i",
 			orient[0], orient[1], orient[2], aircraft);
 		if (std::isnan(orient[0] + orient[1] + orient[2]))
@@ -771,8 +1176,53 @@ namespace XPC
 		}
 	}
 
+	void DataManager::SetControls(char aircraft, float pitch, float roll, float yaw,
+		float throttle, char gear, float flaps, float spdbrk)
+	{
+		ClearSnapshot();
+		if (!IsDefault(pitch))
+		{
+			Set(DREF_YokePitch, pitch, aircraft);
+		}
+		if (!IsDefault(roll))
+		{
+			Set(DREF_YokeRoll, roll, aircraft);
+		}
+		if (!IsDefault(yaw))
+		{
+			Set(DREF_YokeHeading, yaw, aircraft);
+		}
+		if (!IsDefault(throttle))
+		{
+			float throttleArray[8];
+			for (int i = 0; i < 8; ++i)
+			{
+				throttleArray[i] = throttle;
+			}
+			Set(DREF_ThrottleSet, throttleArray, 8, aircraft);
+			Set(DREF_ThrottleActual, throttleArray, 8, aircraft);
+			if (aircraft == 0)
+			{
+				Set("sim/flightmodel/engine/ENGN_thro_override", throttleArray, 1);
+			}
+		}
+		if (gear != -1)
+		{
+			SetGear(gear, false, aircraft);
+		}
+		if (!IsDefault(flaps))
+		{
+			Set(DREF_FlapSetting, flaps, aircraft);
+		}
+		if (!IsDefault(spdbrk))
+		{
+			Set(DREF_SpeedBrakeSet, spdbrk, aircraft);
+		}
+	}
+
 	void DataManager::SetFlaps(float value)
 	{
+		ClearSnapshot();
 		Log::FormatLine(LOG_INFO, "DMAN", "Setting flaps (value:%f)", value);
 
 		if (std::isnan(value))
@@ -794,6 +1244,7 @@ namespace XPC
 
 	void DataManager::Execute(const std::string& comm)
 	{
+		ClearSnapshot();
 		Log::FormatLine(LOG_INFO, "DMAN", "Executing command (value:%s)", comm.c_str());
 
  		XPLMCommandRef xcref = XPLMFindCommand(comm.c_str());
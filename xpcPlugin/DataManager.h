@@ -3,11 +3,34 @@
 #ifndef XPCPLUGIN_DATAMANAGER_H_
 #define XPCPLUGIN_DATAMANAGER_H_
 
+#include "XPLMDataAccess.h"
+
 #include <string>
 
 namespace XPC
 {
+	/// A named dataref that has been looked up along with everything needed to
+	/// read it again without repeating the lookup.
+	struct ResolvedDref
+	{
+		/// The X-Plane handle for the dataref, or NULL if the dataref does
+		/// not exist.
+		XPLMDataRef xdref;
+
+		/// The single type that the dataref is read as. When X-Plane reports
+		/// more than one type, the type closest to float is chosen, unless
+		/// the dataref was resolved for native reads, in which case double is
+		/// preferred.
+		XPLMDataTypeID type;
+
+		/// The number of elements in the dataref. 1 for scalar datarefs.
+		int count;
+	};
+
 	/// Represents named datarefs used by X-Plane Connect
+	///
+	/// \remarks Values are contiguous so that they can index the table of
+	///          resolved datarefs in DataManager directly.
 	enum DREF
 	{
 		DREF_None = 0,
@@ -16,54 +39,54 @@ namespace XPC
 		DREF_PauseAI,
 
 		// Times
-		DREF_TotalRuntime = 100,
+		DREF_TotalRuntime,
 		DREF_TotalFlighttime,
 		DREF_TimerElapsedtime,
 
 		// Velocities
-		DREF_IndicatedAirspeed = 300,
+		DREF_IndicatedAirspeed,
 		DREF_TrueAirspeed,
 		DREF_GroundSpeed,
 
 		// Mach, VVI, G-loads
-		DREF_MachNumber = 400,
+		DREF_MachNumber,
 		DREF_GForceNormal,
 		DREF_GForceAxial,
 		DREF_GForceSide,
 
 		// Atmosphere: Weather
-		DREF_BarometerSealevelInHg = 500,
+		DREF_BarometerSealevelInHg,
 		DREF_TemperaturSealevelC,
 		DREF_WindSpeedKts,
 
 		// Joystick
-		DREF_YokePitch = 800,
+		DREF_YokePitch,
 		DREF_YokeRoll,
 		DREF_YokeHeading,
 
 		// Control Surfaces
-		DREF_Elevator = 1100,
+		DREF_Elevator,
 		DREF_Aileron,
 		DREF_Rudder,
 
 		// Flaps
-		DREF_FlapSetting = 1300,
+		DREF_FlapSetting,
 		DREF_FlapActual,
 
 		// Gear & Brakes
-		DREF_GearDeploy = 1400,
+		DREF_GearDeploy,
 		DREF_GearHandle,
 		DREF_BrakeParking,
 		DREF_BrakeLeft,
 		DREF_BrakeRight,
 
 		// MNR (Angular Moments)
-		DREF_M = 1500,
+		DREF_M,
 		DREF_L,
 		DREF_N,
 
 		// PQR (Angular Velocities)
-		DREF_QRad = 1600,
+		DREF_QRad,
 		DREF_PRad,
 		DREF_RRad,
 		DREF_Q,
@@ -71,36 +94,36 @@ namespace XPC
 		DREF_R,
 
 		// Orientation: pitch, roll, yaw, heading
-		DREF_Pitch = 1700,
+		DREF_Pitch,
 		DREF_Roll,
 		DREF_HeadingTrue,
 		DREF_HeadingMag,
 		DREF_Quaternion,
 
 		// Orientation: alpha beta hpath vpath slip
-		DREF_AngleOfAttack = 1800,
+		DREF_AngleOfAttack,
 		DREF_Sideslip,
 		DREF_HPath,
 		DREF_VPath,
 
-		DREF_MagneticVariation = 1901,
+		DREF_MagneticVariation,
 
 		// Global Position
-		DREF_Latitude = 2000,
+		DREF_Latitude,
 		DREF_Longitude,
 		DREF_Elevation,
 		DREF_AGL,
 
 		// Local Postion & Velocity
-		DREF_LocalX = 2100,
+		DREF_LocalX,
 		DREF_LocalY,
 		DREF_LocalZ,
 		DREF_LocalVX,
 		DREF_LocalVY,
 		DREF_LocalVZ,
 
-		DREF_ThrottleSet = 2200,
-		DREF_ThrottleActual = 2300,
+		DREF_ThrottleSet,
+		DREF_ThrottleActual,
 
 		// Multiplayer Aircraft
 		DREF_FlapActual2,
@@ -133,7 +156,10 @@ namespace XPC
 		DREF_MP4Alt,
 		DREF_MP5Alt,
 		DREF_MP6Alt,
-		DREF_MP7Alt
+		DREF_MP7Alt,
+
+		/// The number of DREF values. Not a valid dataref.
+		DREF_Count
 	};
 
 	/// Maps X-Plane dataref lines to XPC DREF values.
@@ -153,6 +179,24 @@ namespace XPC
 		/// into X-Plane internal data.
 		static void Initialize();
 
+		/// Forgets the resolved X-Plane handles for the named datarefs of the
+		/// specified aircraft. They are looked up again the next time they are
+		/// used.
+		///
+		/// \param aircraft The aircraft whose datarefs should be invalidated.
+		///                 0 is the player aircraft.
+		static void Invalidate(int aircraft);
+
+		/// Discards the values of resolved datarefs read so far.
+		///
+		/// \details Read and ReadNative keep the value of each dataref they
+		///          read until this is called, so every client asking for a
+		///          dataref between calls sees the same value and X-Plane is
+		///          only asked once. It should be called at the start of every
+		///          frame. Methods that write datarefs call it themselves, so
+		///          reads after a write always see the new value.
+		static void ClearSnapshot();
+
 		/// Gets a dataref based on its name.
 		///
 		/// \param dref   The name of the dref to get.
@@ -176,6 +220,70 @@ namespace XPC
 		///          strongly typed methods instead.
 		static int Get(const std::string& dref, float values[], int size);
 
+		/// Looks up a dataref by name and determines how to read it.
+		///
+		/// \param dref   The name of the dref to look up.
+		/// \param native true if the dref will be read with ReadNative. Drefs
+		///               with more than one type then resolve to double if
+		///               they have it, otherwise to float, then int.
+		/// \returns      The resolved dataref. If the dataref does not exist, the
+		///               xdref member is NULL and the count is 0.
+		static ResolvedDref Resolve(const std::string& dref, bool native = false);
+
+		/// Reads the value of a previously resolved dataref.
+		///
+		/// \param dref   The dataref to read.
+		/// \param values An array in which the result of the operation will be stored.
+		/// \param size   The size of the values array.
+		/// \returns      The number of elements placed in the values array.
+		///
+		/// \remarks Unlike Get, this method does not look anything up or write
+		///          to the log, so it is suitable for reading many datarefs every
+		///          frame. Values come from the snapshot described in
+		///          ClearSnapshot when possible.
+		static int Read(const ResolvedDref& dref, float values[], int size);
+
+		/// Reads the value of a previously resolved dataref in its native type.
+		///
+		/// \param dref   The dataref to read.
+		/// \param out    The location in which the values will be stored. Each
+		///               element takes ElementSize(dref.type) bytes. out does
+		///               not need to be aligned.
+		/// \param size   The maximum number of elements to store in out.
+		/// \returns      The number of elements stored in out.
+		///
+		/// \remarks Shares the snapshot used by Read.
+		static int ReadNative(const ResolvedDref& dref, unsigned char* out, int size);
+
+		/// Gets the size in bytes of one element of a dataref read by
+		/// ReadNative.
+		///
+		/// \param type The type of the dataref.
+		/// \returns    4 for int and float types, 8 for doubles, 1 for byte
+		///             arrays, and 0 for unknown types.
+		static int ElementSize(XPLMDataTypeID type);
+
+		/// Sets the value of a previously resolved dataref.
+		///
+		/// \param dref   The dataref to set.
+		/// \param values An array containing the values to set.
+		/// \param size   The number of elements in values.
+		///
+		/// \remarks Unlike Set, this method does not look anything up or write
+		///          to the log unless the value is invalid.
+		static void Write(const ResolvedDref& dref, float values[], int size);
+
+		/// Sets the first value of each of several previously resolved
+		/// datarefs.
+		///
+		/// \param drefs  The datarefs to set.
+		/// \param values The value to set for each dataref.
+		/// \param count  The number of datarefs.
+		///
+		/// \remarks Like Write, but clears the snapshot only once for the
+		///          whole batch.
+		static void WriteEach(const ResolvedDref drefs[], float values[], int count);
+
 		/// Gets the value of a double dataref.
 		///
 		/// \param dref     The dataref to get.
@@ -405,6 +513,21 @@ namespace XPC
 		/// \param aircraft The aircraft to set the orientation of.
 		static void SetOrientation(float orient[3], char aircraft = 0);
 
+		/// Sets the flight controls of the specified aircraft.
+		///
+		/// \param aircraft The aircraft to set the controls of.
+		/// \param pitch    The elevator/yoke pitch, between -1 and 1.
+		/// \param roll     The aileron/yoke roll, between -1 and 1.
+		/// \param yaw      The rudder/yoke heading, between -1 and 1.
+		/// \param throttle The throttle of every engine, between 0 and 1.
+		/// \param gear     The gear handle, 0 or 1, or -1 to leave it unchanged.
+		/// \param flaps    The flaps setting, between 0 and 1.
+		/// \param spdbrk   The speed brake setting.
+		///
+		/// \remarks Float values equal to GetDefaultValue() are left unchanged.
+		static void SetControls(char aircraft, float pitch, float roll, float yaw,
+			float throttle, char gear, float flaps, float spdbrk);
+
 		/// Sets flaps on the the player aircraft.
 		///
 		/// \param value The flaps settings. Should be between 0.0 (no flaps) and 1.0 (full flaps).
@@ -0,0 +1,171 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "History.h"
+#include "DataManager.h"
+#include "Log.h"
+
+#include <vector>
+
+namespace XPC
+{
+	static const char* const tag = "HIST";
+
+	struct HistoryDref
+	{
+		ResolvedDref dref;
+		int offset;
+	};
+
+	static std::vector<HistoryDref> drefs;
+	static int width;
+	static std::vector<double> times;
+	static std::vector<float> values;
+	// The number of rows sampled since Configure. The newest row is next - 1.
+	static std::uint64_t next;
+
+	bool History::Configure(double seconds, const std::string names[], int count)
+	{
+		Clear();
+		if (count == 0)
+		{
+			Log::WriteLine(LOG_INFO, tag, "Stopped keeping history");
+			return true;
+		}
+		if (!(seconds > 0))
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid history length %f", seconds);
+			return false;
+		}
+
+		drefs.resize(count);
+		width = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			drefs[i].dref = DataManager::Resolve(names[i]);
+			drefs[i].offset = width;
+			width += drefs[i].dref.xdref ? drefs[i].dref.count : 0;
+		}
+		if (width == 0)
+		{
+			Log::WriteLine(LOG_ERROR, tag, "ERROR: None of the datarefs exist");
+			Clear();
+			return false;
+		}
+
+		double rows = seconds * MaxRate + 1;
+		if (rows * (width + 2) > MaxValues)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: %f seconds of %i values is too much history", seconds, width);
+			Clear();
+			return false;
+		}
+		times.assign((std::size_t)rows, 0.0);
+		values.assign((std::size_t)rows * width, 0.0F);
+		Log::FormatLine(LOG_INFO, tag, "Keeping %f seconds of %i values", seconds, width);
+		return true;
+	}
+
+	void History::Sample()
+	{
+		if (times.empty())
+		{
+			return;
+		}
+
+		// Rows are stamped with sim time, which stops while the sim is paused
+		// and jumps back when a new flight is loaded. Times must increase so
+		// the ring can be searched, so skip frames where time stands still and
+		// start over when it goes backwards.
+		double time = DataManager::GetFloat(DREF_TotalFlighttime);
+		if (next > 0)
+		{
+			double newest = times[(next - 1) % times.size()];
+			if (time == newest)
+			{
+				return;
+			}
+			if (time < newest)
+			{
+				Log::WriteLine(LOG_INFO, tag, "Sim time went backwards, discarding history");
+				next = 0;
+			}
+		}
+
+		std::size_t slot = next % times.size();
+		times[slot] = time;
+		float* row = &values[slot * width];
+		for (std::size_t i = 0; i < drefs.size(); ++i)
+		{
+			const HistoryDref& d = drefs[i];
+			int read = DataManager::Read(d.dref, row + d.offset, d.dref.count);
+			for (int j = read; j < (d.dref.xdref ? d.dref.count : 0); ++j)
+			{
+				row[d.offset + j] = 0;
+			}
+		}
+		++next;
+	}
+
+	void History::Clear()
+	{
+		drefs.clear();
+		width = 0;
+		std::vector<double>().swap(times);
+		std::vector<float>().swap(values);
+		next = 0;
+	}
+
+	int History::GetWidth()
+	{
+		return width;
+	}
+
+	double History::GetNewestTime()
+	{
+		return next > 0 ? times[(next - 1) % times.size()] : 0;
+	}
+
+	std::size_t History::Find(double from, double to, std::uint64_t& first)
+	{
+		std::uint64_t oldest = next > times.size() ? next - times.size() : 0;
+
+		// Binary search for the first row at or after from, then for the
+		// first row after to.
+		std::uint64_t lo = oldest;
+		std::uint64_t hi = next;
+		while (lo < hi)
+		{
+			std::uint64_t mid = lo + (hi - lo) / 2;
+			if (times[mid % times.size()] < from)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		first = lo;
+		hi = next;
+		while (lo < hi)
+		{
+			std::uint64_t mid = lo + (hi - lo) / 2;
+			if (times[mid % times.size()] <= to)
+			{
+				lo = mid + 1;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		return (std::size_t)(lo - first);
+	}
+
+	double History::GetRow(std::uint64_t row, const float** rowValues)
+	{
+		std::size_t slot = row % times.size();
+		*rowValues = &values[slot * width];
+		return times[slot];
+	}
+}
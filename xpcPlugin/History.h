@@ -0,0 +1,73 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_HISTORY_H_
+#define XPCPLUGIN_HISTORY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace XPC
+{
+	/// Keeps the values of selected datarefs for the last few seconds so that
+	/// clients can fetch them with HIST requests after something interesting
+	/// happens, rather than polling at a high rate all the time.
+	///
+	/// \details Every frame, the values of the datarefs are read as floats and
+	///          stored with the sim's flight time in a ring. Nothing is stored
+	///          while the sim is paused, and the history starts over if the
+	///          flight time goes backwards. The ring has room for the
+	///          configured number of seconds at MaxRate frames per second; at
+	///          lower frame rates it holds more. Rows are numbered from the
+	///          first row sampled since Configure, so row numbers stay valid
+	///          while the ring wraps. All methods must be called from the
+	///          flight loop thread.
+	class History
+	{
+	public:
+		/// Starts keeping history for the specified datarefs, discarding any
+		/// history kept so far.
+		///
+		/// \param seconds How many seconds of history to keep.
+		/// \param drefs   The datarefs to keep history for.
+		/// \param count   The number of datarefs. 0 stops keeping history.
+		/// \returns       true if successful.
+		static bool Configure(double seconds, const std::string drefs[], int count);
+
+		/// Adds the current values of the datarefs to the history. Should be
+		/// called once per frame.
+		static void Sample();
+
+		/// Stops keeping history and frees the ring.
+		static void Clear();
+
+		/// Gets the number of values in each row.
+		static int GetWidth();
+
+		/// Gets the time of the newest row, or 0 if there are no rows.
+		static double GetNewestTime();
+
+		/// Finds the rows with times in a range.
+		///
+		/// \param from  The earliest time to include.
+		/// \param to    The latest time to include.
+		/// \param first The location in which the number of the first row in
+		///              the range will be stored.
+		/// \returns     The number of rows in the range.
+		static std::size_t Find(double from, double to, std::uint64_t& first);
+
+		/// Gets a row of history found by Find.
+		///
+		/// \param row The number of the row.
+		/// \returns   The time of the row. The values of the row follow in
+		///            values.
+		static double GetRow(std::uint64_t row, const float** values);
+
+		/// The frame rate the ring is sized for.
+		static const int MaxRate = 120;
+
+		/// The most values the ring may hold.
+		static const std::size_t MaxValues = 16 * 1024 * 1024;
+	};
+}
+#endif
@@ -0,0 +1,246 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "Interpolator.h"
+#include "DataManager.h"
+#include "Log.h"
+
+#include <cmath>
+
+namespace XPC
+{
+	using namespace std::chrono;
+
+	static const char* const tag = "INTP";
+
+	// The number of states kept for each aircraft.
+	static const int STATE_COUNT = 4;
+
+	// The longest time an aircraft keeps moving past its newest state.
+	static const double MAX_EXTRAPOLATION_S = 0.5;
+
+	// Aircraft that haven't received a state for this long stop being
+	// smoothed.
+	static const double TIMEOUT_S = 5.0;
+
+	// How quickly the clock offset follows arrivals that are later than the
+	// earliest seen, e.g. because the client's clock drifts.
+	static const double OFFSET_GAIN = 0.01;
+
+	// Values kept for each state: latitude, longitude, altitude, pitch, roll
+	// and heading. Longitude, roll and heading are unwrapped so they change
+	// continuously from one state to the next.
+	static const int VALUE_COUNT = 6;
+
+	struct State
+	{
+		double time;
+		double values[VALUE_COUNT];
+	};
+
+	struct Track
+	{
+		bool active;
+		int count;
+		// Oldest first
+		State states[STATE_COUNT];
+		// Plugin time minus client time, in seconds.
+		double offset;
+		double delay;
+		double lastReceived;
+	};
+
+	static Track tracks[Interpolator::AircraftCount];
+
+	static double ToSeconds(steady_clock::time_point t)
+	{
+		return duration_cast<duration<double>>(t.time_since_epoch()).count();
+	}
+
+	// Wraps an angle in degrees to [-180, 180).
+	static double Wrap180(double angle)
+	{
+		return angle - 360.0 * std::floor((angle + 180.0) / 360.0);
+	}
+
+	bool Interpolator::AddState(unsigned char aircraft, double time, const double pos[3], const float orient[3],
+		double delay, steady_clock::time_point received)
+	{
+		if (aircraft >= AircraftCount)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid aircraft number %u", aircraft);
+			return false;
+		}
+		if (std::isnan(time + pos[0] + pos[1] + pos[2] + orient[0] + orient[1] + orient[2]))
+		{
+			Log::WriteLine(LOG_ERROR, tag, "ERROR: State must be a number (NaN received)");
+			return false;
+		}
+
+		Track& track = tracks[aircraft];
+		bool started = !track.active;
+		if (track.active && time <= track.states[track.count - 1].time)
+		{
+			if (time > track.states[track.count - 1].time - 1.0)
+			{
+				// Duplicated or reordered in transit. The newer state already
+				// covers it.
+				Log::FormatLine(LOG_DEBUG, tag, "Dropped late state for a/c %u", aircraft);
+				return false;
+			}
+			// The client's clock jumped backwards, probably because it
+			// restarted. Start again from this state.
+			Log::FormatLine(LOG_INFO, tag, "Clock reset for a/c %u", aircraft);
+			started = true;
+		}
+
+		double now = ToSeconds(received);
+		if (started)
+		{
+			track.active = true;
+			track.count = 0;
+			track.offset = now - time;
+		}
+		else
+		{
+			double offset = now - time;
+			track.offset = offset < track.offset ? offset : track.offset + (offset - track.offset) * OFFSET_GAIN;
+		}
+		track.delay = delay < 0 ? 0 : delay;
+		track.lastReceived = now;
+
+		if (track.count == STATE_COUNT)
+		{
+			for (int i = 1; i < STATE_COUNT; ++i)
+			{
+				track.states[i - 1] = track.states[i];
+			}
+			--track.count;
+		}
+		State& state = track.states[track.count];
+		state.time = time;
+		state.values[0] = pos[0];
+		state.values[1] = pos[1];
+		state.values[2] = pos[2];
+		state.values[3] = orient[0];
+		state.values[4] = orient[1];
+		state.values[5] = orient[2];
+		if (track.count > 0)
+		{
+			const State& prev = track.states[track.count - 1];
+			const int wrapped[] = { 1, 4, 5 };
+			for (int i = 0; i < 3; ++i)
+			{
+				int k = wrapped[i];
+				state.values[k] = prev.values[k] + Wrap180(state.values[k] - prev.values[k]);
+			}
+		}
+		++track.count;
+		return started;
+	}
+
+	void Interpolator::Stop(unsigned char aircraft)
+	{
+		if (aircraft < AircraftCount && tracks[aircraft].active)
+		{
+			Log::FormatLine(LOG_DEBUG, tag, "Stopped smoothing a/c %u", aircraft);
+			tracks[aircraft].active = false;
+		}
+	}
+
+	void Interpolator::Clear()
+	{
+		for (int i = 0; i < AircraftCount; ++i)
+		{
+			tracks[i].active = false;
+		}
+	}
+
+	// Evaluates a track at a time on the client's clock.
+	static void Evaluate(const Track& track, double t, double out[VALUE_COUNT])
+	{
+		const State* s = track.states;
+		int n = track.count;
+		if (n == 1 || t <= s[0].time)
+		{
+			for (int k = 0; k < VALUE_COUNT; ++k)
+			{
+				out[k] = s[0].values[k];
+			}
+			return;
+		}
+
+		const State& last = s[n - 1];
+		if (t >= last.time)
+		{
+			// Dead reckoning from the velocity between the newest two states.
+			const State& prev = s[n - 2];
+			double dt = t - last.time;
+			if (dt > MAX_EXTRAPOLATION_S)
+			{
+				dt = MAX_EXTRAPOLATION_S;
+			}
+			double span = last.time - prev.time;
+			for (int k = 0; k < VALUE_COUNT; ++k)
+			{
+				out[k] = last.values[k] + (last.values[k] - prev.values[k]) / span * dt;
+			}
+			return;
+		}
+
+		int i = 0;
+		while (s[i + 1].time <= t)
+		{
+			++i;
+		}
+		const State& p0 = s[i];
+		const State& p1 = s[i + 1];
+		double h = p1.time - p0.time;
+		double u = (t - p0.time) / h;
+		double u2 = u * u;
+		double u3 = u2 * u;
+		double h00 = 2 * u3 - 3 * u2 + 1;
+		double h10 = u3 - 2 * u2 + u;
+		double h01 = -2 * u3 + 3 * u2;
+		double h11 = u3 - u2;
+		for (int k = 0; k < VALUE_COUNT; ++k)
+		{
+			// Tangents from the neighbouring states where there are any, so
+			// the curve is smooth through each state.
+			double chord = (p1.values[k] - p0.values[k]) / h;
+			double m0 = i > 0 ? (p1.values[k] - s[i - 1].values[k]) / (p1.time - s[i - 1].time) : chord;
+			double m1 = i + 2 < n ? (s[i + 2].values[k] - p0.values[k]) / (s[i + 2].time - p0.time) : chord;
+			out[k] = h00 * p0.values[k] + h10 * h * m0 + h01 * p1.values[k] + h11 * h * m1;
+		}
+	}
+
+	void Interpolator::Update(steady_clock::time_point now)
+	{
+		double nowS = ToSeconds(now);
+		for (int ac = 0; ac < AircraftCount; ++ac)
+		{
+			Track& track = tracks[ac];
+			if (!track.active)
+			{
+				continue;
+			}
+			if (nowS - track.lastReceived > TIMEOUT_S)
+			{
+				Log::FormatLine(LOG_INFO, tag, "No state received for a/c %i, holding position", ac);
+				track.active = false;
+				continue;
+			}
+
+			double values[VALUE_COUNT];
+			Evaluate(track, nowS - track.offset - track.delay, values);
+			double pos[3] = { values[0], Wrap180(values[1]), values[2] };
+			float orient[3] =
+			{
+				(float)values[3],
+				(float)Wrap180(values[4]),
+				(float)(values[5] - 360.0 * std::floor(values[5] / 360.0))
+			};
+			DataManager::SetPosition(pos, (char)ac);
+			DataManager::SetOrientation(orient, (char)ac);
+		}
+	}
+}
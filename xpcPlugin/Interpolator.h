@@ -0,0 +1,62 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_INTERPOLATOR_H_
+#define XPCPLUGIN_INTERPOLATOR_H_
+
+#include <chrono>
+
+namespace XPC
+{
+	/// Smooths the motion of aircraft whose position is sent as timestamped
+	/// states by TPOS messages.
+	///
+	/// \details The last few states of each aircraft are kept, and every frame
+	///          the aircraft is moved to where it should be at that moment.
+	///          Between states, position and orientation follow a cubic Hermite
+	///          curve through the neighbouring states. Past the newest state,
+	///          the aircraft keeps moving at its last velocity for a short time
+	///          and then holds still until the next state arrives. Clients
+	///          timestamp states with their own clock. The offset to the
+	///          plugin's clock is estimated from the earliest arrival seen.
+	///
+	///          Clients choose a delay for each aircraft. A delay of about one
+	///          and a half update intervals means there is almost always a
+	///          newer state to interpolate towards. A delay of 0 extrapolates
+	///          from the newest state, trading accuracy for latency. All
+	///          methods must be called from the flight loop thread.
+	class Interpolator
+	{
+	public:
+		/// Adds a state for an aircraft and starts smoothing it if it isn't
+		/// already.
+		///
+		/// \param aircraft The aircraft number. 0 is the player aircraft.
+		/// \param time     The time of the state in seconds, on the client's
+		///                 clock.
+		/// \param pos      The latitude, longitude and altitude of the aircraft.
+		/// \param orient   The pitch, roll and heading of the aircraft.
+		/// \param delay    How far behind the newest state to place the
+		///                 aircraft, in seconds.
+		/// \param received When the state was received by the plugin.
+		/// \returns        true if smoothing started for the aircraft.
+		static bool AddState(unsigned char aircraft, double time, const double pos[3], const float orient[3],
+			double delay, std::chrono::steady_clock::time_point received);
+
+		/// Stops smoothing an aircraft, leaving it where it is. Called when
+		/// the aircraft is moved by a POSI or BPOS message.
+		///
+		/// \param aircraft The aircraft number. 0 is the player aircraft.
+		static void Stop(unsigned char aircraft);
+
+		/// Stops smoothing every aircraft.
+		static void Clear();
+
+		/// Moves every aircraft being smoothed to its position at the
+		/// specified time. Should be called once per frame.
+		static void Update(std::chrono::steady_clock::time_point now);
+
+		/// The number of aircraft that can be smoothed.
+		static const int AircraftCount = 20;
+	};
+}
+#endif
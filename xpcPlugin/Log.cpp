@@ -4,55 +4,57 @@
 
 #include "XPLMUtilities.h"
 
+#include <chrono>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <thread>
 
-#ifndef LIN
-#include <chrono>
-#endif
-#include <iomanip>
-#include <sstream>
-
-// Implementation note: I initially wrote this class using C++ iostreams, but I couldn't find any
-// way to implement FormatLine without adding in a call to sprintf. It therefore seems more
-// efficient to me to just use C-style IO and call std::fprintf directly.
+// Implementation note: Lines are formatted by the thread that logs them, because the arguments
+// may not outlive the call, and stored in a bounded multi-producer/single-consumer ring. A single
+// writer thread drains the ring into the file and flushes once per batch rather than once per
+// line. If the ring is full, the line is counted and discarded rather than blocking the caller.
 namespace XPC
 {
+	using namespace std::chrono;
+
+	// The number of lines that can be pending at once. Must be a power of two.
+	static const std::size_t RING_SIZE = 1024;
+	static const std::size_t RING_MASK = RING_SIZE - 1;
+
+	// Longer lines are truncated.
+	static const std::size_t LINE_SIZE = 480;
+
+	struct LogRecord
+	{
+		// Equal to the enqueue position when the slot is free, and to the
+		// position plus one once the line has been written into it.
+		std::atomic<std::size_t> seq;
+		int level;
+		char tag[8];
+		system_clock::time_point time;
+		char text[LINE_SIZE];
+	};
+
+	static LogRecord ring[RING_SIZE];
+	alignas(64) static std::atomic<std::size_t> enqueuePos;
+	alignas(64) static std::size_t dequeuePos;
+	static std::atomic<std::uint64_t> dropped;
+	static std::atomic<bool> running;
+	static std::thread writer;
 	static std::FILE* fd;
-	static void WriteTime(FILE* fd)
+
+	std::atomic<int> Log::currentLevel(LOG_LEVEL);
+
+	static void WriteTime(FILE* fd, system_clock::time_point time)
 	{
-#ifdef LIN
-		// Can't provide high resolution logging on Linux because C++11 doesn't work with X-Plane.
-		time_t rawtime;
-		tm* timeinfo;
-		time(&rawtime);
-		timeinfo = localtime(&rawtime);
-
-		char buffer[16] = { 0 };
-		// Format is equivalent to [%F %T], but neither of those specifiers is
-		// supported on Windows as of Visual Studio 13
-		strftime(buffer, 16, "[%H:%M:%S] ", timeinfo);
-
-		fprintf(fd, buffer);
-#else
-		using namespace std::chrono;
-
-		system_clock::time_point now = system_clock::now();
-		std::time_t now_tt = system_clock::to_time_t(now);
-		system_clock::time_point now_sec = system_clock::from_time_t(now_tt);
-		milliseconds ms = duration_cast<milliseconds>(now - now_sec);
-		std::tm * tm = std::localtime(&now_tt);
-
-		std::stringstream ss;
-		ss << std::setfill('0')
-			<< std::setw(2) << tm->tm_hour << ":"
-			<< std::setw(2) << tm->tm_min << ":"
-			<< std::setw(2) << tm->tm_sec << "."
-			<< std::setw(3) << ms.count() << "|";
-
-		std::fprintf(fd, ss.str().c_str());
-#endif
+		std::time_t time_tt = system_clock::to_time_t(time);
+		system_clock::time_point time_sec = system_clock::from_time_t(time_tt);
+		milliseconds ms = duration_cast<milliseconds>(time - time_sec);
+		std::tm* tm = std::localtime(&time_tt);
+
+		std::fprintf(fd, "%02d:%02d:%02d.%03d|", tm->tm_hour, tm->tm_min, tm->tm_sec, (int)ms.count());
 	}
 
 	static void WriteLevel(FILE* fd, int level)
@@ -85,7 +87,62 @@ namespace XPC
 			str = "  UNK|";
 			break;
 		}
-		std::fprintf(fd, str);
+		std::fputs(str, fd);
+	}
+
+	// Writes all lines currently in the ring to the log file. Returns the
+	// number of lines written.
+	static std::size_t Drain()
+	{
+		std::size_t count = 0;
+		for (;;)
+		{
+			LogRecord& record = ring[dequeuePos & RING_MASK];
+			if (record.seq.load(std::memory_order_acquire) != dequeuePos + 1)
+			{
+				break;
+			}
+			WriteTime(fd, record.time);
+			WriteLevel(fd, record.level);
+			std::fprintf(fd, "%s|%s\n", record.tag, record.text);
+			record.seq.store(dequeuePos + RING_SIZE, std::memory_order_release);
+			++dequeuePos;
+			++count;
+		}
+		return count;
+	}
+
+	static void Run()
+	{
+		std::uint64_t reported = 0;
+		bool stopping = false;
+		while (!stopping)
+		{
+			// Read the flag before draining so that lines logged before Close
+			// are always written.
+			stopping = !running.load(std::memory_order_acquire);
+			std::size_t count = Drain();
+
+			std::uint64_t lost = dropped.load(std::memory_order_relaxed);
+			if (lost != reported)
+			{
+				WriteTime(fd, system_clock::now());
+				WriteLevel(fd, LOG_WARN);
+				std::fprintf(fd, "LOG |%llu lines dropped because the log buffer was full\n",
+					(unsigned long long)(lost - reported));
+				reported = lost;
+				++count;
+			}
+
+			if (count > 0)
+			{
+				std::fflush(fd);
+			}
+			else if (!stopping)
+			{
+				std::this_thread::sleep_for(milliseconds(10));
+			}
+		}
 	}
 
 	void Log::Initialize(const std::string& version)
@@ -129,47 +186,100 @@ namespace XPC
 			std::fprintf(fd, "Host Application ID: %d\n", hostID);
 			std::fprintf(fd, "Log file generated on %s.\n", timeStr);
 			std::fflush(fd);
+
+			for (std::size_t i = 0; i < RING_SIZE; ++i)
+			{
+				ring[i].seq.store(i, std::memory_order_relaxed);
+			}
+			enqueuePos.store(0, std::memory_order_relaxed);
+			dequeuePos = 0;
+			dropped.store(0, std::memory_order_relaxed);
+			running.store(true, std::memory_order_release);
+			writer = std::thread(Run);
 		}
 	}
 
 	void Log::Close()
 	{
+		running.store(false, std::memory_order_release);
+		if (writer.joinable())
+		{
+			writer.join();
+		}
 		if (fd)
 		{
 			std::fclose(fd);
+			fd = NULL;
 		}
 	}
 
-	void Log::WriteLine(int level, const std::string& tag, const std::string& value)
+	void Log::SetLevel(int level)
 	{
-		if (level > LOG_LEVEL || !fd)
+		if (level < LOG_OFF)
 		{
-			return;
+			level = LOG_OFF;
+		}
+		if (level > LOG_TRACE)
+		{
+			level = LOG_TRACE;
 		}
+		currentLevel.store(level, std::memory_order_relaxed);
+	}
 
-		WriteTime(fd);
-		WriteLevel(fd, level);
-		std::fprintf(fd, "%s|%s\n", tag.c_str(), value.c_str());
-		std::fflush(fd);
+	int Log::GetLevel()
+	{
+		return currentLevel.load(std::memory_order_relaxed);
 	}
 
-	void Log::FormatLine(int level, const std::string& tag, std::string format, ...)
+	std::uint64_t Log::GetDropped()
 	{
-		va_list args;
+		return dropped.load(std::memory_order_relaxed);
+	}
 
-		if (level > LOG_LEVEL || !fd)
+	void Log::Enqueue(int level, const char* tag, const char* format, ...)
+	{
+		if (!running.load(std::memory_order_acquire))
 		{
 			return;
 		}
-		va_start(args, format);
 
-		WriteTime(fd);
-		WriteLevel(fd, level);
-		std::fprintf(fd, "%s|", tag.c_str());
-		std::vfprintf(fd, format.c_str(), args);
-		std::fprintf(fd, "\n");
-		std::fflush(fd);
+		// Claim a slot. Each slot's sequence number tells us whether the
+		// writer has finished with it since the last time around the ring.
+		LogRecord* record;
+		std::size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			record = &ring[pos & RING_MASK];
+			std::size_t seq = record->seq.load(std::memory_order_acquire);
+			std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			else
+			{
+				pos = enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		record->level = level;
+		record->time = system_clock::now();
+		std::strncpy(record->tag, tag, sizeof(record->tag) - 1);
+		record->tag[sizeof(record->tag) - 1] = '\0';
 
+		va_list args;
+		va_start(args, format);
+		std::vsnprintf(record->text, LINE_SIZE, format, args);
 		va_end(args);
+
+		record->seq.store(pos + 1, std::memory_order_release);
 	}
 }
@@ -2,6 +2,8 @@
 // National Aeronautics and Space Administration. All Rights Reserved.
 #ifndef XPCPLUGIN_LOG_H_
 #define XPCPLUGIN_LOG_H_
+#include <atomic>
+#include <cstdint>
 #include <string>
 
 // LOG_VERBOSITY determines the level of logging throughout the plugin.
@@ -22,13 +24,21 @@
 #define LOG_DEBUG 5
 #define LOG_TRACE 6
 
+// LOG_LEVEL is the most verbose level compiled into the plugin. Calls above it are removed by the
+// compiler. Define it on the compiler command line to build a quieter plugin. The level actually
+// written can be lowered further at run time with Log::SetLevel.
+#ifndef LOG_LEVEL
 #define LOG_LEVEL LOG_TRACE
+#endif
 
 namespace XPC
 {
 	/// Handles logging for the plugin.
 	///
-	/// \details Provides functions to write lines to the XPC log file.
+	/// \details Provides functions to write lines to the XPC log file. Lines are formatted on the
+	///          calling thread into a preallocated ring and written to the file by a background
+	///          thread, so logging never waits on file IO. Lines at disabled levels are dropped
+	///          before any formatting is done.
 	/// \author Jason Watkins
 	/// \version 1.1
 	/// \since 1.0
@@ -38,12 +48,33 @@ namespace XPC
 	{
 	public:
 		/// Initializes the logging component by deleting old log files,
-		/// writing header information to the log file.
+		/// writing header information to the log file, and starting the
+		/// writer thread.
 		static void Initialize(const std::string& header);
 
-		/// Closes the log file.
+		/// Writes any pending lines, stops the writer thread and closes the
+		/// log file.
 		static void Close();
 
+		/// Sets the most verbose level that will be written to the log.
+		///
+		/// \param level The new level. Levels above LOG_LEVEL are never
+		///              written, regardless of this setting.
+		static void SetLevel(int level);
+
+		/// Gets the most verbose level that will be written to the log.
+		static int GetLevel();
+
+		/// Determines whether lines at the specified level will be written.
+		static bool IsEnabled(int level)
+		{
+			return level <= LOG_LEVEL && level <= currentLevel.load(std::memory_order_relaxed);
+		}
+
+		/// Gets the number of lines that were discarded because the ring was
+		/// full.
+		static std::uint64_t GetDropped();
+
 		/// Writes the string pointed to by format, followed by a line
 		/// terminator to the XPC log file. If format contains format
 		/// specifiers, additional arguments following format will be formatted
@@ -51,16 +82,35 @@ namespace XPC
 		/// specifiers.
 		///
 		/// \param format The format string appropriate for consumption by sprintf.
-		///
-		/// \remarks Note that Visual C++ silently fails va_start when the last non-varargs
-		///          argument is a reference, so we need a value-type format here.
-		static void FormatLine(int level, const std::string& tag, const std::string format, ...);
+		template<typename... Args>
+		static void FormatLine(int level, const char* tag, const char* format, Args... args)
+		{
+			if (IsEnabled(level))
+			{
+				Enqueue(level, tag, format, args...);
+			}
+		}
 
 		/// Writes the specified string value, followed by a line terminator
 		/// to the XPC log file.
 		///
 		/// \param value The value to write.
-		static void WriteLine(int level, const std::string& tag, const std::string& value);
+		static void WriteLine(int level, const char* tag, const char* value)
+		{
+			if (IsEnabled(level))
+			{
+				Enqueue(level, tag, "%s", value);
+			}
+		}
+
+	private:
+		/// Formats a line into the next free slot in the ring.
+		///
+		/// \remarks Note that Visual C++ silently fails va_start when the last non-varargs
+		///          argument is a reference, so format must be a value type here.
+		static void Enqueue(int level, const char* tag, const char* format, ...);
+
+		static std::atomic<int> currentLevel;
 	};
 }
 #endif
@@ -11,18 +11,65 @@
 
 namespace XPC
 {
-	Message::Message() {}
+	Message::Message() : buffer(NULL), capacity(0), size(0) {}
 
-	Message Message::ReadFrom(const UDPSocket& sock)
+	Message::Message(unsigned char* buffer, std::size_t capacity)
+		: buffer(buffer), capacity(capacity), size(0) {}
+
+	bool Message::ReadFrom(const UDPSocket& sock, Message& msg)
+	{
+		msg.size = 0;
+		if (msg.capacity == 0)
+		{
+			return false;
+		}
+		int len = sock.Read(msg.buffer, (int)msg.capacity, &msg.source);
+		if (len <= 0)
+		{
+			return false;
+		}
+		msg.size = len;
+		msg.received = std::chrono::steady_clock::now();
+		Log::FormatLine(LOG_TRACE, "MESG", "Read message with length %i", len);
+		return true;
+	}
+
+	int Message::ReadBatch(const UDPSocket& sock, Message* batch[], int count)
 	{
-		Message m;
-		int len = sock.Read(m.buffer, bufferSize, &m.source);
-		m.size = len < 0 ? 0 : len;
-		if (len > 0)
+		if (count > UDPSocket::MaxBatchSize)
+		{
+			count = UDPSocket::MaxBatchSize;
+		}
+		unsigned char* buffers[UDPSocket::MaxBatchSize];
+		int lengths[UDPSocket::MaxBatchSize];
+		sockaddr sources[UDPSocket::MaxBatchSize];
+		std::size_t capacity = MaxSize;
+		for (int i = 0; i < count; ++i)
+		{
+			buffers[i] = batch[i]->buffer;
+			if (batch[i]->capacity < capacity)
+			{
+				capacity = batch[i]->capacity;
+			}
+		}
+		if (count <= 0 || capacity == 0)
+		{
+			return 0;
+		}
+
+		int read = sock.ReadBatch(buffers, (int)capacity, lengths, sources, count);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (int i = 0; i < read; ++i)
+		{
+			batch[i]->size = lengths[i];
+			batch[i]->source = sources[i];
+			batch[i]->received = now;
+		}
+		if (read > 0)
 		{
-			Log::FormatLine(LOG_TRACE, "MESG", "Read message with length %i", len);
+			Log::FormatLine(LOG_TRACE, "MESG", "Read batch of %i messages", read);
 		}
-		return m;
+		return read;
 	}
 
 	std::string Message::GetHead() const
@@ -31,6 +78,16 @@ namespace XPC
 		return val;
 	}
 
+	std::uint32_t Message::GetTag() const
+	{
+		if (size < 4)
+		{
+			return 0;
+		}
+		return (std::uint32_t)buffer[0] << 24 | (std::uint32_t)buffer[1] << 16 |
+			(std::uint32_t)buffer[2] << 8 | (std::uint32_t)buffer[3];
+	}
+
 	const unsigned char* Message::GetBuffer() const
 	{
 		const unsigned char* val = size == 0 ? NULL : buffer;
@@ -47,27 +104,49 @@ namespace XPC
 		return source;
 	}
 
+	std::chrono::steady_clock::time_point Message::GetReceived() const
+	{
+		return received;
+	}
+
 	void Message::PrintToLog() const
 	{
+#if LOG_LEVEL < LOG_DEBUG
+		// Nothing below would be written, so don't pay for formatting it.
+		return;
+#else
+		if (!Log::IsEnabled(LOG_DEBUG))
+		{
+			return;
+		}
+
 		using namespace std;
 		stringstream ss;
 
 		// Dump raw bytes to string
-		ss << std::hex << setfill('0');
-		for (int i = 0; i < size; ++i)
+		if (Log::IsEnabled(LOG_TRACE))
 		{
-			ss << ' ' << setw(2) << static_cast<unsigned>(buffer[i]);
+			ss << std::hex << setfill('0');
+			for (int i = 0; i < size; ++i)
+			{
+				ss << ' ' << setw(2) << static_cast<unsigned>(buffer[i]);
+			}
+			Log::WriteLine(LOG_TRACE, "DBUG", ss.str().c_str());
+			ss.str("");
 		}
-		Log::WriteLine(LOG_TRACE, "DBUG", ss.str());
 
-		std::string head = GetHead();
-		ss.str("");
-		ss << "Head: " << head << std::dec << " Size: " << GetSize();
-		if (head == "CONN" || head == "WYPT" || head == "TEXT")
+		ss << "Head: " << GetHead() << std::dec << " Size: " << GetSize();
+		switch (GetTag())
+		{
+		case MessageTag("CONN"):
+		case MessageTag("WYPT"):
+		case MessageTag("TEXT"):
+		case MessageTag("DREI"):
 		{
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "CTRL")
+		case MessageTag("CTRL"):
 		{
 			// Parse message data
 			float pitch = *((float*)(buffer + 5));
@@ -83,19 +162,26 @@ namespace XPC
 			}
 			ss << " Attitude:(" << pitch << " " << roll << " " << yaw << ")";
 			ss << " Thr:" << thr << " Gear:" << (int)gear << " Flaps:" << flaps;
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "DATA")
+		case MessageTag("DATA"):
 		{
 			size_t numCols = (size - 5) / 36;
+			ss << " (" << numCols << " lines)";
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+
+			// Only print the first lines of very large messages.
+			if (numCols > 32)
+			{
+				numCols = 32;
+			}
 			float values[32][9];
 			for (int i = 0; i < numCols; ++i)
 			{
 				values[i][0] = buffer[5 + 36 * i];
 				memcpy(values[i] + 1, buffer + 9 + 36 * i, 9 * sizeof(float));
 			}
-			ss << " (" << numCols << " lines)";
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
 			for (int i = 0; i < numCols; ++i)
 			{
 				ss.str("");
@@ -104,12 +190,13 @@ namespace XPC
 				{
 					ss << " " << values[i][j];
 				}
-				Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+				Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
 			}
+			break;
 		}
-		else if (head == "DREF")
+		case MessageTag("DREF"):
 		{
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
 			string dref((char*)buffer + 6, buffer[5]);
 			Log::FormatLine(LOG_DEBUG, "DBUG", "    DREF (size %i) = %s", dref.length(), dref.c_str());
 			ss.str("");
@@ -119,16 +206,21 @@ namespace XPC
 			{
 				ss << " " << *((float*)(buffer + values + 1 + sizeof(float) * i));
 			}
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "GETC" || head == "GETP" || head == "GETT")
+		case MessageTag("GETC"):
+		case MessageTag("GETP"):
+		case MessageTag("GETT"):
 		{
 			ss << " Aircraft:" << (int)buffer[5];
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "GETD")
+		case MessageTag("GETD"):
+		case MessageTag("GETY"):
 		{
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
 			int cur = 6;
 			for (int i = 0; i < buffer[5]; ++i)
 			{
@@ -137,8 +229,89 @@ namespace XPC
 					i + 1, buffer[5], dref.length(), dref.c_str());
 				cur += 1 + buffer[cur];
 			}
+			break;
+		}
+		case MessageTag("BPOS"):
+		{
+			if (size >= 7)
+			{
+				ss << " Aircraft:" << (int)buffer[5] << " Flags:" << (int)buffer[6];
+			}
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		case MessageTag("GETS"):
+		{
+			ss << " Aircraft:" << (size > 5 ? (int)buffer[5] : 0);
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		case MessageTag("TPOS"):
+		{
+			if (size == 56)
+			{
+				double time;
+				memcpy(&time, buffer + 8, 8);
+				ss << " Aircraft:" << (int)buffer[5] << " Time:" << time;
+			}
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		case MessageTag("TRAJ"):
+		{
+			if (size >= 18)
+			{
+				std::uint32_t first;
+				memcpy(&first, buffer + 12, 4);
+				ss << " Aircraft:" << (int)buffer[5] << " Flags:" << (int)buffer[6] << " First:" << first;
+			}
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		case MessageTag("PLAY"):
+		{
+			if (size == 15)
+			{
+				double value;
+				memcpy(&value, buffer + 7, 8);
+				ss << " Aircraft:" << (int)buffer[5] << " Command:" << (int)buffer[6] << " Value:" << value;
+			}
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "POSI" || head == "POST")
+		case MessageTag("GTRS"):
+		case MessageTag("HIST"):
+		case MessageTag("RECD"):
+		{
+			ss << " Op:" << (size > 5 ? (int)buffer[5] : 0);
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		case MessageTag("GETF"):
+		{
+			if (size < 10)
+			{
+				Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+				break;
+			}
+			unsigned short seq;
+			unsigned short mtu;
+			memcpy(&seq, buffer + 5, 2);
+			memcpy(&mtu, buffer + 7, 2);
+			ss << " Seq:" << seq << " MTU:" << mtu;
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			std::size_t cur = 10;
+			for (int i = 0; i < buffer[9] && cur < size; ++i)
+			{
+				string dref((char*)buffer + cur + 1, buffer[cur]);
+				Log::FormatLine(LOG_DEBUG, "DBUG", "    #%i/%i (size:%i) %s",
+					i + 1, buffer[9], dref.length(), dref.c_str());
+				cur += 1 + buffer[cur];
+			}
+			break;
+		}
+		case MessageTag("POSI"):
+		case MessageTag("POST"):
 		{
 			char aircraft = buffer[5];
 			float gear;
@@ -164,27 +337,51 @@ namespace XPC
 			ss << " Pos:(" << pos[0] << ' ' << pos[1] << ' ' << pos[2] << ") Orient:(";
 			ss << orient[0] << ' ' << orient[1] << ' ' << orient[2] << ") Gear:";
 			ss << gear;
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "SIMU")
+		case MessageTag("SIMU"):
+		case MessageTag("LOGL"):
+		case MessageTag("STAT"):
 		{
 			ss << ' ' << (int)buffer[5];
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "VIEW")
+		case MessageTag("RSLV"):
+		case MessageTag("GETI"):
+		{
+			ss << " Count:" << (int)buffer[5];
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		case MessageTag("SUBS"):
+		{
+			ss << " Divisor:" << *((unsigned short*)(buffer + 5));
+			ss << " Port:" << *((unsigned short*)(buffer + 7));
+			ss << " Count:" << (int)buffer[9];
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		case MessageTag("VIEW"):
 		{
 			ss << "Type:" << *((unsigned long*)(buffer + 5));
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
 		}
-		else if (head == "COMM")
- 		{
+		case MessageTag("COMM"):
+		{
  			ss << "Type:" << *((unsigned long*)(buffer + 5));
- 			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
- 		}
-		else
+ 			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
+		default:
 		{
 			ss << " UNKNOWN HEADER ";
-			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str());
+			Log::WriteLine(LOG_DEBUG, "DBUG", ss.str().c_str());
+			break;
+		}
 		}
+#endif
 	}
 }
@@ -5,10 +5,34 @@
 
 #include "UDPSocket.h"
 
+#include <chrono>
+#include <cstdint>
+
 namespace XPC
 {
+	/// Packs a four character message header into a 32 bit tag.
+	///
+	/// \details The first character is stored in the most significant byte,
+	///          so tags sort in the same order as the headers they represent.
+	///          Because this function is constexpr, tags for known message
+	///          types can be used as case labels and in constant tables.
+	/// \param head The message header, e.g. "CONN".
+	/// \returns    The packed tag.
+	constexpr std::uint32_t MessageTag(const char (&head)[5])
+	{
+		return (std::uint32_t)(unsigned char)head[0] << 24 |
+			(std::uint32_t)(unsigned char)head[1] << 16 |
+			(std::uint32_t)(unsigned char)head[2] << 8 |
+			(std::uint32_t)(unsigned char)head[3];
+	}
+
 	/// Represents a message received from an XPC client.
 	///
+	/// \details A message is a view of a buffer it does not own. The buffer is
+	///          set when the message is constructed and reused by every read,
+	///          so messages can be copied and swapped cheaply and reading does
+	///          not allocate. The buffer must outlive the message.
+	///
 	/// \author Jason Watkins
 	/// \version 1.1
 	/// \since 1.0
@@ -17,18 +41,44 @@ namespace XPC
 	class Message
 	{
 	public:
-		/// Reads a datagram from the specified socket and interprets it as a
-		/// message.
+		/// Initializes a new, empty message that has no buffer to read into.
+		Message();
+
+		/// Initializes a new, empty message that reads into the specified
+		/// buffer.
+		///
+		/// \param buffer   The buffer to read into.
+		/// \param capacity The size of buffer in bytes. Datagrams larger than
+		///                 this are truncated.
+		Message(unsigned char* buffer, std::size_t capacity);
+
+		/// Reads a datagram from the specified socket into the buffer of the
+		/// specified message.
 		///
 		/// \param sock The socket to read from.
-		/// \returns    A message parsed from the data read from sock. If no
-		///             data was read or an error occurs, returns a message
-		///             with the size set to 0.
-		static Message ReadFrom(const UDPSocket& sock);
+		/// \param msg  The message to read into.
+		/// \returns    true if a datagram was read; otherwise false, and the
+		///             size of msg is set to 0.
+		static bool ReadFrom(const UDPSocket& sock, Message& msg);
+
+		/// Reads all immediately available datagrams from the specified socket,
+		/// up to the specified count, into a preallocated batch of messages.
+		///
+		/// \param sock  The socket to read from.
+		/// \param batch Pointers to the messages to read into.
+		/// \param count The number of messages in batch.
+		/// \returns     The number of messages read.
+		static int ReadBatch(const UDPSocket& sock, Message* batch[], int count);
 
 		/// Gets the message header.
 		std::string GetHead() const;
 
+		/// Gets the message header packed into a 32 bit tag as by MessageTag.
+		///
+		/// \returns The message tag, or 0 if the message is too short to have
+		///          a header.
+		std::uint32_t GetTag() const;
+
 		/// Gets the buffer underlying the message.
 		const unsigned char* GetBuffer() const;
 
@@ -38,16 +88,22 @@ namespace XPC
 		/// Gets the address this message was read from.
 		struct sockaddr GetSource() const;
 
+		/// Gets the time at which this message was read from the socket.
+		std::chrono::steady_clock::time_point GetReceived() const;
+
 		/// Prints the contents of the message to the XPC log.
 		void PrintToLog() const;
 
-	private:
-		Message();
+		/// The size of the largest UDP datagram over IPv4. A buffer of this
+		/// size never truncates a message.
+		static const std::size_t MaxSize = 65507;
 
-		static const std::size_t bufferSize = 4096;
-		unsigned char buffer[bufferSize];
+	private:
+		unsigned char* buffer;
+		std::size_t capacity;
 		std::size_t size;
 		struct sockaddr source;
+		std::chrono::steady_clock::time_point received;
 	};
 }
 #endif
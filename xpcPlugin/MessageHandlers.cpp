@@ -18,12 +18,18 @@
 #include "MessageHandlers.h"
 #include "DataManager.h"
 #include "Drawing.h"
+#include "History.h"
+#include "Interpolator.h"
 #include "Log.h"
+#include "Playback.h"
+#include "Recorder.h"
+#include "Statistics.h"
 
 #include "XPLMUtilities.h"
 #include "XPLMScenery.h"
 #include "XPLMGraphics.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <cstdint>
@@ -33,109 +39,367 @@
 
 namespace XPC
 {
-	std::map<std::string, MessageHandlers::ConnectionInfo> MessageHandlers::connections;
-	std::map<std::string, MessageHandler> MessageHandlers::handlers;
-
-	std::string MessageHandlers::connectionKey;
-	MessageHandlers::ConnectionInfo MessageHandlers::connection;
+	ConnectionTable MessageHandlers::connections;
+	ConnectionInfo* MessageHandlers::connection;
 	UDPSocket* MessageHandlers::sock;
+	SendQueue MessageHandlers::outbox;
 
 	static sockaddr multicast_address = UDPSocket::GetAddr(MULTICAST_GROUP, MULITCAST_PORT);
 	
 	// define a static terrain probe handler (do not re-create probe for each query)
 	XPLMProbeRef Terrain_probe = nullptr;
 
+	static const std::size_t RESPONSE_SIZE = 4096;
+
+	// The largest possible RESP message: 255 drefs of 255 floats each. Plans
+	// for fragmented responses are compiled with this limit so they are never
+	// truncated.
+	static const std::size_t FRAGMENTED_RESPONSE_SIZE = 6 + 255 * (1 + 255 * sizeof(float));
+
+	// Datagram size limits for RESF messages. The default keeps each fragment
+	// inside a standard Ethernet frame so that it is never IP fragmented.
+	static const std::size_t DEFAULT_MTU = 1472;
+	static const std::size_t MIN_MTU = 64;
+
+	// RESF: header (10) | runs. Run: header (4) | values
+	static const std::size_t FRAGMENT_HEADER_SIZE = 10;
+	static const std::size_t RUN_HEADER_SIZE = 4;
+
+	static const unsigned short INVALID_DREF_ID = 0xFFFF;
+
+	// The number of updates between keyframes for subscriptions to changes
+	// that don't ask for a keyframe interval. Keyframes resynchronize clients
+	// that lost a RESD message, so they are always sent periodically.
+	static const unsigned short DEFAULT_KEYFRAME_INTERVAL = 100;
+
+	// The most HISR messages sent in response to one HIST query, so that a
+	// long window doesn't flood the network in a single frame. Clients page
+	// through the rest.
+	static const std::size_t HIST_PAGE_FRAGMENTS = 64;
+
+	// Element types in REST messages
+	static const unsigned char REST_NONE = 0;
+	static const unsigned char REST_INT = 1;
+	static const unsigned char REST_FLOAT = 2;
+	static const unsigned char REST_DOUBLE = 3;
+	static const unsigned char REST_BYTES = 4;
+
+	// Adds a dref to a plan for writing RESP messages, or REST messages if
+	// typed is true, starting at offset cur in the message. Returns the offset
+	// of the next dref. The values are truncated to fit in limit bytes, and
+	// the dref is dropped if not even its header fits.
+	static std::size_t AppendToPlan(std::vector<GetdPlanEntry>& plan, std::size_t cur,
+		const ResolvedDref& dref, const char* tag, bool typed = false, std::size_t limit = RESPONSE_SIZE)
+	{
+		// RESP: count (1) | floats. REST: type (1) | count (1) | native values
+		std::size_t header = typed ? 2 : 1;
+		std::size_t elementSize = typed ? DataManager::ElementSize(dref.type) : sizeof(float);
+		if (cur + header > limit)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Response too large. Dropping dref %u.",
+				(unsigned)plan.size() + 1);
+			return cur;
+		}
+		GetdPlanEntry entry;
+		entry.dref = dref;
+		entry.offset = cur;
+		if (entry.dref.count > 255)
+		{
+			entry.dref.count = 255;
+		}
+		if (elementSize == 0)
+		{
+			entry.dref.count = 0;
+		}
+		else
+		{
+			std::size_t available = (limit - cur - header) / elementSize;
+			if ((std::size_t)entry.dref.count > available)
+			{
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Response too large. Truncating dref %u to %u values.",
+					(unsigned)plan.size() + 1, (unsigned)available);
+				entry.dref.count = (int)available;
+			}
+		}
+		plan.push_back(entry);
+		return cur + header + entry.dref.count * elementSize;
+	}
+
+	// Compiles a list of dref names, each prefixed by its length, into a plan
+	// for writing RESP messages, or REST messages if typed is true. size is
+	// the number of bytes in buffer. Returns the size of the message, or 0
+	// with an empty plan if the names run past the end of buffer.
+	static std::size_t CompilePlan(const unsigned char* buffer, std::size_t size, unsigned char drefCount,
+		std::vector<GetdPlanEntry>& plan, const char* tag, bool typed = false, std::size_t limit = RESPONSE_SIZE)
+	{
+		plan.clear();
+		std::size_t ptr = 0;
+		std::size_t cur = 6;
+		// Leave room for the headers of the drefs that follow, so that every
+		// dref gets a row even when the values of earlier ones are truncated.
+		std::size_t header = typed ? 2 : 1;
+		for (int i = 0; i < drefCount; ++i)
+		{
+			if (ptr >= size || ptr + 1 + buffer[ptr] > size)
+			{
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Dref %i runs past the end of the message", i + 1);
+				plan.clear();
+				return 0;
+			}
+			unsigned char len = buffer[ptr];
+			ResolvedDref dref = DataManager::Resolve(std::string((char*)buffer + 1 + ptr, len), typed);
+			cur = AppendToPlan(plan, cur, dref, tag, typed, limit - (drefCount - i - 1) * header);
+			ptr += 1 + len;
+		}
+		return cur;
+	}
+
+	// Looks up a dref id assigned to a connection by RSLV.
+	static const ResolvedDref* FindDrefId(const ConnectionInfo& conn, unsigned short id, const char* tag)
+	{
+		if (id >= conn.drefIds.size())
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Unknown dref id %u (Conn %u)", id, conn.id);
+			return NULL;
+		}
+		return &conn.drefIds[id];
+	}
+
+	// Reads the drefs in a compiled plan into a RESP message.
+	static void WriteResponse(const std::vector<GetdPlanEntry>& plan, unsigned char response[])
+	{
+		memcpy(response, "RESP", 5);
+		response[5] = (unsigned char)plan.size();
+		for (std::size_t i = 0; i < plan.size(); ++i)
+		{
+			const GetdPlanEntry& entry = plan[i];
+			float values[255];
+			int count = DataManager::Read(entry.dref, values, entry.dref.count);
+			if (count < entry.dref.count)
+			{
+				// Keep the layout of the response fixed if an array shrank.
+				memset(values + count, 0, (entry.dref.count - count) * sizeof(float));
+			}
+			response[entry.offset] = (unsigned char)entry.dref.count;
+			memcpy(response + entry.offset + 1, values, entry.dref.count * sizeof(float));
+		}
+	}
+
+	// Reads the drefs in a compiled plan into a REST message.
+	static void WriteTypedResponse(const std::vector<GetdPlanEntry>& plan, unsigned char response[])
+	{
+		memcpy(response, "REST", 5);
+		response[5] = (unsigned char)plan.size();
+		for (std::size_t i = 0; i < plan.size(); ++i)
+		{
+			const GetdPlanEntry& entry = plan[i];
+			unsigned char type;
+			switch (entry.dref.type)
+			{
+			case xplmType_Int:
+			case xplmType_IntArray:
+				type = REST_INT;
+				break;
+			case xplmType_Float:
+			case xplmType_FloatArray:
+				type = REST_FLOAT;
+				break;
+			case xplmType_Double:
+				type = REST_DOUBLE;
+				break;
+			case xplmType_Data:
+				type = REST_BYTES;
+				break;
+			default:
+				type = REST_NONE;
+				break;
+			}
+			unsigned char* values = response + entry.offset + 2;
+			int count = DataManager::ReadNative(entry.dref, values, entry.dref.count);
+			if (count < entry.dref.count)
+			{
+				// Keep the layout of the response fixed if an array shrank.
+				int elementSize = DataManager::ElementSize(entry.dref.type);
+				memset(values + count * elementSize, 0, (entry.dref.count - count) * elementSize);
+			}
+			response[entry.offset] = type;
+			response[entry.offset + 1] = (unsigned char)entry.dref.count;
+		}
+	}
+
+	// Gets space in out for the next RESF message and writes its header.
+	static unsigned char* BeginFragment(SendQueue& out, std::size_t mtu, unsigned short seq,
+		int index, int total, std::size_t drefCount)
+	{
+		unsigned char* fragment = out.Reserve(mtu);
+		memcpy(fragment, "RESF", 5);
+		memcpy(fragment + 5, &seq, sizeof(seq));
+		fragment[7] = (unsigned char)index;
+		fragment[8] = (unsigned char)total;
+		fragment[9] = (unsigned char)drefCount;
+		return fragment;
+	}
+
+	// Reads the drefs in a compiled plan and splits their values into RESF
+	// messages of at most mtu bytes, queued in out. Each fragment holds runs
+	// of consecutive elements tagged with where they belong, so clients can
+	// use fragments in any order without reassembling them. If out is NULL,
+	// nothing is read or written. Returns the number of fragments.
+	static int WriteFragments(const std::vector<GetdPlanEntry>& plan, std::size_t mtu, unsigned short seq,
+		int total, SendQueue* out, const sockaddr& addr)
+	{
+		unsigned char* fragment = out ? BeginFragment(*out, mtu, seq, 0, total, plan.size()) : NULL;
+		std::size_t cur = FRAGMENT_HEADER_SIZE;
+		int index = 0;
+		for (std::size_t i = 0; i < plan.size(); ++i)
+		{
+			const GetdPlanEntry& entry = plan[i];
+			int count = entry.dref.count;
+			float values[255];
+			if (out)
+			{
+				int read = DataManager::Read(entry.dref, values, count);
+				if (read < count)
+				{
+					// Keep the layout of the response fixed if an array shrank.
+					memset(values + read, 0, (count - read) * sizeof(float));
+				}
+			}
+
+			// Every dref gets at least one run, even if it is empty, so that
+			// the client learns its size.
+			int start = 0;
+			do
+			{
+				std::size_t needed = RUN_HEADER_SIZE + (start < count ? sizeof(float) : 0);
+				if (cur + needed > mtu)
+				{
+					++index;
+					if (out)
+					{
+						out->Commit(cur, addr);
+						fragment = BeginFragment(*out, mtu, seq, index, total, plan.size());
+					}
+					cur = FRAGMENT_HEADER_SIZE;
+				}
+				int length = (int)((mtu - cur - RUN_HEADER_SIZE) / sizeof(float));
+				if (length > count - start)
+				{
+					length = count - start;
+				}
+				if (out)
+				{
+					fragment[cur] = (unsigned char)i;
+					fragment[cur + 1] = (unsigned char)count;
+					fragment[cur + 2] = (unsigned char)start;
+					fragment[cur + 3] = (unsigned char)length;
+					memcpy(fragment + cur + RUN_HEADER_SIZE, values + start, length * sizeof(float));
+				}
+				cur += RUN_HEADER_SIZE + length * sizeof(float);
+				start += length;
+			} while (start < count);
+		}
+		if (out)
+		{
+			out->Commit(cur, addr);
+		}
+		return index + 1;
+	}
+
+	// Compares a RESP message written for a subscription with the values last
+	// sent and writes the elements that moved further than their deadband to a
+	// RESD message. Returns the size of the RESD message, or 0 if a keyframe
+	// should be sent instead.
+	static std::size_t WriteChanges(Subscription& subs, const unsigned char full[], unsigned char sparse[])
+	{
+		// Format: RESD\0 | change count (2) | changes
+		// Change: dref index (1) | element index (1) | value (4)
+		const std::size_t CHANGE_SIZE = 6;
+		memcpy(sparse, "RESD", 5);
+		std::size_t cur = 7;
+		std::size_t last = 0;
+		unsigned short changes = 0;
+		for (std::size_t i = 0; i < subs.plan.size(); ++i)
+		{
+			const GetdPlanEntry& entry = subs.plan[i];
+			float deadband = subs.deadbands[i];
+			for (int j = 0; j < entry.dref.count; ++j, ++last)
+			{
+				float value;
+				memcpy(&value, full + entry.offset + 1 + j * sizeof(float), sizeof(float));
+				float prev = subs.lastSent[last];
+				bool valueNaN = value != value;
+				bool prevNaN = prev != prev;
+				bool changed = valueNaN || prevNaN ? valueNaN != prevNaN : std::fabs(value - prev) > deadband;
+				if (!changed)
+				{
+					continue;
+				}
+				if (cur + CHANGE_SIZE > subs.size)
+				{
+					// The changes are no smaller than the full message.
+					return 0;
+				}
+				sparse[cur] = (unsigned char)i;
+				sparse[cur + 1] = (unsigned char)j;
+				memcpy(sparse + cur + 2, &value, sizeof(float));
+				cur += CHANGE_SIZE;
+				subs.lastSent[last] = value;
+				++changes;
+			}
+		}
+		memcpy(sparse + 5, &changes, sizeof(changes));
+		return cur;
+	}
+
 	void MessageHandlers::SetSocket(UDPSocket* socket)
 	{
 		Log::WriteLine(LOG_TRACE, "MSGH", "Setting socket");
 		MessageHandlers::sock = socket;
+		outbox.SetSocket(socket);
 	}
 
-	void MessageHandlers::HandleMessage(Message& msg)
+	void MessageHandlers::FlushResponses()
 	{
-		if (handlers.size() == 0)
-		{
-			Log::WriteLine(LOG_TRACE, "MSGH", "Initializing handlers");
-			// Common messages
-			handlers.insert(std::make_pair("CONN", MessageHandlers::HandleConn));
-			handlers.insert(std::make_pair("CTRL", MessageHandlers::HandleCtrl));
-			handlers.insert(std::make_pair("DATA", MessageHandlers::HandleData));
-			handlers.insert(std::make_pair("DREF", MessageHandlers::HandleDref));
-			handlers.insert(std::make_pair("GETD", MessageHandlers::HandleGetD));
-			handlers.insert(std::make_pair("POSI", MessageHandlers::HandlePosi));
-			handlers.insert(std::make_pair("POST", MessageHandlers::HandlePosT));
-			handlers.insert(std::make_pair("SIMU", MessageHandlers::HandleSimu));
-			handlers.insert(std::make_pair("TEXT", MessageHandlers::HandleText));
-			handlers.insert(std::make_pair("WYPT", MessageHandlers::HandleWypt));
-			handlers.insert(std::make_pair("VIEW", MessageHandlers::HandleView));
-			handlers.insert(std::make_pair("GETC", MessageHandlers::HandleGetC));
-			handlers.insert(std::make_pair("GETP", MessageHandlers::HandleGetP));
-			handlers.insert(std::make_pair("COMM", MessageHandlers::HandleComm));
-			handlers.insert(std::make_pair("GETT", MessageHandlers::HandleGetT));
-			// X-Plane data messages
-			handlers.insert(std::make_pair("DSEL", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("USEL", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("DCOC", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("UCOC", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("MOUS", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("CHAR", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("MENU", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("SOUN", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("FAIL", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("RECO", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("PAPT", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("VEHN", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("VEH1", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("VEHA", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("GSET", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("OBJN", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("OBJL", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("GSET", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("ISET", MessageHandlers::HandleXPlaneData));
-			handlers.insert(std::make_pair("BOAT", MessageHandlers::HandleXPlaneData));
-		}
+		outbox.Flush();
+	}
 
+	void MessageHandlers::HandleMessage(Message& msg)
+	{
 		// Make sure we really have a message to handle.
-		std::string head = msg.GetHead();
-		if (head == "")
+		if (msg.GetSize() < 4)
 		{
 			Log::WriteLine(LOG_WARN, "MSGH", "Warning: HandleMessage called with empty message.");
 			return; // No Message to handle
 		}
 
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Statistics::RecordQueueWait(start - msg.GetReceived());
+
 		// Set current connection
 		sockaddr sourceaddr = msg.GetSource();
-		connectionKey = UDPSocket::GetHost(&sourceaddr);
-		Log::FormatLine(LOG_INFO, "MSGH", "Handling message from %s", connectionKey.c_str());
-		std::map<std::string, ConnectionInfo>::iterator conn = connections.find(connectionKey);
-		if (conn == connections.end()) // New connection
-		{
-			connection = MessageHandlers::ConnectionInfo();
-			// If this is a new connection, that means we just added an elment
-			// to connections. As long as we never remove elements, the size of
-			// connections will serve as a unique id.
-			connection.id = static_cast<unsigned char>(connections.size());
-			connection.addr = sourceaddr;
-			connection.getdCount = 0;
-			connections[connectionKey] = connection;
+		bool isNew;
+		connection = connections.Get(sourceaddr, isNew);
+		if (isNew)
+		{
 			Log::FormatLine(LOG_DEBUG, "MSGH", "New connection. ID=%u, Remote=%s",
-				connection.id, connectionKey.c_str());
+				connection->id, UDPSocket::GetHost(&sourceaddr).c_str());
 		}
-		else
+		Log::FormatLine(LOG_INFO, "MSGH", "Handling message from connection %u", connection->id);
+
+		if (Log::IsEnabled(LOG_DEBUG))
 		{
-			connection = (*conn).second;
-			Log::FormatLine(LOG_DEBUG, "MSGH", "Existing connection. ID=%u, Remote=%s",
-				connection.id, connectionKey.c_str());
+			msg.PrintToLog();
 		}
-
-		msg.PrintToLog();
 		// Check if there is a handler for this message type. If so, execute
 		// that handler. Otherwise, execute the unknown message handler.
-		std::map<std::string, MessageHandler>::iterator iter = handlers.find(head);
-		if (iter != handlers.end())
+		std::uint32_t tag = msg.GetTag();
+		MessageHandler handler = GetHandler(tag);
+		if (handler)
 		{
-			MessageHandler handler = (*iter).second;
 			handler(msg);
+			Statistics::RecordHandler(tag, std::chrono::steady_clock::now() - start);
+			Statistics::Increment(COUNTER_MessagesHandled);
 		}
 		else
 		{
@@ -143,6 +407,104 @@ namespace XPC
 		}
 	}
 
+	namespace
+	{
+		struct HandlerEntry
+		{
+			std::uint32_t tag;
+			MessageHandler handler;
+		};
+
+		template <std::size_t N>
+		constexpr bool IsStrictlySorted(const HandlerEntry (&table)[N], std::size_t i = 1)
+		{
+			return i >= N || (table[i - 1].tag < table[i].tag && IsStrictlySorted(table, i + 1));
+		}
+	}
+
+	MessageHandler MessageHandlers::GetHandler(std::uint32_t tag)
+	{
+		// Handlers sorted by tag so that they can be binary searched. The table
+		// is built by the compiler, so lookups never allocate and there is
+		// nothing to initialize before the first message arrives.
+		static constexpr HandlerEntry handlers[] =
+		{
+			{ MessageTag("BOAT"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("BPOS"), MessageHandlers::HandleBpos },
+			{ MessageTag("CHAR"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("COMM"), MessageHandlers::HandleComm },
+			{ MessageTag("CONN"), MessageHandlers::HandleConn },
+			{ MessageTag("CTRL"), MessageHandlers::HandleCtrl },
+			{ MessageTag("DATA"), MessageHandlers::HandleData },
+			{ MessageTag("DCOC"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("DREF"), MessageHandlers::HandleDref },
+			{ MessageTag("DREI"), MessageHandlers::HandleDrei },
+			{ MessageTag("DSEL"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("FAIL"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("GETC"), MessageHandlers::HandleGetC },
+			{ MessageTag("GETD"), MessageHandlers::HandleGetD },
+			{ MessageTag("GETF"), MessageHandlers::HandleGetF },
+			{ MessageTag("GETI"), MessageHandlers::HandleGetI },
+			{ MessageTag("GETP"), MessageHandlers::HandleGetP },
+			{ MessageTag("GETS"), MessageHandlers::HandleGetS },
+			{ MessageTag("GETT"), MessageHandlers::HandleGetT },
+			{ MessageTag("GETY"), MessageHandlers::HandleGetY },
+			{ MessageTag("GSET"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("GTRS"), MessageHandlers::HandleGetTs },
+			{ MessageTag("HIST"), MessageHandlers::HandleHist },
+			{ MessageTag("ISET"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("LOGL"), MessageHandlers::HandleLogl },
+			{ MessageTag("MENU"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("MOUS"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("OBJL"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("OBJN"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("PAPT"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("PLAY"), MessageHandlers::HandlePlay },
+			{ MessageTag("POSI"), MessageHandlers::HandlePosi },
+			{ MessageTag("POST"), MessageHandlers::HandlePosT },
+			{ MessageTag("RECD"), MessageHandlers::HandleRecd },
+			{ MessageTag("RECO"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("RSLV"), MessageHandlers::HandleRslv },
+			{ MessageTag("SIMU"), MessageHandlers::HandleSimu },
+			{ MessageTag("SOUN"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("STAT"), MessageHandlers::HandleStat },
+			{ MessageTag("SUBS"), MessageHandlers::HandleSubs },
+			{ MessageTag("TEXT"), MessageHandlers::HandleText },
+			{ MessageTag("TPOS"), MessageHandlers::HandleTpos },
+			{ MessageTag("TRAJ"), MessageHandlers::HandleTraj },
+			{ MessageTag("UCOC"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("USEL"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("VEH1"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("VEHA"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("VEHN"), MessageHandlers::HandleXPlaneData },
+			{ MessageTag("VIEW"), MessageHandlers::HandleView },
+			{ MessageTag("WYPT"), MessageHandlers::HandleWypt },
+		};
+		static_assert(IsStrictlySorted(handlers), "Message handlers must be sorted by tag without duplicates");
+
+		const HandlerEntry* first = handlers;
+		const HandlerEntry* last = handlers + sizeof(handlers) / sizeof(handlers[0]);
+		const HandlerEntry* iter = std::lower_bound(first, last, tag,
+			[](const HandlerEntry& entry, std::uint32_t t) { return entry.tag < t; });
+		return (iter != last && iter->tag == tag) ? iter->handler : NULL;
+	}
+
+	void MessageHandlers::EvictIdleConnections(std::chrono::seconds maxIdle)
+	{
+		std::size_t removed = connections.EvictIdle(maxIdle);
+		if (removed > 0)
+		{
+			Log::FormatLine(LOG_INFO, "MSGH", "Removed %u idle connections (%u remaining)",
+				(unsigned)removed, (unsigned)connections.Size());
+		}
+	}
+
+	void MessageHandlers::ClearConnections()
+	{
+		connection = NULL;
+		connections.Clear();
+	}
+
 	void MessageHandlers::SendBeacon(const std::string& pluginVersion, unsigned short  pluginReceivePort, int xplaneVersion) {
 
 		unsigned char response[128] = "BECN";
@@ -171,7 +533,8 @@ namespace XPC
 
 		// Store new port
 		unsigned short port = *((unsigned short*)(buffer + 5));
-		sockaddr* sa = &connection.addr;
+		sockaddr addr = connection->addr;
+		sockaddr* sa = &addr;
 		switch (sa->sa_family)
 		{
 		case AF_INET: // IPV4 address
@@ -190,26 +553,27 @@ namespace XPC
 			Log::WriteLine(LOG_ERROR, "CONN", "ERROR: Unknown address type.");
 			return;
 		}
-		connections.erase(connectionKey);
-		connectionKey = UDPSocket::GetHost(&connection.addr);
-		connections[connectionKey] = connection;
+		connections.Rebind(connection, addr);
 
-		// Create response
-		unsigned char response[6] = "CONF";
-		response[5] = connection.id;
+		// Create response. Byte 5 holds the low byte of the id for older
+		// clients, followed by the full 32 bit id.
+		unsigned char response[10] = "CONF";
+		response[5] = (unsigned char)connection->id;
+		std::uint32_t id = connection->id;
+		memcpy(response + 6, &id, sizeof(id));
 
 		// Update log
 		Log::FormatLine(LOG_TRACE, "CONN", "ID: %u New destination port: %u",
-			connection.id, port);
+			connection->id, port);
 
 		// Send response
-		sock->SendTo(response, 6, &connection.addr);
+		outbox.Send(response, 10, connection->addr);
 	}
 
 	void MessageHandlers::HandleCtrl(const Message& msg)
 	{
 		// Update Log
-		Log::FormatLine(LOG_TRACE, "CTRL", "Message Received (Conn %i)", connection.id);
+		Log::FormatLine(LOG_TRACE, "CTRL", "Message Received (Conn %u)", connection->id);
 
 		const unsigned char* buffer = msg.GetBuffer();
 		std::size_t size = msg.GetSize();
@@ -240,46 +604,7 @@ namespace XPC
 			spdbrk = *((float*)(buffer + 27));
 		}
 
-
-		if (!DataManager::IsDefault(pitch))
-		{
-			DataManager::Set(DREF_YokePitch, pitch, aircraftNumber);
-		}
-		if (!DataManager::IsDefault(roll))
-		{
-			DataManager::Set(DREF_YokeRoll, roll, aircraftNumber);
-		}
-		if (!DataManager::IsDefault(yaw))
-		{
-			DataManager::Set(DREF_YokeHeading, yaw, aircraftNumber);
-		}
-		if (!DataManager::IsDefault(throttle))
-		{
-
-			float throttleArray[8];
-			for (int i = 0; i < 8; ++i)
-			{
-				throttleArray[i] = throttle;
-			}
-			DataManager::Set(DREF_ThrottleSet, throttleArray, 8, aircraftNumber);
-			DataManager::Set(DREF_ThrottleActual, throttleArray, 8, aircraftNumber);
-			if (aircraftNumber == 0)
-			{
-				DataManager::Set("sim/flightmodel/engine/ENGN_thro_override", throttleArray, 1);
-			}
-		}
-		if (gear != -1)
-		{
-			DataManager::SetGear(gear, false, aircraftNumber);
-		}
-		if (!DataManager::IsDefault(flaps))
-		{
-			DataManager::Set(DREF_FlapSetting, flaps, aircraftNumber);
-		}
-		if (!DataManager::IsDefault(spdbrk))
-		{
-			DataManager::Set(DREF_SpeedBrakeSet, spdbrk, aircraftNumber);
-		}
+		DataManager::SetControls(aircraftNumber, pitch, roll, yaw, throttle, gear, flaps, spdbrk);
 	}
 
 	void MessageHandlers::HandleData(const Message& msg)
@@ -290,11 +615,11 @@ namespace XPC
 		std::size_t numCols = (size - 5) / 36;
 		if (numCols > 0)
 		{
-			Log::FormatLine(LOG_TRACE, "DATA", "Message Received (Conn %i)", connection.id);
+			Log::FormatLine(LOG_TRACE, "DATA", "Message Received (Conn %u)", connection->id);
 		}
 		else
 		{
-			Log::FormatLine(LOG_WARN, "DATA", "WARNING: Empty data packet received (Conn %i)", connection.id);
+			Log::FormatLine(LOG_WARN, "DATA", "WARNING: Empty data packet received (Conn %u)", connection->id);
 			return;
 		}
 
@@ -434,7 +759,7 @@ namespace XPC
 
 	void MessageHandlers::HandleDref(const Message& msg)
 	{
-		Log::FormatLine(LOG_TRACE, "DREF", "Request to set DREF value received (Conn %i)", connection.id);
+		Log::FormatLine(LOG_TRACE, "DREF", "Request to set DREF value received (Conn %u)", connection->id);
 		const unsigned char* buffer = msg.GetBuffer();
 		std::size_t size = msg.GetSize();
 		std::size_t pos = 5;
@@ -465,6 +790,38 @@ namespace XPC
 		}
 	}
 
+	void MessageHandlers::HandleDrei(const Message& msg)
+	{
+		// Format: DREI\0 | { id (2) | value count (1) | values (4 * count) } ...
+		Log::FormatLine(LOG_TRACE, "DREI", "Request to set DREF value received (Conn %u)", connection->id);
+		const unsigned char* buffer = msg.GetBuffer();
+		std::size_t size = msg.GetSize();
+		std::size_t pos = 5;
+		while (pos + 3 <= size)
+		{
+			unsigned short id = *((unsigned short*)(buffer + pos));
+			unsigned char valueCount = buffer[pos + 2];
+			pos += 3;
+			if (pos + 4 * valueCount > size)
+			{
+				break;
+			}
+			float values[255];
+			memcpy(values, buffer + pos, 4 * valueCount);
+			pos += 4 * valueCount;
+
+			const ResolvedDref* dref = FindDrefId(*connection, id, "DREI");
+			if (dref)
+			{
+				DataManager::Write(*dref, values, valueCount);
+			}
+		}
+		if (pos != size)
+		{
+			Log::WriteLine(LOG_ERROR, "DREI", "ERROR: Command did not terminate at the expected position.");
+		}
+	}
+
 	void MessageHandlers::HandleGetC(const Message& msg)
 	{
 		const unsigned char* buffer = msg.GetBuffer();
@@ -499,53 +856,203 @@ namespace XPC
 		response[26] = aircraft;
 		*((float*)(response + 27)) = DataManager::GetFloat(DREF_SpeedBrakeSet, aircraft);
 
-		sock->SendTo(response, 31, &connection.addr);
+		outbox.Send(response, 31, connection->addr);
 	}
 
 	void MessageHandlers::HandleGetD(const Message& msg)
 	{
 		const unsigned char* buffer = msg.GetBuffer();
+		if (msg.GetSize() < 6)
+		{
+			Log::FormatLine(LOG_ERROR, "GETD", "ERROR: Unexpected message length: %u", (unsigned)msg.GetSize());
+			return;
+		}
 		unsigned char drefCount = buffer[5];
+		std::vector<GetdPlanEntry>& plan = connection->getdPlan;
 		if (drefCount == 0) // Use last request
 		{
 			Log::FormatLine(LOG_TRACE, "GETD",
-				"DATA Requested: Repeat last request from connection %i (%i data refs)",
-				connection.id, connection.getdCount);
-			if (connection.getdCount == 0) // No previous request to use
+				"DATA Requested: Repeat last request from connection %u (%u data refs)",
+				connection->id, (unsigned)plan.size());
+			if (plan.empty()) // No previous request to use
 			{
-				Log::FormatLine(LOG_ERROR, "GETD", "ERROR: No previous requests from connection %i.",
-					connection.id);
+				Log::FormatLine(LOG_ERROR, "GETD", "ERROR: No previous requests from connection %u.",
+					connection->id);
 				return;
 			}
 		}
 		else // New request
 		{
-			Log::FormatLine(LOG_TRACE, "GETD", "DATA Requested: New Request for connection %i (%i data refs)",
-				connection.id, drefCount);
-			std::size_t ptr = 6;
-			for (int i = 0; i < drefCount; ++i)
+			// Compile the request into a plan. Looking up each dref and
+			// laying out the response happens once here, so repeating the
+			// request only has to read values.
+			Log::FormatLine(LOG_TRACE, "GETD", "DATA Requested: New Request for connection %u (%i data refs)",
+				connection->id, drefCount);
+			connection->getdSize = CompilePlan(buffer + 6, msg.GetSize() - 6, drefCount, plan, "GETD");
+			if (plan.empty())
 			{
-				unsigned char len = buffer[ptr];
-				connection.getdRequest[i] = std::string((char*)buffer + 1 + ptr, len);
-				ptr += 1 + len;
+				return;
 			}
-			connection.getdCount = drefCount;
-			connections[connectionKey] = connection;
 		}
 
-		unsigned char response[4096] = "RESP";
-		response[5] = drefCount;
-		std::size_t cur = 6;
-		for (int i = 0; i < drefCount; ++i)
+		unsigned char* response = outbox.Reserve(connection->getdSize);
+		if (!response)
 		{
-			float values[255];
-			int count = DataManager::Get(connection.getdRequest[i], values, 255);
-			response[cur++] = count;
-			memcpy(response + cur, values, count * sizeof(float));
-			cur += count * sizeof(float);
+			return;
+		}
+		WriteResponse(plan, response);
+		outbox.Commit(connection->getdSize, connection->addr);
+	}
+
+	void MessageHandlers::HandleGetF(const Message& msg)
+	{
+		// Format: GETF\0 | seq (2) | mtu (2) | count (1) | drefs, as for GETD
+		// The response is split into as many RESF messages as needed to keep
+		// each one within mtu bytes:
+		// RESF\0 | seq (2) | index (1) | total (1) | count (1) | runs
+		// Run: dref (1) | dref size (1) | first element (1) | length (1) | values
+		const unsigned char* buffer = msg.GetBuffer();
+		if (msg.GetSize() < FRAGMENT_HEADER_SIZE)
+		{
+			Log::FormatLine(LOG_ERROR, "GETF", "ERROR: Unexpected message length: %u", (unsigned)msg.GetSize());
+			return;
+		}
+		unsigned short seq;
+		unsigned short requestedMtu;
+		memcpy(&seq, buffer + 5, sizeof(seq));
+		memcpy(&requestedMtu, buffer + 7, sizeof(requestedMtu));
+		std::size_t mtu = requestedMtu == 0 ? DEFAULT_MTU : requestedMtu;
+		if (mtu < MIN_MTU)
+		{
+			Log::FormatLine(LOG_ERROR, "GETF", "ERROR: MTU %u is too small. Must be at least %u.",
+				(unsigned)mtu, (unsigned)MIN_MTU);
+			return;
+		}
+		if (mtu > Message::MaxSize)
+		{
+			mtu = Message::MaxSize;
+		}
+
+		unsigned char drefCount = buffer[9];
+		std::vector<GetdPlanEntry>& plan = connection->getfPlan;
+		if (drefCount == 0) // Use last request
+		{
+			if (plan.empty())
+			{
+				Log::FormatLine(LOG_ERROR, "GETF", "ERROR: No previous requests from connection %u.",
+					connection->id);
+				return;
+			}
+		}
+		else
+		{
+			Log::FormatLine(LOG_TRACE, "GETF", "DATA Requested: New Request for connection %u (%i data refs)",
+				connection->id, drefCount);
+			CompilePlan(buffer + 10, msg.GetSize() - 10, drefCount, plan, "GETF", false, FRAGMENTED_RESPONSE_SIZE);
+			if (plan.empty())
+			{
+				return;
+			}
+		}
+
+		int total = WriteFragments(plan, mtu, seq, 0, NULL, connection->addr);
+		if (total > 255)
+		{
+			Log::FormatLine(LOG_ERROR, "GETF", "ERROR: Response needs %i fragments at MTU %u. Use a larger MTU.",
+				total, (unsigned)mtu);
+			return;
+		}
+		WriteFragments(plan, mtu, seq, total, &outbox, connection->addr);
+	}
+
+	void MessageHandlers::HandleGetY(const Message& msg)
+	{
+		// Same request format as GETD. The response is a REST message:
+		// REST\0 | count (1) | { type (1) | count (1) | values } ...
+		const unsigned char* buffer = msg.GetBuffer();
+		if (msg.GetSize() < 6)
+		{
+			Log::FormatLine(LOG_ERROR, "GETY", "ERROR: Unexpected message length: %u", (unsigned)msg.GetSize());
+			return;
+		}
+		unsigned char drefCount = buffer[5];
+		std::vector<GetdPlanEntry>& plan = connection->getyPlan;
+		if (drefCount == 0) // Use last request
+		{
+			Log::FormatLine(LOG_TRACE, "GETY",
+				"DATA Requested: Repeat last request from connection %u (%u data refs)",
+				connection->id, (unsigned)plan.size());
+			if (plan.empty()) // No previous request to use
+			{
+				Log::FormatLine(LOG_ERROR, "GETY", "ERROR: No previous requests from connection %u.",
+					connection->id);
+				return;
+			}
+		}
+		else // New request
+		{
+			Log::FormatLine(LOG_TRACE, "GETY", "DATA Requested: New Request for connection %u (%i data refs)",
+				connection->id, drefCount);
+			connection->getySize = CompilePlan(buffer + 6, msg.GetSize() - 6, drefCount, plan, "GETY", true);
+			if (plan.empty())
+			{
+				return;
+			}
+		}
+
+		unsigned char* response = outbox.Reserve(connection->getySize);
+		if (!response)
+		{
+			return;
+		}
+		WriteTypedResponse(plan, response);
+		outbox.Commit(connection->getySize, connection->addr);
+	}
+
+	void MessageHandlers::HandleGetI(const Message& msg)
+	{
+		// Format: GETI\0 | count (1) | ids (2 * count)
+		const unsigned char* buffer = msg.GetBuffer();
+		unsigned char drefCount = msg.GetSize() > 5 ? buffer[5] : 0;
+		std::vector<GetdPlanEntry>& plan = connection->getdPlan;
+		if (drefCount == 0) // Use last request
+		{
+			if (plan.empty())
+			{
+				Log::FormatLine(LOG_ERROR, "GETI", "ERROR: No previous requests from connection %u.",
+					connection->id);
+				return;
+			}
+		}
+		else
+		{
+			if (6 + 2 * drefCount > msg.GetSize())
+			{
+				Log::FormatLine(LOG_ERROR, "GETI", "ERROR: Message too short for %u ids", drefCount);
+				return;
+			}
+			Log::FormatLine(LOG_TRACE, "GETI", "DATA Requested: New Request for connection %u (%i data refs)",
+				connection->id, drefCount);
+			plan.clear();
+			std::size_t cur = 6;
+			for (int i = 0; i < drefCount; ++i)
+			{
+				unsigned short id = *((unsigned short*)(buffer + 6 + 2 * i));
+				const ResolvedDref* dref = FindDrefId(*connection, id, "GETI");
+				ResolvedDref missing = { NULL, xplmType_Unknown, 0 };
+				cur = AppendToPlan(plan, cur, dref ? *dref : missing, "GETI", false,
+					RESPONSE_SIZE - (drefCount - i - 1));
+			}
+			connection->getdSize = cur;
 		}
 
-		sock->SendTo(response, cur, &connection.addr);
+		unsigned char* response = outbox.Reserve(connection->getdSize);
+		if (!response)
+		{
+			return;
+		}
+		WriteResponse(plan, response);
+		outbox.Commit(connection->getdSize, connection->addr);
 	}
 
 	void MessageHandlers::HandleGetP(const Message& msg)
@@ -573,27 +1080,199 @@ namespace XPC
 		DataManager::GetFloatArray(DREF_GearDeploy, gear, 10, aircraft);
 		*((float*)(response + 42)) = gear[0];
 
-		sock->SendTo(response, 46, &connection.addr);
+		outbox.Send(response, 46, connection->addr);
 	}
 
-	void MessageHandlers::HandlePosi(const Message& msg)
+	void MessageHandlers::HandleGetS(const Message& msg)
 	{
-		// Update log
-		Log::FormatLine(LOG_TRACE, "POSI", "Message Received (Conn %i)", connection.id);
-
+		// Format: GETS\0 | count (1) | aircraft (count)
+		// A count of 0 requests every aircraft. The response holds one array
+		// per field, so clients can load each field for several aircraft at
+		// once. Every array has the same length n, count rounded up to a
+		// multiple of 4, and starts at a multiple of 8 bytes:
+		// ACST\0 | count (1) | reserved (2) | aircraft (n, padded to 8 bytes)
+		// | lat, lon, h (f64[n] each)
+		// | pitch, roll, heading, vx, vy, vz, gear (f32[n] each)
+		const int MAX_AIRCRAFT = 20;
 		const unsigned char* buffer = msg.GetBuffer();
-		const std::size_t size = msg.GetSize();
-
-		char aircraftNumber = buffer[5];
-		float gear;
-		double posd[3];
-		float orient[3];
+		std::size_t size = msg.GetSize();
+		unsigned char requested = size > 5 ? buffer[5] : 0;
+		if (size != 6u + requested)
+		{
+			Log::FormatLine(LOG_ERROR, "GETS", "ERROR: Unexpected message length: %u", (unsigned)size);
+			return;
+		}
 
-		if (size == 34) /* lat/lon/h as 32-bit float */
+		unsigned char aircraft[MAX_AIRCRAFT];
+		int count = 0;
+		if (requested == 0)
 		{
-			float posd_32[3];
-			memcpy(posd_32, buffer + 6, 12);
-		/* convert float to double */
+			for (count = 0; count < MAX_AIRCRAFT; ++count)
+			{
+				aircraft[count] = (unsigned char)count;
+			}
+		}
+		else
+		{
+			for (int i = 0; i < requested; ++i)
+			{
+				if (buffer[6 + i] >= MAX_AIRCRAFT || count == MAX_AIRCRAFT)
+				{
+					Log::FormatLine(LOG_ERROR, "GETS", "ERROR: Invalid aircraft number %u", buffer[6 + i]);
+					continue;
+				}
+				aircraft[count++] = buffer[6 + i];
+			}
+		}
+		Log::FormatLine(LOG_TRACE, "GETS", "Getting state of %i aircraft (Conn %u)", count, connection->id);
+
+		const int n = (count + 3) & ~3;
+		const std::size_t idsSize = (n + 7) & ~7;
+		const std::size_t len = 8 + idsSize + 3 * n * sizeof(double) + 7 * n * sizeof(float);
+		unsigned char* response = outbox.Reserve(len);
+		if (!response)
+		{
+			return;
+		}
+		memset(response, 0, len);
+		memcpy(response, "ACST", 5);
+		response[5] = (unsigned char)count;
+		memcpy(response + 8, aircraft, count);
+
+		// The outbox keeps responses 8 byte aligned, so the arrays can be
+		// written directly.
+		double* lat = (double*)(response + 8 + idsSize);
+		double* lon = lat + n;
+		double* h = lon + n;
+		float* pitch = (float*)(h + n);
+		float* roll = pitch + n;
+		float* heading = roll + n;
+		float* vx = heading + n;
+		float* vy = vx + n;
+		float* vz = vy + n;
+		float* gear = vz + n;
+		for (int i = 0; i < count; ++i)
+		{
+			char ac = (char)aircraft[i];
+			lat[i] = DataManager::GetDouble(DREF_Latitude, ac);
+			lon[i] = DataManager::GetDouble(DREF_Longitude, ac);
+			h[i] = DataManager::GetDouble(DREF_Elevation, ac);
+			pitch[i] = DataManager::GetFloat(DREF_Pitch, ac);
+			roll[i] = DataManager::GetFloat(DREF_Roll, ac);
+			heading[i] = DataManager::GetFloat(DREF_HeadingTrue, ac);
+			vx[i] = DataManager::GetFloat(DREF_LocalVX, ac);
+			vy[i] = DataManager::GetFloat(DREF_LocalVY, ac);
+			vz[i] = DataManager::GetFloat(DREF_LocalVZ, ac);
+			float deploy[10];
+			gear[i] = DataManager::GetFloatArray(DREF_GearDeploy, deploy, 10, ac) > 0 ? deploy[0] : 0.0F;
+		}
+		outbox.Commit(len, connection->addr);
+	}
+
+	// Moves an aircraft as requested by a POSI or BPOS message. Values equal
+	// to the default value, or a negative gear value, are left unchanged.
+	static void ApplyPosition(char aircraftNumber, double pos[3], float orient[3], float gear)
+	{
+		// An explicit position overrides any smoothing or playback in progress.
+		Interpolator::Stop((unsigned char)aircraftNumber);
+		Playback::Stop((unsigned char)aircraftNumber);
+		DataManager::SetPosition(pos, aircraftNumber);
+		DataManager::SetOrientation(orient, aircraftNumber);
+		if (gear >= 0)
+		{
+			DataManager::SetGear(gear, true, aircraftNumber);
+		}
+	}
+
+	static const int AI_COUNT = 20;
+
+	// Hands the specified multiplayer aircraft over to the plugin, so that
+	// X-Plane's AI doesn't fly them.
+	static void EnableAI(const bool aircraft[AI_COUNT])
+	{
+		// override_plane_ai_autopilot is an int array.
+		int ai[AI_COUNT];
+		if (DataManager::GetIntArray(DREF_PauseAI, ai, AI_COUNT) == AI_COUNT)
+		{
+			for (int i = 1; i < AI_COUNT; ++i)
+			{
+				if (aircraft[i])
+				{
+					ai[i] = 1;
+				}
+			}
+			DataManager::Set(DREF_PauseAI, ai, AI_COUNT, 0);
+		}
+	}
+
+	void MessageHandlers::HandlePlay(const Message& msg)
+	{
+		// Format: PLAY\0 | aircraft (1) | command (1) | value (f64)
+		// Commands: 0 stop, 1 start at time value, 2 pause, 3 resume,
+		//           4 seek to time value, 5 set rate to value
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+		if (size != 15)
+		{
+			Log::FormatLine(LOG_ERROR, "PLAY", "ERROR: Unexpected size: %u (Expected 15)", (unsigned)size);
+			return;
+		}
+
+		unsigned char aircraftNumber = buffer[5];
+		unsigned char command = buffer[6];
+		double value;
+		memcpy(&value, buffer + 7, 8);
+		Log::FormatLine(LOG_TRACE, "PLAY", "Command %u (%f) for a/c %u (Conn %u)",
+			command, value, aircraftNumber, connection->id);
+
+		switch (command)
+		{
+		case 0:
+			Playback::Stop(aircraftNumber);
+			break;
+		case 1:
+			Interpolator::Stop(aircraftNumber);
+			if (Playback::Start(aircraftNumber, value) && aircraftNumber > 0 && aircraftNumber < AI_COUNT)
+			{
+				bool enableAI[AI_COUNT] = { false };
+				enableAI[aircraftNumber] = true;
+				EnableAI(enableAI);
+			}
+			break;
+		case 2:
+		case 3:
+			Playback::SetPaused(aircraftNumber, command == 2);
+			break;
+		case 4:
+			Playback::Seek(aircraftNumber, value);
+			break;
+		case 5:
+			Playback::SetRate(aircraftNumber, value);
+			break;
+		default:
+			Log::FormatLine(LOG_ERROR, "PLAY", "ERROR: Unknown command %u", command);
+			break;
+		}
+	}
+
+	void MessageHandlers::HandlePosi(const Message& msg)
+	{
+		// Update log
+		Log::FormatLine(LOG_TRACE, "POSI", "Message Received (Conn %u)", connection->id);
+
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+
+		char aircraftNumber = buffer[5];
+		float gear;
+		double posd[3];
+		float orient[3];
+
+		if (size == 34) /* lat/lon/h as 32-bit float */
+		{
+			float posd_32[3];
+			memcpy(posd_32, buffer + 6, 12);
+		/* convert float to double */
 			posd[0] = posd_32[0];
 			posd[1] = posd_32[1];
 			posd[2] = posd_32[2];
@@ -612,12 +1291,7 @@ namespace XPC
 			return;
 		}
 
-		DataManager::SetPosition(posd, aircraftNumber);
-		DataManager::SetOrientation(orient, aircraftNumber);
-		if (gear >= 0)
-		{
-			DataManager::SetGear(gear, true, aircraftNumber);
-		}
+		ApplyPosition(aircraftNumber, posd, orient, gear);
 
 		if (aircraftNumber > 0)
 		{
@@ -632,6 +1306,125 @@ namespace XPC
 		}
 	}
 
+	void MessageHandlers::HandleBpos(const Message& msg)
+	{
+		// Format: BPOS\0 | count (1) | flags (1) | records
+		// Record: aircraft (1) | lat, lon, h (f64) | pitch, roll, heading (f32) | gear (f32)
+		//         [ | pitch, roll, yaw, throttle (f32) | gear (i8) | flaps, speedbrake (f32) ]
+		// The control values are only present if bit 0 of flags is set. As for
+		// POSI and CTRL, default values leave the corresponding value unchanged.
+		const std::size_t POSITION_SIZE = 41;
+		const std::size_t CONTROLS_SIZE = 25;
+		const unsigned char FLAG_CONTROLS = 0x01;
+
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+		if (size < 7)
+		{
+			Log::FormatLine(LOG_ERROR, "BPOS", "ERROR: Unexpected message length: %u", (unsigned)size);
+			return;
+		}
+		unsigned char count = buffer[5];
+		bool controls = (buffer[6] & FLAG_CONTROLS) != 0;
+		std::size_t recordSize = POSITION_SIZE + (controls ? CONTROLS_SIZE : 0);
+		if (size != 7 + count * recordSize)
+		{
+			Log::FormatLine(LOG_ERROR, "BPOS", "ERROR: Unexpected message length: %u (Expected %u for %u aircraft)",
+				(unsigned)size, (unsigned)(7 + count * recordSize), count);
+			return;
+		}
+		Log::FormatLine(LOG_TRACE, "BPOS", "Message Received (Conn %u, %u aircraft)", connection->id, count);
+
+		// AI is enabled for every multiplayer aircraft that is moved, but the
+		// flags are only read and written once for the whole message.
+		bool enableAI[AI_COUNT] = { false };
+		bool anyAI = false;
+		const unsigned char* cur = buffer + 7;
+		for (int i = 0; i < count; ++i, cur += recordSize)
+		{
+			unsigned char aircraftNumber = cur[0];
+			if (aircraftNumber >= AI_COUNT)
+			{
+				Log::FormatLine(LOG_ERROR, "BPOS", "ERROR: Invalid aircraft number %u", aircraftNumber);
+				continue;
+			}
+
+			double posd[3];
+			float orient[3];
+			float gear;
+			memcpy(posd, cur + 1, 24);
+			memcpy(orient, cur + 25, 12);
+			memcpy(&gear, cur + 37, 4);
+			ApplyPosition((char)aircraftNumber, posd, orient, gear);
+
+			if (controls)
+			{
+				const unsigned char* ctrl = cur + POSITION_SIZE;
+				float values[4];
+				float flaps;
+				float spdbrk;
+				memcpy(values, ctrl, 16);
+				memcpy(&flaps, ctrl + 17, 4);
+				memcpy(&spdbrk, ctrl + 21, 4);
+				DataManager::SetControls(aircraftNumber, values[0], values[1], values[2], values[3],
+					(char)ctrl[16], flaps, spdbrk);
+			}
+
+			if (aircraftNumber > 0)
+			{
+				enableAI[aircraftNumber] = true;
+				anyAI = true;
+			}
+		}
+
+		if (anyAI)
+		{
+			EnableAI(enableAI);
+		}
+	}
+
+	void MessageHandlers::HandleTpos(const Message& msg)
+	{
+		// Format: TPOS\0 | aircraft (1) | delay (u16, ms) | time (f64, s)
+		//         | lat, lon, h (f64) | pitch, roll, heading (f32) | gear (f32)
+		// Instead of moving the aircraft immediately, the state is added to
+		// the aircraft's track and the aircraft is moved smoothly along it
+		// every frame. See Interpolator.
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+		if (size != 56)
+		{
+			Log::FormatLine(LOG_ERROR, "TPOS", "ERROR: Unexpected size: %u (Expected 56)", (unsigned)size);
+			return;
+		}
+
+		unsigned char aircraftNumber = buffer[5];
+		unsigned short delayMs;
+		double time;
+		double pos[3];
+		float orient[3];
+		float gear;
+		memcpy(&delayMs, buffer + 6, 2);
+		memcpy(&time, buffer + 8, 8);
+		memcpy(pos, buffer + 16, 24);
+		memcpy(orient, buffer + 40, 12);
+		memcpy(&gear, buffer + 52, 4);
+		Log::FormatLine(LOG_TRACE, "TPOS", "State at %f for a/c %u (Conn %u)", time, aircraftNumber, connection->id);
+
+		Playback::Stop(aircraftNumber);
+		bool started = Interpolator::AddState(aircraftNumber, time, pos, orient, delayMs / 1000.0, msg.GetReceived());
+		if (gear >= 0 && aircraftNumber < AI_COUNT)
+		{
+			DataManager::SetGear(gear, true, (char)aircraftNumber);
+		}
+		if (started && aircraftNumber > 0)
+		{
+			bool enableAI[AI_COUNT] = { false };
+			enableAI[aircraftNumber] = true;
+			EnableAI(enableAI);
+		}
+	}
+
 	void MessageHandlers::HandlePosT(const Message& msg)
 	{
 		MessageHandlers::HandlePosi(msg);
@@ -673,7 +1466,14 @@ namespace XPC
 		MessageHandlers::SendTerr(pos, aircraft);
 	}
 
-	void MessageHandlers::SendTerr(double pos[3], char aircraft)
+	// The size of the terrain information for one point in TERR and TERS
+	// messages.
+	static const std::size_t TERRAIN_SIZE = 56;
+
+	// Probes the terrain below a point and writes TERRAIN_SIZE bytes of
+	// terrain information to out. Returns false if the probe itself failed,
+	// in which case it is recreated for the next query.
+	static bool ProbeTerrain(const double pos[3], unsigned char* out)
 	{
 		double lat, lon, alt, X, Y, Z;
 		
@@ -683,7 +1483,7 @@ namespace XPC
 		
 		if(Terrain_probe == nullptr)
 		{
-			Log::FormatLine(LOG_TRACE, "TERR", "Create terrain probe for aircraft %u", aircraft);
+			Log::WriteLine(LOG_TRACE, "TERR", "Create terrain probe");
 			Terrain_probe = XPLMCreateProbe(0);
 		}
 		
@@ -698,26 +1498,28 @@ namespace XPC
 		// query probe
 		// Step 2. Probe XYZ to get a new Y
 		int rc = XPLMProbeTerrainXYZ(Terrain_probe, X, Y, Z, &probe_data);
-		if(rc > 0)
+		bool probed = rc <= 0;
+		if(!probed)
 		{
 			Log::FormatLine(LOG_ERROR, "TERR", "Probe failed. Return Value %u", rc);
 			XPLMDestroyProbe(Terrain_probe);
 			Terrain_probe = nullptr;
-			return;
 		}
-		
-		// transform probe location to world coordinates
-		// Step 3. Convert that new XYZ back to LLE
-		XPLMLocalToWorld(probe_data.locationX, probe_data.locationY, probe_data.locationZ, &lat, &lon, &alt);
-		Log::FormatLine(LOG_TRACE, "TERR", "Conv LLA=%f, %f, %f", lat, lon, alt);
+		else
+		{
+			// transform probe location to world coordinates
+			// Step 3. Convert that new XYZ back to LLE
+			XPLMLocalToWorld(probe_data.locationX, probe_data.locationY, probe_data.locationZ, &lat, &lon, &alt);
+			Log::FormatLine(LOG_TRACE, "TERR", "Conv LLA=%f, %f, %f", lat, lon, alt);
 
-		// transform probe location to local coordinates
-		// Step 4. NOW convert your original lat/lon with the elevation from step 3 to XYZ
-		XPLMWorldToLocal(pos[0], pos[1], alt, &X, &Y, &Z);
+			// transform probe location to local coordinates
+			// Step 4. NOW convert your original lat/lon with the elevation from step 3 to XYZ
+			XPLMWorldToLocal(pos[0], pos[1], alt, &X, &Y, &Z);
 
-		// query probe
-		// Step 5. Re-probe with the NEW XYZ
-		rc = XPLMProbeTerrainXYZ(Terrain_probe, X, Y, Z, &probe_data);
+			// query probe
+			// Step 5. Re-probe with the NEW XYZ
+			rc = XPLMProbeTerrainXYZ(Terrain_probe, X, Y, Z, &probe_data);
+		}
 		if(rc == 0)
 		{
 		// transform probe location to world coordinates
@@ -731,6 +1533,10 @@ namespace XPC
 			lat = -998;
 			lon = -998;
 			alt = -998;
+			// Don't report what the probe found for an earlier point.
+			probe_data.normalX = probe_data.normalY = probe_data.normalZ = 0.0F;
+			probe_data.velocityX = probe_data.velocityY = probe_data.velocityZ = 0.0F;
+			probe_data.is_wet = 0;
 			
 			Log::FormatLine(LOG_TRACE, "TERR", "Probe failed. Return Value %u", rc);
 		}
@@ -738,33 +1544,383 @@ namespace XPC
 		// keep probe for next query
 		// XPLMDestroyProbe(Terrain_probe);
 		
-		// Assemble response message
-		unsigned char response[62] = "TERR";
-		response[5] = aircraft;
 		// terrain height over msl at lat/lon point
-		memcpy(response + 6,  &lat, 8);
-		memcpy(response + 14, &lon, 8);
-		memcpy(response + 22, &alt, 8);
+		memcpy(out,      &lat, 8);
+		memcpy(out + 8,  &lon, 8);
+		memcpy(out + 16, &alt, 8);
 		// terrain normal vector
-		memcpy(response + 30, &probe_data.normalX, 4);
-		memcpy(response + 34, &probe_data.normalY, 4);
-		memcpy(response + 38, &probe_data.normalZ, 4);
+		memcpy(out + 24, &probe_data.normalX, 4);
+		memcpy(out + 28, &probe_data.normalY, 4);
+		memcpy(out + 32, &probe_data.normalZ, 4);
 		// terrain velocity
-		memcpy(response + 42, &probe_data.velocityX, 4);
-		memcpy(response + 46, &probe_data.velocityY, 4);
-		memcpy(response + 50, &probe_data.velocityZ, 4);
+		memcpy(out + 36, &probe_data.velocityX, 4);
+		memcpy(out + 40, &probe_data.velocityY, 4);
+		memcpy(out + 44, &probe_data.velocityZ, 4);
 		// terrain type
-		memcpy(response + 54, &probe_data.is_wet, 4);
+		memcpy(out + 48, &probe_data.is_wet, 4);
 		// probe status
-		memcpy(response + 58, &rc, 4);
+		memcpy(out + 52, &rc, 4);
+		return probed;
+	}
+
+	void MessageHandlers::SendTerr(double pos[3], char aircraft)
+	{
+		Log::FormatLine(LOG_TRACE, "TERR", "Probing terrain for aircraft %u", aircraft);
+
+		// Assemble response message
+		unsigned char response[62] = "TERR";
+		response[5] = aircraft;
+		if (!ProbeTerrain(pos, response + 6))
+		{
+			return;
+		}
+		outbox.Send(response, 62, connection->addr);
+	}
+
+	void MessageHandlers::HandleGetTs(const Message& msg)
+	{
+		// Format: GTRS\0 | seq (2) | mtu (2) | count (u16) | points: lat, lon, alt (f64 each)
+		// The response is split into as many TERS messages as needed to keep
+		// each one within mtu bytes. Each point has the same layout as the body
+		// of a TERR message:
+		// TERS\0 | seq (2) | index (u16) | total (u16) | first point (u16)
+		//        | points (u16) | reserved (1)
+		//        | points: lat, lon, alt (f64 each) | normal x, y, z (f32 each)
+		//        | velocity x, y, z (f32 each) | wet (i32) | probe result (i32)
+		const std::size_t HEADER_SIZE = 16;
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+		unsigned short seq = 0;
+		unsigned short requestedMtu = 0;
+		unsigned short count = 0;
+		if (size >= 11)
+		{
+			memcpy(&seq, buffer + 5, 2);
+			memcpy(&requestedMtu, buffer + 7, 2);
+			memcpy(&count, buffer + 9, 2);
+		}
+		if (size < 11 || size != 11u + count * 3 * sizeof(double))
+		{
+			Log::FormatLine(LOG_ERROR, "GTRS", "ERROR: Unexpected message length: %u", (unsigned)size);
+			return;
+		}
+		std::size_t mtu = requestedMtu == 0 ? DEFAULT_MTU : requestedMtu;
+		mtu = mtu > Message::MaxSize ? Message::MaxSize : mtu;
+		if (mtu < HEADER_SIZE + TERRAIN_SIZE)
+		{
+			Log::FormatLine(LOG_ERROR, "GTRS", "ERROR: MTU %u is too small", (unsigned)mtu);
+			return;
+		}
+		std::size_t perFragment = (mtu - HEADER_SIZE) / TERRAIN_SIZE;
+		std::size_t total = count == 0 ? 1 : (count + perFragment - 1) / perFragment;
+		Log::FormatLine(LOG_TRACE, "GTRS", "Probing terrain at %u points (Conn %u)", count, connection->id);
 
-		sock->SendTo(response, 62, &connection.addr);
+		// Every point shares the one probe, so a batch costs no more setup
+		// than a single GETT.
+		for (std::size_t index = 0; index < total; ++index)
+		{
+			std::size_t start = index * perFragment;
+			std::size_t n = count - start < perFragment ? count - start : perFragment;
+			std::size_t len = HEADER_SIZE + n * TERRAIN_SIZE;
+			unsigned char* response = outbox.Reserve(len);
+			if (!response)
+			{
+				return;
+			}
+			std::uint16_t header[4] = { (std::uint16_t)index, (std::uint16_t)total, (std::uint16_t)start, (std::uint16_t)n };
+			memcpy(response, "TERS", 5);
+			memcpy(response + 5, &seq, 2);
+			memcpy(response + 7, header, sizeof(header));
+			response[15] = 0;
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				double pos[3];
+				memcpy(pos, buffer + 11 + (start + i) * sizeof(pos), sizeof(pos));
+				ProbeTerrain(pos, response + HEADER_SIZE + i * TERRAIN_SIZE);
+			}
+			outbox.Commit(len, connection->addr);
+		}
+	}
+
+	void MessageHandlers::HandleHist(const Message& msg)
+	{
+		// Format: HIST\0 | op (1) | ...
+		// Ops: 1 configure: seconds (f32) | count (1) | drefs
+		//      2 query: seq (2) | mtu (2) | flags (1) | from (f64) | to (f64)
+		//               | offset (u32, optional)
+		//        Flags: 1 from and to are relative to the newest row
+		// The response to a query holds at most HIST_PAGE_FRAGMENTS HISR
+		// messages of up to mtu bytes, starting offset rows into the window.
+		// Clients page through larger windows by repeating the query with the
+		// absolute from and to from the response:
+		// HISR\0 | seq (2) | index (u16) | total (u16) | width (u16) | rows (u16)
+		//        | flags (1) | first row (u32) | total rows (u32)
+		//        | from (f64) | to (f64) | rows: time (f64) | values (width * f32)
+		//   Flags: 1 a row doesn't fit in mtu bytes, so no rows were sent
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+		unsigned char op = size > 5 ? buffer[5] : 0;
+		if (op == 1)
+		{
+			if (size < 11)
+			{
+				Log::WriteLine(LOG_ERROR, "HIST", "ERROR: Configure message too short");
+				return;
+			}
+			float seconds;
+			memcpy(&seconds, buffer + 6, 4);
+			unsigned char count = buffer[10];
+			std::string drefs[255];
+			std::size_t cur = 11;
+			for (int i = 0; i < count; ++i)
+			{
+				if (cur >= size || cur + 1 + buffer[cur] > size)
+				{
+					Log::WriteLine(LOG_ERROR, "HIST", "ERROR: Dataref names are truncated");
+					return;
+				}
+				drefs[i] = std::string((const char*)buffer + cur + 1, buffer[cur]);
+				cur += 1 + buffer[cur];
+			}
+			History::Configure(seconds, drefs, count);
+			return;
+		}
+		if (op != 2 || (size != 27 && size != 31))
+		{
+			Log::FormatLine(LOG_ERROR, "HIST", "ERROR: Unexpected op %u or length %u", op, (unsigned)size);
+			return;
+		}
+
+		unsigned short seq;
+		unsigned short requestedMtu;
+		double from;
+		double to;
+		memcpy(&seq, buffer + 6, 2);
+		memcpy(&requestedMtu, buffer + 8, 2);
+		memcpy(&from, buffer + 11, 8);
+		memcpy(&to, buffer + 19, 8);
+		std::uint32_t offset = 0;
+		if (size == 31)
+		{
+			memcpy(&offset, buffer + 27, 4);
+		}
+		if (buffer[10] & 1)
+		{
+			double newest = History::GetNewestTime();
+			from += newest;
+			to += newest;
+		}
+		std::size_t mtu = requestedMtu == 0 ? DEFAULT_MTU : requestedMtu;
+		mtu = mtu > Message::MaxSize ? Message::MaxSize : mtu;
+
+		const std::size_t HEADER_SIZE = 40;
+		std::size_t width = (std::size_t)History::GetWidth();
+		std::size_t rowSize = sizeof(double) + width * sizeof(float);
+		std::size_t perFragment = mtu > HEADER_SIZE ? (mtu - HEADER_SIZE) / rowSize : 0;
+		perFragment = perFragment > 0xFFFF ? 0xFFFF : perFragment;
+		if (perFragment == 0)
+		{
+			// Tell the client rather than leave it waiting.
+			Log::FormatLine(LOG_ERROR, "HIST", "ERROR: MTU %u is too small for rows of %u values",
+				(unsigned)mtu, (unsigned)width);
+			unsigned char response[HEADER_SIZE] = "HISR";
+			std::uint16_t header[4] = { 0, 1, (std::uint16_t)width, 0 };
+			memcpy(response + 5, &seq, 2);
+			memcpy(response + 7, header, sizeof(header));
+			response[15] = 1;
+			memcpy(response + 24, &from, sizeof(double));
+			memcpy(response + 32, &to, sizeof(double));
+			outbox.Send(response, HEADER_SIZE, connection->addr);
+			return;
+		}
+		std::uint64_t first;
+		std::size_t windowRows = History::Find(from, to, first);
+		std::size_t rows = offset < windowRows ? windowRows - offset : 0;
+		if (rows > perFragment * HIST_PAGE_FRAGMENTS)
+		{
+			rows = perFragment * HIST_PAGE_FRAGMENTS;
+		}
+		std::size_t total = rows == 0 ? 1 : (rows + perFragment - 1) / perFragment;
+		Log::FormatLine(LOG_TRACE, "HIST", "Sending %u of %u rows in %u fragments (Conn %u)",
+			(unsigned)rows, (unsigned)windowRows, (unsigned)total, connection->id);
+
+		std::uint32_t totalRows = (std::uint32_t)windowRows;
+		for (std::size_t index = 0; index < total; ++index)
+		{
+			std::size_t start = offset + index * perFragment;
+			std::size_t n = offset + rows - start < perFragment ? offset + rows - start : perFragment;
+			unsigned char* response = outbox.Reserve(HEADER_SIZE + n * rowSize);
+			if (!response)
+			{
+				return;
+			}
+			std::uint16_t header[4] = { (std::uint16_t)index, (std::uint16_t)total, (std::uint16_t)width, (std::uint16_t)n };
+			std::uint32_t firstRow = (std::uint32_t)start;
+			memcpy(response, "HISR", 5);
+			memcpy(response + 5, &seq, 2);
+			memcpy(response + 7, header, sizeof(header));
+			response[15] = 0;
+			memcpy(response + 16, &firstRow, 4);
+			memcpy(response + 20, &totalRows, 4);
+			memcpy(response + 24, &from, sizeof(double));
+			memcpy(response + 32, &to, sizeof(double));
+			unsigned char* cur = response + HEADER_SIZE;
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				const float* values;
+				double time = History::GetRow(first + start + i, &values);
+				memcpy(cur, &time, sizeof(double));
+				memcpy(cur + sizeof(double), values, width * sizeof(float));
+				cur += rowSize;
+			}
+			outbox.Commit(HEADER_SIZE + n * rowSize, connection->addr);
+		}
+	}
+
+	void MessageHandlers::HandleLogl(const Message& msg)
+	{
+		// Format: LOGL\0 | level (1)
+		if (msg.GetSize() < 6)
+		{
+			Log::FormatLine(LOG_ERROR, "LOGL", "ERROR: Unexpected size: %i (Conn %u)", msg.GetSize(), connection->id);
+			return;
+		}
+
+		int level = msg.GetBuffer()[5];
+		if (level > LOG_LEVEL)
+		{
+			Log::FormatLine(LOG_WARN, "LOGL", "WARN: Level %i requested, but the plugin was built with level %i.",
+				level, LOG_LEVEL);
+		}
+		Log::SetLevel(level);
+		Log::FormatLine(LOG_INFO, "LOGL", "Log level set to %i (Conn %u)", Log::GetLevel(), connection->id);
+	}
+
+	void MessageHandlers::HandleRecd(const Message& msg)
+	{
+		// Format: RECD\0 | op (1) | ...
+		// Ops: 1 start: divisor (u16) | count (1) | path length (1) | path | drefs
+		//      2 stop
+		//      3 status
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+		if (size < 6)
+		{
+			Log::WriteLine(LOG_ERROR, "RECD", "ERROR: Message too short");
+			return;
+		}
+		unsigned char op = buffer[5];
+		Log::FormatLine(LOG_TRACE, "RECD", "Op %u (Conn %u)", op, connection->id);
+
+		switch (op)
+		{
+		case 1:
+		{
+			if (size < 10 || size < 10u + buffer[9])
+			{
+				Log::WriteLine(LOG_ERROR, "RECD", "ERROR: Start message too short");
+				return;
+			}
+			std::uint16_t divisor;
+			memcpy(&divisor, buffer + 6, 2);
+			unsigned char count = buffer[8];
+			std::string path((const char*)buffer + 10, buffer[9]);
+			std::string drefs[255];
+			std::size_t cur = 10 + buffer[9];
+			for (int i = 0; i < count; ++i)
+			{
+				if (cur >= size || cur + 1 + buffer[cur] > size)
+				{
+					Log::WriteLine(LOG_ERROR, "RECD", "ERROR: Dataref names are truncated");
+					return;
+				}
+				drefs[i] = std::string((const char*)buffer + cur + 1, buffer[cur]);
+				cur += 1 + buffer[cur];
+			}
+			Recorder::Start(path, drefs, count, divisor);
+			break;
+		}
+		case 2:
+			Recorder::Stop();
+			break;
+		case 3:
+		{
+			// Format: RECS\0 | state (1) | reserved (2) | samples (u64) | written (u64) | dropped (u64)
+			std::uint64_t counts[3];
+			RecorderState state = Recorder::GetStatus(counts[0], counts[1], counts[2]);
+			unsigned char response[32] = "RECS";
+			response[5] = (unsigned char)state;
+			memcpy(response + 8, counts, sizeof(counts));
+			outbox.Send(response, 32, connection->addr);
+			break;
+		}
+		default:
+			Log::FormatLine(LOG_ERROR, "RECD", "ERROR: Unknown op %u", op);
+			break;
+		}
+	}
+
+	void MessageHandlers::HandleRslv(const Message& msg)
+	{
+		// Format: RSLV\0 | count (1) | drefs
+		// Response: DRID\0 | count (1) | { id (2) | element count (1) } ...
+		const unsigned char* buffer = msg.GetBuffer();
+		std::size_t size = msg.GetSize();
+		unsigned char drefCount = size > 5 ? buffer[5] : 0;
+		Log::FormatLine(LOG_TRACE, "RSLV", "Resolve %i data refs (Conn %u)", drefCount, connection->id);
+
+		std::vector<ResolvedDref>& ids = connection->drefIds;
+		unsigned char response[6 + 3 * 255];
+		memcpy(response, "DRID", 5);
+		response[5] = drefCount;
+		std::size_t ptr = 6;
+		std::size_t cur = 6;
+		for (int i = 0; i < drefCount; ++i)
+		{
+			unsigned short id = INVALID_DREF_ID;
+			ResolvedDref dref = { NULL, xplmType_Unknown, 0 };
+			if (ptr < size && ptr + 1 + buffer[ptr] <= size)
+			{
+				dref = DataManager::Resolve(std::string((char*)buffer + ptr + 1, buffer[ptr]));
+				ptr += 1 + buffer[ptr];
+			}
+			else
+			{
+				Log::FormatLine(LOG_ERROR, "RSLV", "ERROR: Message too short for %u drefs", drefCount);
+				ptr = size;
+			}
+
+			if (dref.xdref)
+			{
+				// Hand out the same id if the client resolves a dref twice.
+				for (std::size_t j = 0; j < ids.size(); ++j)
+				{
+					if (ids[j].xdref == dref.xdref)
+					{
+						id = (unsigned short)j;
+						ids[j] = dref;
+						break;
+					}
+				}
+				if (id == INVALID_DREF_ID && ids.size() < INVALID_DREF_ID)
+				{
+					id = (unsigned short)ids.size();
+					ids.push_back(dref);
+				}
+			}
+
+			memcpy(response + cur, &id, sizeof(id));
+			response[cur + 2] = (unsigned char)(dref.count > 255 ? 255 : dref.count);
+			cur += 3;
+		}
+
+		outbox.Send(response, cur, connection->addr);
 	}
 
 	void MessageHandlers::HandleSimu(const Message& msg)
 	{
 		// Update log
-		Log::FormatLine(LOG_TRACE, "SIMU", "Message Received (Conn %i)", connection.id);
+		Log::FormatLine(LOG_TRACE, "SIMU", "Message Received (Conn %u)", connection->id);
 
 		unsigned char v = msg.GetBuffer()[5];
 		if (v < 0 || (v > 2 && v < 100) || (v > 119 && v < 200) || v > 219)
@@ -826,10 +1982,241 @@ namespace XPC
 
 	}
 
+	void MessageHandlers::HandleStat(const Message& msg)
+	{
+		// Format: STAT\0 | kind (1) | flags (1)
+		// Kind 0 or 1 requests handler latencies. Bit 0 of flags resets them
+		// after they are sent. Kind 2 requests the health counters, which are
+		// never reset. Both bytes are optional.
+		// Response (kind 0/1): STAR\0 | 1 | count (1) | entries (see Statistics::WriteSummary)
+		// Response (kind 2):   STAR\0 | 2 | count (1) | values (u64) ...
+		//     The values are the counters in the order of the Counter enum,
+		//     followed by the number of live connections and the number of
+		//     log lines dropped.
+		const unsigned char* buffer = msg.GetBuffer();
+		std::size_t size = msg.GetSize();
+		unsigned char kind = size > 5 ? buffer[5] : 0;
+		unsigned char flags = size > 6 ? buffer[6] : 0;
+		Log::FormatLine(LOG_TRACE, "STAT", "Statistics requested. Kind %u, flags %u (Conn %u)",
+			kind, flags, connection->id);
+
+		unsigned char response[RESPONSE_SIZE] = "STAR";
+		std::size_t len;
+		if (kind == 0 || kind == 1)
+		{
+			response[5] = 1;
+			len = 7 + Statistics::WriteSummary(response + 7, RESPONSE_SIZE - 7, response[6]);
+		}
+		else if (kind == 2)
+		{
+			std::uint64_t values[COUNTER_Count + 2];
+			for (int i = 0; i < COUNTER_Count; ++i)
+			{
+				values[i] = Statistics::Get((Counter)i);
+			}
+			values[COUNTER_Count] = connections.Size();
+			values[COUNTER_Count + 1] = Log::GetDropped();
+
+			response[5] = 2;
+			response[6] = (unsigned char)(COUNTER_Count + 2);
+			memcpy(response + 7, values, sizeof(values));
+			len = 7 + sizeof(values);
+		}
+		else
+		{
+			Log::FormatLine(LOG_ERROR, "STAT", "ERROR: Unknown statistics kind %u", kind);
+			return;
+		}
+
+		outbox.Send(response, len, connection->addr);
+		if (kind != 2 && (flags & 1))
+		{
+			Statistics::Reset();
+		}
+	}
+
+	void MessageHandlers::HandleSubs(const Message& msg)
+	{
+		// Format: SUBS\0 | divisor (2) | port (2) | count (1) | drefs
+		const unsigned char* buffer = msg.GetBuffer();
+		if (msg.GetSize() < 10)
+		{
+			Log::FormatLine(LOG_ERROR, "SUBS", "ERROR: Message too short (%u bytes)", (unsigned)msg.GetSize());
+			return;
+		}
+		unsigned short divisor;
+		unsigned short port;
+		memcpy(&divisor, buffer + 5, sizeof(divisor));
+		memcpy(&port, buffer + 7, sizeof(port));
+		unsigned char drefCount = buffer[9];
+		Subscription& subs = connection->subs;
+
+		if (divisor == 0) // Unsubscribe
+		{
+			Log::FormatLine(LOG_TRACE, "SUBS", "Unsubscribe (Conn %u)", connection->id);
+			subs.divisor = 0;
+			subs.plan.clear();
+			subs.lastSent.clear();
+			return;
+		}
+		if (drefCount == 0) // Renew or change the rate of the last subscription
+		{
+			if (subs.plan.empty())
+			{
+				Log::FormatLine(LOG_ERROR, "SUBS", "ERROR: No previous subscription from connection %u.",
+					connection->id);
+				return;
+			}
+			Log::FormatLine(LOG_TRACE, "SUBS", "Renew subscription every %u frames (Conn %u)",
+				divisor, connection->id);
+		}
+		else
+		{
+			Log::FormatLine(LOG_TRACE, "SUBS", "Subscribe to %i data refs every %u frames (Conn %u)",
+				drefCount, divisor, connection->id);
+			std::vector<GetdPlanEntry> previous;
+			previous.swap(subs.plan);
+			subs.size = CompilePlan(buffer + 10, msg.GetSize() - 10, drefCount, subs.plan, "SUBS");
+			if (subs.plan.empty())
+			{
+				subs.divisor = 0;
+				subs.lastSent.clear();
+				return;
+			}
+			// The values last sent only describe what the client has if it
+			// subscribed to the same drefs.
+			bool same = previous.size() == subs.plan.size();
+			for (std::size_t i = 0; same && i < previous.size(); ++i)
+			{
+				same = previous[i].dref.xdref == subs.plan[i].dref.xdref &&
+					previous[i].dref.count == subs.plan[i].dref.count;
+			}
+			if (!same)
+			{
+				subs.lastSent.clear();
+			}
+			subs.deadbands.assign(drefCount, 0.0F);
+			subs.changesOnly = false;
+		}
+		subs.divisor = divisor;
+		subs.port = port;
+		subs.frames = 0;
+
+		// Optional trailer: mode (1) | keyframe interval (2) | deadbands (4 * count)
+		// Mode 1 sends only values that changed. A new subscription without a
+		// trailer sends every update as a full RESP message; a renewal
+		// without one keeps the mode of the subscription.
+		std::size_t ptr = 10;
+		for (int i = 0; i < drefCount && ptr < msg.GetSize(); ++i)
+		{
+			ptr += 1 + buffer[ptr];
+		}
+		if (ptr + 3 <= msg.GetSize())
+		{
+			bool changesOnly = buffer[ptr] == 1;
+			if (changesOnly && !subs.changesOnly)
+			{
+				// Values were not tracked while sending full updates.
+				subs.lastSent.clear();
+			}
+			subs.changesOnly = changesOnly;
+			memcpy(&subs.keyframeInterval, buffer + ptr + 1, sizeof(subs.keyframeInterval));
+			if (subs.keyframeInterval == 0)
+			{
+				subs.keyframeInterval = DEFAULT_KEYFRAME_INTERVAL;
+			}
+			ptr += 3;
+			if (drefCount > 0 && ptr + drefCount * sizeof(float) <= msg.GetSize())
+			{
+				memcpy(&subs.deadbands[0], buffer + ptr, drefCount * sizeof(float));
+			}
+		}
+		if (subs.changesOnly)
+		{
+			Log::FormatLine(LOG_TRACE, "SUBS", "Sending changes only, keyframe every %u updates (Conn %u)",
+				subs.keyframeInterval, connection->id);
+		}
+	}
+
+	void MessageHandlers::SendSubscriptions(std::chrono::seconds timeout)
+	{
+		std::chrono::steady_clock::time_point cutoff = std::chrono::steady_clock::now() - timeout;
+		connections.ForEach([cutoff](ConnectionInfo& conn)
+		{
+			Subscription& subs = conn.subs;
+			if (subs.divisor == 0)
+			{
+				return;
+			}
+			if (conn.lastSeen < cutoff)
+			{
+				// The client has gone quiet. Stop streaming until it subscribes again.
+				Log::FormatLine(LOG_INFO, "SUBS", "Subscription for connection %u expired", conn.id);
+				subs.divisor = 0;
+				subs.plan.clear();
+				return;
+			}
+			if (++subs.frames < subs.divisor)
+			{
+				return;
+			}
+			subs.frames = 0;
+
+			sockaddr addr = conn.addr;
+			if (subs.port != 0 && addr.sa_family == AF_INET)
+			{
+				reinterpret_cast<sockaddr_in*>(&addr)->sin_port = htons(subs.port);
+			}
+			if (!subs.changesOnly)
+			{
+				unsigned char* response = outbox.Reserve(subs.size);
+				if (!response)
+				{
+					return;
+				}
+				WriteResponse(subs.plan, response);
+				outbox.Commit(subs.size, addr);
+				return;
+			}
+
+			unsigned char response[RESPONSE_SIZE];
+			WriteResponse(subs.plan, response);
+
+			bool keyframe = subs.lastSent.empty() || ++subs.sinceKeyframe >= subs.keyframeInterval;
+			if (!keyframe)
+			{
+				unsigned char changes[RESPONSE_SIZE];
+				std::size_t size = WriteChanges(subs, response, changes);
+				if (size > 7)
+				{
+					outbox.Send(changes, size, addr);
+				}
+				keyframe = size == 0;
+			}
+			if (keyframe)
+			{
+				outbox.Send(response, subs.size, addr);
+				subs.lastSent.clear();
+				for (std::size_t i = 0; i < subs.plan.size(); ++i)
+				{
+					const GetdPlanEntry& entry = subs.plan[i];
+					const unsigned char* values = response + entry.offset + 1;
+					for (int j = 0; j < entry.dref.count; ++j)
+					{
+						float value;
+						memcpy(&value, values + j * sizeof(float), sizeof(float));
+						subs.lastSent.push_back(value);
+					}
+				}
+				subs.sinceKeyframe = 0;
+			}
+		});
+	}
+
 	void MessageHandlers::HandleText(const Message& msg)
 	{
 		// Update Log
-		Log::FormatLine(LOG_TRACE, "TEXT", "Message Received (Conn %i)", connection.id);
+		Log::FormatLine(LOG_TRACE, "TEXT", "Message Received (Conn %u)", connection->id);
 
 		std::size_t len = msg.GetSize();
 		const unsigned char*  buffer = msg.GetBuffer();
@@ -859,7 +2246,7 @@ namespace XPC
 	void MessageHandlers::HandleView(const Message& msg)
 	{
 		// Update Log
-		Log::FormatLine(LOG_TRACE, "VIEW", "Message Received(Conn %i)", connection.id);
+		Log::FormatLine(LOG_TRACE, "VIEW", "Message Received(Conn %u)", connection->id);
 		
 		bool enable_advanced_camera = false;
 		
@@ -919,7 +2306,7 @@ namespace XPC
 
 	void MessageHandlers::HandleComm(const Message& msg)
  	{
- 		Log::FormatLine(LOG_TRACE, "COMM", "Request to execute COMM command received (Conn %i)", connection.id);
+ 		Log::FormatLine(LOG_TRACE, "COMM", "Request to execute COMM command received (Conn %u)", connection->id);
  		const unsigned char* buffer = msg.GetBuffer();
  		std::size_t size = msg.GetSize();
  		std::size_t pos = 5;
@@ -942,10 +2329,78 @@ namespace XPC
  		}
  	}
 
+	void MessageHandlers::HandleTraj(const Message& msg)
+	{
+		// Format: TRAJ\0 | aircraft (1) | flags (1) | dref count (1) | total (u32)
+		//         | first (u32) | count (u16) | [drefs] | samples
+		// Flags: 1 samples include controls, 2 begin a new upload (dref names
+		//        follow as length (1) | name), 4 reply with the number of
+		//        samples received
+		// Samples are described in Playback::SampleSize.
+		const unsigned char* buffer = msg.GetBuffer();
+		const std::size_t size = msg.GetSize();
+		if (size < 18)
+		{
+			Log::FormatLine(LOG_ERROR, "TRAJ", "ERROR: Message too short: %u", (unsigned)size);
+			return;
+		}
+
+		unsigned char aircraftNumber = buffer[5];
+		unsigned char flags = buffer[6];
+		unsigned char drefCount = buffer[7];
+		std::uint32_t total;
+		std::uint32_t first;
+		std::uint16_t count;
+		memcpy(&total, buffer + 8, 4);
+		memcpy(&first, buffer + 12, 4);
+		memcpy(&count, buffer + 16, 2);
+		Log::FormatLine(LOG_TRACE, "TRAJ", "Samples %u-%u of %u for a/c %u (Conn %u)",
+			first, first + count, total, aircraftNumber, connection->id);
+
+		long received = -1;
+		std::size_t cur = 18;
+		bool valid = true;
+		if (flags & 2)
+		{
+			std::string drefs[Playback::MaxDrefs];
+			if (drefCount > Playback::MaxDrefs)
+			{
+				Log::FormatLine(LOG_ERROR, "TRAJ", "ERROR: Too many datarefs (%u)", drefCount);
+				valid = false;
+			}
+			for (int i = 0; valid && i < drefCount; ++i)
+			{
+				if (cur >= size || cur + 1 + buffer[cur] > size)
+				{
+					Log::WriteLine(LOG_ERROR, "TRAJ", "ERROR: Dataref names are truncated");
+					valid = false;
+					break;
+				}
+				drefs[i] = std::string((const char*)buffer + cur + 1, buffer[cur]);
+				cur += 1 + buffer[cur];
+			}
+			valid = valid && Playback::BeginUpload(aircraftNumber, total, (flags & 1) != 0, drefs, drefCount);
+		}
+		if (valid)
+		{
+			received = Playback::AddSamples(aircraftNumber, first, count, buffer + cur, size - cur);
+		}
+
+		if (flags & 4)
+		{
+			// Format: TRAK\0 | aircraft (1) | received (i32)
+			unsigned char response[10] = "TRAK";
+			response[5] = aircraftNumber;
+			std::int32_t value = (std::int32_t)received;
+			memcpy(response + 6, &value, 4);
+			outbox.Send(response, 10, connection->addr);
+		}
+	}
+
 	void MessageHandlers::HandleWypt(const Message& msg)
 	{
 		// Update Log
-		Log::FormatLine(LOG_TRACE, "WYPT", "Message Received (Conn %i)", connection.id);
+		Log::FormatLine(LOG_TRACE, "WYPT", "Message Received (Conn %u)", connection->id);
 
 		// Parse data
 		const unsigned char* buffer = msg.GetBuffer();
@@ -987,11 +2442,12 @@ namespace XPC
 		loopback.sin_family = AF_INET;
 		loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 		loopback.sin_port = htons(49000);
-		sock->SendTo(msg.GetBuffer(), msg.GetSize(), (sockaddr*)&loopback);
+		outbox.Send(msg.GetBuffer(), msg.GetSize(), *(sockaddr*)&loopback);
 	}
 
 	void MessageHandlers::HandleUnknown(const Message& msg)
 	{
-		Log::FormatLine(LOG_ERROR, "MSGH", "ERROR: Unknown packet type %s", msg.GetHead().c_str());
+		Statistics::Increment(COUNTER_UnknownMessages);
+		Log::FormatLine(LOG_ERROR, "MSGH", "ERROR: Unknown packet type %.4s", msg.GetBuffer());
 	}
 }
@@ -2,8 +2,11 @@
 // National Aeronautics and Space Administration. All Rights Reserved.
 #ifndef XPCPLUGIN_MESSAGEHANDLERS_H_
 #define XPCPLUGIN_MESSAGEHANDLERS_H_
+#include "ConnectionTable.h"
 #include "Message.h"
+#include "SendQueue.h"
 
+#include <cstdint>
 #include <string>
 #include <map>
 
@@ -60,27 +63,70 @@ namespace XPC
 		
 		static void SendTerr(double pos[3], char aircraft);
 
+		/// Removes connections that have not sent a message in the specified
+		/// amount of time.
+		static void EvictIdleConnections(std::chrono::seconds maxIdle);
+
+		/// Removes all connections.
+		static void ClearConnections();
+
+		/// Sends dataref values to clients whose subscriptions are due this
+		/// frame. Should be called once per frame.
+		///
+		/// \param timeout How long a subscribed client may go without sending
+		///                a message before its subscription is cancelled.
+		static void SendSubscriptions(std::chrono::seconds timeout);
+
+		/// Sends all responses queued by message handlers and subscriptions
+		/// since the last call. Should be called once at the end of each
+		/// frame.
+		static void FlushResponses();
+
+		/// Gets the handler for the specified message type.
+		///
+		/// \param tag The message type, packed as by MessageTag.
+		/// \returns   The handler for the message type, or NULL if the type is
+		///            unknown.
+		static MessageHandler GetHandler(std::uint32_t tag);
+
 	private:
 		// One handler per message type. Message types are descripbed on the
 		// wiki at https://github.com/nasa/XPlaneConnect/wiki/Network-Information
+		static void HandleBpos(const Message& msg);
 		static void HandleConn(const Message& msg);
 		static void HandleCtrl(const Message& msg);
 		static void HandleData(const Message& msg);
 		static void HandleDref(const Message& msg);
+		static void HandleDrei(const Message& msg);
 		static void HandleGetC(const Message& msg);
 		static void HandleGetD(const Message& msg);
+		static void HandleGetF(const Message& msg);
+		static void HandleGetI(const Message& msg);
 		static void HandleGetP(const Message& msg);
+		static void HandleGetS(const Message& msg);
 		static void HandleGetT(const Message& msg);
+		static void HandleGetTs(const Message& msg);
+		static void HandleGetY(const Message& msg);
+		static void HandleHist(const Message& msg);
+		static void HandleLogl(const Message& msg);
+		static void HandlePlay(const Message& msg);
 		static void HandlePosi(const Message& msg);
 		static void HandlePosT(const Message& msg);
+		static void HandleRecd(const Message& msg);
+		static void HandleRslv(const Message& msg);
 		static void HandleSimu(const Message& msg);
+		static void HandleStat(const Message& msg);
+		static void HandleSubs(const Message& msg);
 		static void HandleText(const Message& msg);
+		static void HandleTpos(const Message& msg);
+		static void HandleTraj(const Message& msg);
 		static void HandleWypt(const Message& msg);
 		static void HandleView(const Message& msg);
 		static void HandleComm(const Message& msg);
 
 		static void HandleXPlaneData(const Message& msg);
 		static void HandleUnknown(const Message& msg);
+
 		
         static int CamCallback_RunwayCam( XPLMCameraPosition_t * outCameraPosition, int inIsLosingControl, void *inRefcon);
         static int CamCallback_ChaseCam( XPLMCameraPosition_t * outCameraPosition, int inIsLosingControl, void *inRefcon);
@@ -91,19 +137,10 @@ namespace XPC
 			float zoom;
 		};
 
-		typedef struct
-		{
-			unsigned char id;
-			sockaddr addr;
-			unsigned char getdCount;
-			std::string getdRequest[255];
-		} ConnectionInfo;
-
-		static std::map<std::string, ConnectionInfo> connections;
-		static std::map<std::string, MessageHandler> handlers;
-		static std::string connectionKey; // The current connection ip:port string
-		static ConnectionInfo connection; // The current connection record
+		static ConnectionTable connections;
+		static ConnectionInfo* connection; // The current connection record
 		static UDPSocket* sock; // Outgoing network socket
+		static SendQueue outbox; // Responses waiting to be sent at the end of the frame
 	};
 }
 #endif
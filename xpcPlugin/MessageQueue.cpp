@@ -0,0 +1,129 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "MessageQueue.h"
+#include "Log.h"
+#include "Statistics.h"
+
+#include <chrono>
+#include <utility>
+
+namespace XPC
+{
+	static const char* const tag = "MSGQ";
+
+	// Distance between slot buffers in the pool. Message::MaxSize rounded up
+	// so that every buffer starts on a page boundary.
+	static const std::size_t SlotStride = (Message::MaxSize + 4095) & ~(std::size_t)4095;
+
+	MessageQueue::MessageQueue(std::size_t capacity)
+		: sock(NULL), running(false), head(0), tail(0)
+	{
+		std::size_t size = 1;
+		while (size < capacity)
+		{
+			size <<= 1;
+		}
+		// Pages of the pool are only touched once a datagram that large is
+		// received, so the memory actually used tracks the traffic.
+		pool = new unsigned char[size * SlotStride];
+		slots = new Message[size];
+		for (std::size_t i = 0; i < size; ++i)
+		{
+			slots[i] = Message(pool + i * SlotStride, Message::MaxSize);
+		}
+		mask = size - 1;
+	}
+
+	MessageQueue::~MessageQueue()
+	{
+		Stop();
+		delete[] slots;
+		delete[] pool;
+	}
+
+	void MessageQueue::Start(const UDPSocket* socket)
+	{
+		Stop();
+		Log::FormatLine(LOG_TRACE, tag, "Starting receiver thread (%u slots)", (unsigned)(mask + 1));
+		sock = socket;
+		running = true;
+		th = std::thread(&MessageQueue::Run, this);
+	}
+
+	void MessageQueue::Stop()
+	{
+		running = false;
+		if (th.joinable())
+		{
+			th.join();
+			Log::WriteLine(LOG_TRACE, tag, "Receiver thread stopped");
+		}
+	}
+
+	Message* MessageQueue::Front()
+	{
+		std::size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire))
+		{
+			return NULL;
+		}
+		return &slots[h & mask];
+	}
+
+	void MessageQueue::Pop()
+	{
+		head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	void MessageQueue::Run()
+	{
+		Message* batch[UDPSocket::MaxBatchSize];
+		while (running)
+		{
+			std::size_t t = tail.load(std::memory_order_relaxed);
+			std::size_t free = mask + 1 - (t - head.load(std::memory_order_acquire));
+			if (free == 0)
+			{
+				// The flight loop is behind. Leave new datagrams in the socket
+				// until it catches up rather than dropping them here.
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				continue;
+			}
+
+			// Wake up periodically even if no data arrives so that Stop
+			// doesn't have to wait long.
+			if (!sock->WaitForData(100))
+			{
+				continue;
+			}
+
+			int count = free < UDPSocket::MaxBatchSize ? (int)free : UDPSocket::MaxBatchSize;
+			for (int i = 0; i < count; ++i)
+			{
+				batch[i] = &slots[(t + i) & mask];
+			}
+			int read = Message::ReadBatch(*sock, batch, count);
+
+			// Pre-validate messages here so the flight loop only sees messages
+			// that have a complete header. Invalid messages are compacted out
+			// of the batch. Swapping only exchanges the views, so the buffers
+			// stay in the pool.
+			int valid = 0;
+			for (int i = 0; i < read; ++i)
+			{
+				if (batch[i]->GetSize() < 5)
+				{
+					Statistics::Increment(COUNTER_RuntsDropped);
+					Log::FormatLine(LOG_WARN, tag, "Dropped runt message (%u bytes)", (unsigned)batch[i]->GetSize());
+					continue;
+				}
+				if (valid != i)
+				{
+					std::swap(*batch[valid], *batch[i]);
+				}
+				++valid;
+			}
+			tail.store(t + valid, std::memory_order_release);
+		}
+	}
+}
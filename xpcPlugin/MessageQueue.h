@@ -0,0 +1,81 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_MESSAGEQUEUE_H_
+#define XPCPLUGIN_MESSAGEQUEUE_H_
+
+#include "Message.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+namespace XPC
+{
+	/// Reads messages from a socket on a background thread and hands them to
+	/// the flight loop through a bounded single-producer/single-consumer ring.
+	///
+	/// \details The receiver thread is the only producer and the flight loop is
+	///          the only consumer. All message slots are allocated up front, so
+	///          neither side allocates while running. Each slot is a Message
+	///          viewing its own buffer in a single pool, large enough for any
+	///          datagram. Consumers handle messages in place by calling Front,
+	///          then release the slot with Pop, which makes the buffer
+	///          available to the receiver thread again.
+	class MessageQueue
+	{
+	public:
+		/// Initializes a new instance of the MessageQueue class.
+		///
+		/// \param capacity The number of message slots in the ring. Rounded up
+		///                 to the next power of two.
+		explicit MessageQueue(std::size_t capacity);
+
+		/// Stops the receiver thread and releases the message slots.
+		~MessageQueue();
+
+		/// Starts reading messages from the specified socket on a background
+		/// thread.
+		///
+		/// \param sock The socket to read from. The socket must outlive the
+		///             receiver thread.
+		void Start(const UDPSocket* sock);
+
+		/// Stops the receiver thread. Messages already in the queue are kept.
+		void Stop();
+
+		/// Gets the oldest message in the queue without removing it.
+		///
+		/// \returns A pointer to the message, or NULL if the queue is empty.
+		///          The pointer remains valid until Pop is called.
+		Message* Front();
+
+		/// Releases the message returned by the last call to Front.
+		void Pop();
+
+	private:
+		MessageQueue(const MessageQueue&);
+		MessageQueue& operator=(const MessageQueue&);
+
+		void Run();
+
+		unsigned char* pool;
+		Message* slots;
+		std::size_t mask;
+		const UDPSocket* sock;
+
+		std::atomic<bool> running;
+		std::thread th;
+
+		// Read and write positions increase monotonically and are masked to
+		// find the slot. Padded onto separate cache lines so the two threads
+		// don't contend for them. Padding rather than alignas keeps the class
+		// from being over-aligned, which new does not honor before C++17.
+		static const std::size_t CacheLine = 64;
+		unsigned char headPad[CacheLine];
+		std::atomic<std::size_t> head;
+		unsigned char tailPad[CacheLine - sizeof(std::atomic<std::size_t>)];
+		std::atomic<std::size_t> tail;
+		unsigned char endPad[CacheLine - sizeof(std::atomic<std::size_t>)];
+	};
+}
+#endif
@@ -0,0 +1,423 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "Playback.h"
+#include "DataManager.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace XPC
+{
+	static const char* const tag = "PLAY";
+
+	// The longest flight time step applied in one frame. Larger steps happen
+	// when a flight is reloaded and are ignored.
+	static const double MAX_STEP_S = 1.0;
+
+	// The most memory one trajectory, and all trajectories together, may use.
+	// Uploads come from the network, so these keep a client from exhausting
+	// the sim's memory.
+	static const std::size_t MAX_UPLOAD_BYTES = 64 * 1024 * 1024;
+	static const std::size_t MAX_TOTAL_BYTES = 256 * 1024 * 1024;
+
+	struct Sample
+	{
+		double time;
+		double pos[3];
+		// Pitch, roll, heading and gear
+		float orient[4];
+		// Pitch, roll, yaw, throttle, gear, flaps and speed brake
+		float ctrl[7];
+	};
+
+	struct Trajectory
+	{
+		std::vector<Sample> samples;
+		std::vector<float> drefValues;
+		std::vector<bool> have;
+		std::uint32_t received;
+		bool controls;
+		int drefCount;
+		ResolvedDref drefs[Playback::MaxDrefs];
+
+		bool playing;
+		bool paused;
+		double time;
+		double rate;
+		// The index of the sample at or before time.
+		std::size_t cursor;
+		float gear;
+	};
+
+	static Trajectory trajectories[Playback::AircraftCount];
+	static double lastFlightTime = -1;
+
+	// Gets the memory used by a trajectory's samples.
+	static std::size_t TrajectoryBytes(std::size_t samples, int drefCount)
+	{
+		return samples * (sizeof(Sample) + drefCount * sizeof(float) + 1);
+	}
+
+	// Discards a trajectory's samples and frees their memory.
+	static void Discard(Trajectory& traj)
+	{
+		traj.playing = false;
+		std::vector<Sample>().swap(traj.samples);
+		std::vector<float>().swap(traj.drefValues);
+		std::vector<bool>().swap(traj.have);
+		traj.received = 0;
+	}
+
+	// Wraps an angle in degrees to [-180, 180).
+	static double Wrap180(double angle)
+	{
+		return angle - 360.0 * std::floor((angle + 180.0) / 360.0);
+	}
+
+	// Interpolates between two angles in degrees the short way round.
+	static double LerpAngle(double a, double b, double u)
+	{
+		return a + Wrap180(b - a) * u;
+	}
+
+	static double Lerp(double a, double b, double u)
+	{
+		return a + (b - a) * u;
+	}
+
+	// Interpolates a control, leaving it unchanged if either sample does.
+	static float LerpControl(float a, float b, double u)
+	{
+		if (DataManager::IsDefault(a) || DataManager::IsDefault(b))
+		{
+			return a;
+		}
+		return (float)Lerp(a, b, u);
+	}
+
+	std::size_t Playback::SampleSize(bool controls, int drefCount)
+	{
+		return 48 + (controls ? 28 : 0) + 4 * drefCount;
+	}
+
+	bool Playback::BeginUpload(unsigned char aircraft, std::uint32_t total, bool controls,
+		const std::string drefs[], int count)
+	{
+		if (aircraft >= AircraftCount)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid aircraft number %u", aircraft);
+			return false;
+		}
+		if (total < 1 || total > MaxSamples)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid sample count %u", total);
+			return false;
+		}
+		if (count < 0 || count > MaxDrefs)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Too many datarefs (%i)", count);
+			return false;
+		}
+
+		Trajectory& traj = trajectories[aircraft];
+		Discard(traj);
+		std::size_t bytes = TrajectoryBytes(total, count);
+		std::size_t otherBytes = 0;
+		for (int i = 0; i < AircraftCount; ++i)
+		{
+			otherBytes += TrajectoryBytes(trajectories[i].samples.size(), trajectories[i].drefCount);
+		}
+		if (bytes > MAX_UPLOAD_BYTES || otherBytes + bytes > MAX_TOTAL_BYTES)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Not enough memory for %u samples for a/c %u", total, aircraft);
+			return false;
+		}
+		try
+		{
+			traj.samples.assign(total, Sample());
+			traj.drefValues.assign((std::size_t)total * count, 0.0F);
+			traj.have.assign(total, false);
+		}
+		catch (const std::bad_alloc&)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Unable to allocate %u samples for a/c %u", total, aircraft);
+			Discard(traj);
+			return false;
+		}
+		traj.controls = controls;
+		traj.drefCount = count;
+		for (int i = 0; i < count; ++i)
+		{
+			traj.drefs[i] = DataManager::Resolve(drefs[i]);
+			if (!traj.drefs[i].xdref)
+			{
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid dref %s will be ignored", drefs[i].c_str());
+			}
+		}
+		Log::FormatLine(LOG_INFO, tag, "Uploading %u samples for a/c %u", total, aircraft);
+		return true;
+	}
+
+	long Playback::AddSamples(unsigned char aircraft, std::uint32_t first, std::uint32_t count,
+		const unsigned char* data, std::size_t size)
+	{
+		if (aircraft >= AircraftCount)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid aircraft number %u", aircraft);
+			return -1;
+		}
+		Trajectory& traj = trajectories[aircraft];
+		std::size_t sampleSize = SampleSize(traj.controls, traj.drefCount);
+		if (first > traj.samples.size() || count > traj.samples.size() - first || size != count * sampleSize)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Samples %u-%u don't match the upload for a/c %u",
+				first, first + count, aircraft);
+			return -1;
+		}
+
+		// Times must strictly increase, both within the chunk and against
+		// the samples already stored on either side of it, so that playback
+		// never interpolates across samples with the same time.
+		double prev = -INFINITY;
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			double time;
+			memcpy(&time, data + i * sampleSize, sizeof(double));
+			if (i == 0 && first > 0 && traj.have[first - 1])
+			{
+				prev = traj.samples[first - 1].time;
+			}
+			if (!(time > prev))
+			{
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Sample times for a/c %u must increase (sample %u)",
+					aircraft, first + i);
+				return -1;
+			}
+			prev = time;
+		}
+		std::uint32_t after = first + count;
+		if (count > 0 && after < traj.samples.size() && traj.have[after] && !(traj.samples[after].time > prev))
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Sample times for a/c %u must increase (sample %u)",
+				aircraft, after);
+			return -1;
+		}
+
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			const unsigned char* src = data + i * sampleSize;
+			Sample& sample = traj.samples[first + i];
+			memcpy(&sample.time, src, 32);
+			memcpy(sample.orient, src + 32, 16);
+			if (traj.controls)
+			{
+				memcpy(sample.ctrl, src + 48, 28);
+			}
+			else
+			{
+				std::fill(sample.ctrl, sample.ctrl + 7, DataManager::GetDefaultValue());
+			}
+			if (traj.drefCount > 0)
+			{
+				memcpy(&traj.drefValues[(std::size_t)(first + i) * traj.drefCount],
+					src + sampleSize - 4 * traj.drefCount, 4 * traj.drefCount);
+			}
+			if (!traj.have[first + i])
+			{
+				traj.have[first + i] = true;
+				++traj.received;
+			}
+		}
+		return (long)traj.received;
+	}
+
+	bool Playback::Start(unsigned char aircraft, double time)
+	{
+		if (aircraft >= AircraftCount)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid aircraft number %u", aircraft);
+			return false;
+		}
+		Trajectory& traj = trajectories[aircraft];
+		if (traj.samples.empty() || traj.received != traj.samples.size())
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: No complete trajectory for a/c %u (%u of %u samples)",
+				aircraft, traj.received, (unsigned)traj.samples.size());
+			return false;
+		}
+		for (std::size_t i = 1; i < traj.samples.size(); ++i)
+		{
+			if (!(traj.samples[i].time > traj.samples[i - 1].time))
+			{
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Sample times for a/c %u must increase (sample %u)",
+					aircraft, (unsigned)i);
+				return false;
+			}
+		}
+
+		Log::FormatLine(LOG_INFO, tag, "Playing a/c %u from %f", aircraft, time);
+		traj.playing = true;
+		traj.paused = false;
+		traj.rate = 1.0;
+		traj.gear = -1;
+		Seek(aircraft, time);
+		return true;
+	}
+
+	void Playback::SetPaused(unsigned char aircraft, bool paused)
+	{
+		if (aircraft < AircraftCount)
+		{
+			trajectories[aircraft].paused = paused;
+		}
+	}
+
+	void Playback::Seek(unsigned char aircraft, double time)
+	{
+		if (aircraft >= AircraftCount || trajectories[aircraft].samples.empty())
+		{
+			return;
+		}
+		Trajectory& traj = trajectories[aircraft];
+		traj.time = time;
+		auto next = std::upper_bound(traj.samples.begin(), traj.samples.end(), time,
+			[](double t, const Sample& s) { return t < s.time; });
+		traj.cursor = next == traj.samples.begin() ? 0 : next - traj.samples.begin() - 1;
+	}
+
+	void Playback::SetRate(unsigned char aircraft, double rate)
+	{
+		if (aircraft >= AircraftCount || std::isnan(rate))
+		{
+			return;
+		}
+		trajectories[aircraft].rate = rate;
+	}
+
+	void Playback::Stop(unsigned char aircraft)
+	{
+		if (aircraft < AircraftCount && trajectories[aircraft].playing)
+		{
+			Log::FormatLine(LOG_DEBUG, tag, "Stopped playing a/c %u", aircraft);
+			trajectories[aircraft].playing = false;
+		}
+	}
+
+	void Playback::Clear()
+	{
+		for (int i = 0; i < AircraftCount; ++i)
+		{
+			Discard(trajectories[i]);
+		}
+		lastFlightTime = -1;
+	}
+
+	// Moves an aircraft to its trajectory's state at the playback time.
+	static void Apply(unsigned char aircraft, Trajectory& traj)
+	{
+		const std::vector<Sample>& s = traj.samples;
+		std::size_t last = s.size() - 1;
+		while (traj.cursor < last && s[traj.cursor + 1].time <= traj.time)
+		{
+			++traj.cursor;
+		}
+		while (traj.cursor > 0 && s[traj.cursor].time > traj.time)
+		{
+			--traj.cursor;
+		}
+
+		std::size_t i = traj.cursor;
+		std::size_t j = i < last ? i + 1 : i;
+		double u = 0;
+		if (j != i && traj.time > s[i].time)
+		{
+			u = (traj.time - s[i].time) / (s[j].time - s[i].time);
+		}
+		const Sample& a = s[i];
+		const Sample& b = s[j];
+
+		char ac = (char)aircraft;
+		double pos[3] =
+		{
+			Lerp(a.pos[0], b.pos[0], u),
+			Wrap180(LerpAngle(a.pos[1], b.pos[1], u)),
+			Lerp(a.pos[2], b.pos[2], u)
+		};
+		double heading = LerpAngle(a.orient[2], b.orient[2], u);
+		float orient[3] =
+		{
+			(float)Lerp(a.orient[0], b.orient[0], u),
+			(float)Wrap180(LerpAngle(a.orient[1], b.orient[1], u)),
+			(float)(heading - 360.0 * std::floor(heading / 360.0))
+		};
+		DataManager::SetPosition(pos, ac);
+		DataManager::SetOrientation(orient, ac);
+
+		// Gear is applied when it changes rather than every frame.
+		float gear = u < 0.5 ? a.orient[3] : b.orient[3];
+		if (gear >= 0 && gear != traj.gear)
+		{
+			DataManager::SetGear(gear, true, ac);
+			traj.gear = gear;
+		}
+
+		if (traj.controls)
+		{
+			DataManager::SetControls(ac,
+				LerpControl(a.ctrl[0], b.ctrl[0], u),
+				LerpControl(a.ctrl[1], b.ctrl[1], u),
+				LerpControl(a.ctrl[2], b.ctrl[2], u),
+				LerpControl(a.ctrl[3], b.ctrl[3], u),
+				DataManager::IsDefault(a.ctrl[4]) ? -1 : (char)a.ctrl[4],
+				LerpControl(a.ctrl[5], b.ctrl[5], u),
+				LerpControl(a.ctrl[6], b.ctrl[6], u));
+		}
+
+		float values[Playback::MaxDrefs];
+		for (int k = 0; k < traj.drefCount; ++k)
+		{
+			values[k] = (float)Lerp(traj.drefValues[i * traj.drefCount + k],
+				traj.drefValues[j * traj.drefCount + k], u);
+		}
+		DataManager::WriteEach(traj.drefs, values, traj.drefCount);
+	}
+
+	void Playback::Update()
+	{
+		double flightTime = DataManager::GetFloat(DREF_TotalFlighttime);
+		double step = lastFlightTime < 0 ? 0 : flightTime - lastFlightTime;
+		if (step < 0 || step > MAX_STEP_S)
+		{
+			step = 0;
+		}
+		lastFlightTime = flightTime;
+
+		for (int ac = 0; ac < AircraftCount; ++ac)
+		{
+			Trajectory& traj = trajectories[ac];
+			if (!traj.playing)
+			{
+				continue;
+			}
+			if (!traj.paused)
+			{
+				traj.time += step * traj.rate;
+			}
+
+			double start = traj.samples.front().time;
+			double end = traj.samples.back().time;
+			bool finished = (traj.rate > 0 && traj.time >= end) || (traj.rate < 0 && traj.time <= start);
+			traj.time = std::min(std::max(traj.time, start), end);
+			Apply((unsigned char)ac, traj);
+			if (finished && !traj.paused)
+			{
+				Log::FormatLine(LOG_INFO, tag, "Finished playing a/c %i", ac);
+				traj.playing = false;
+			}
+		}
+	}
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_PLAYBACK_H_
+#define XPCPLUGIN_PLAYBACK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace XPC
+{
+	/// Plays back trajectories uploaded by TRAJ messages.
+	///
+	/// \details A trajectory is a sequence of timestamped samples for one
+	///          aircraft: position, orientation and gear, and optionally the
+	///          flight controls and the values of up to MaxDrefs datarefs.
+	///          Clients upload the whole trajectory in chunks, then control
+	///          playback with PLAY messages. While playing, the aircraft is
+	///          moved every frame to the trajectory's state at the playback
+	///          time, interpolating linearly between samples. The playback time
+	///          advances with X-Plane's flight time, so it stops while the sim
+	///          is paused and is not affected by network or client timing.
+	///
+	///          All methods must be called from the flight loop thread.
+	class Playback
+	{
+	public:
+		/// Starts uploading a new trajectory for an aircraft, discarding any
+		/// trajectory it already has.
+		///
+		/// \param aircraft The aircraft number. 0 is the player aircraft.
+		/// \param total    The number of samples in the trajectory.
+		/// \param controls Whether samples include the flight controls.
+		/// \param drefs    The names of the datarefs included in each sample.
+		/// \param count    The number of datarefs, no more than MaxDrefs.
+		/// \returns        true if the upload was started, or false if the
+		///                 arguments are invalid or the trajectory would use
+		///                 too much memory.
+		static bool BeginUpload(unsigned char aircraft, std::uint32_t total, bool controls,
+			const std::string drefs[], int count);
+
+		/// Adds samples to the trajectory being uploaded for an aircraft.
+		///
+		/// \param aircraft The aircraft number. 0 is the player aircraft.
+		/// \param first    The index of the first sample in data.
+		/// \param count    The number of samples in data.
+		/// \param data     The samples, in the format described in SampleSize.
+		/// \param size     The size of data in bytes.
+		/// \returns        The number of distinct samples received so far, or a
+		///                 negative value if the samples don't match the upload
+		///                 or their times don't strictly increase.
+		static long AddSamples(unsigned char aircraft, std::uint32_t first, std::uint32_t count,
+			const unsigned char* data, std::size_t size);
+
+		/// Gets the size of one sample as sent by clients.
+		///
+		/// \details Each sample is time (f64, s) | lat, lon, h (f64) |
+		///          pitch, roll, heading, gear (f32), followed by pitch, roll,
+		///          yaw, throttle, gear, flaps, speed brake (f32) if the
+		///          trajectory includes controls, and one f32 per dataref.
+		static std::size_t SampleSize(bool controls, int drefCount);
+
+		/// Starts playing an aircraft's trajectory.
+		///
+		/// \param aircraft The aircraft number. 0 is the player aircraft.
+		/// \param time     The trajectory time to start from, in seconds.
+		/// \returns        true if playback started.
+		static bool Start(unsigned char aircraft, double time);
+
+		/// Pauses or resumes playback, keeping the aircraft where it is.
+		static void SetPaused(unsigned char aircraft, bool paused);
+
+		/// Moves the playback time of an aircraft.
+		static void Seek(unsigned char aircraft, double time);
+
+		/// Sets how fast the playback time advances relative to flight time.
+		/// Negative rates play the trajectory backwards.
+		static void SetRate(unsigned char aircraft, double rate);
+
+		/// Stops playback, leaving the aircraft where it is. The trajectory
+		/// is kept so it can be played again.
+		static void Stop(unsigned char aircraft);
+
+		/// Stops playback and discards every trajectory.
+		static void Clear();
+
+		/// Advances playback by the flight time elapsed since the last call
+		/// and moves every aircraft being played. Should be called once per
+		/// frame.
+		static void Update();
+
+		/// The number of aircraft that can have trajectories.
+		static const int AircraftCount = 20;
+
+		/// The most datarefs a trajectory can include.
+		static const int MaxDrefs = 16;
+
+		/// The most samples a trajectory can have.
+		static const std::uint32_t MaxSamples = 1 << 20;
+	};
+}
+#endif
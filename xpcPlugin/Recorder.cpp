@@ -0,0 +1,315 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "Recorder.h"
+#include "DataManager.h"
+#include "Log.h"
+
+#include "xplaneRecording.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Implementation note: The flight loop is the only producer and the writer thread the only
+// consumer, so the ring needs nothing more than a head and a tail position. Each slot holds one
+// sample: the time followed by the native values of each dataref, laid out as described by
+// channels. Stopping only signals the writer, which drains the ring, closes the file and sets
+// finished; the flight loop joins it once it has, so a slow disk never stalls a frame.
+namespace XPC
+{
+	using namespace std::chrono;
+
+	static const char* const tag = "RECD";
+
+	// The size of the ring in bytes. At 60 frames per second this holds
+	// several seconds of samples for even very wide recordings.
+	static const std::size_t RING_BYTES = 4 * 1024 * 1024;
+	static const std::size_t MIN_RING_SLOTS = 64;
+
+	// The largest sample that can be recorded. Recordings are started from
+	// the network, so this keeps the ring within RING_BYTES however many
+	// datarefs a client asks for.
+	static const std::size_t MAX_SLOT_BYTES = RING_BYTES / MIN_RING_SLOTS;
+
+	// Recordings are written here, relative to the X-Plane directory. Clients
+	// only choose the file name, so they can't overwrite anything else.
+	static const char* const RECORDING_DIR = "Output/XPlaneConnect";
+
+	struct RecordedDref
+	{
+		ResolvedDref dref;
+		std::size_t offset;
+	};
+
+	static std::vector<RecordedDref> channels;
+	static std::vector<unsigned char> ring;
+	static std::size_t slotSize;
+	static std::uint64_t slotCount;
+	alignas(64) static std::atomic<std::uint64_t> head;
+	alignas(64) static std::atomic<std::uint64_t> tail;
+	static std::atomic<std::uint64_t> samples;
+	static std::atomic<std::uint64_t> written;
+	static std::atomic<std::uint64_t> dropped;
+	static std::atomic<bool> running;
+	static std::atomic<bool> failed;
+	static std::atomic<bool> finished;
+	static std::thread writer;
+	static XPCRecordingWriter* file;
+	static int divisor;
+	static int frame;
+	static double lastTime;
+
+	// Writes samples from the ring to the file until the recorder is stopped.
+	static void Run()
+	{
+		std::vector<const void*> values(channels.size());
+		bool stopping = false;
+		while (!stopping)
+		{
+			// Read the flag before draining so that samples taken before Stop
+			// are always written.
+			stopping = !running.load(std::memory_order_acquire);
+			std::uint64_t end = head.load(std::memory_order_acquire);
+			std::uint64_t pos = tail.load(std::memory_order_relaxed);
+			if (pos == end && !stopping)
+			{
+				std::this_thread::sleep_for(milliseconds(10));
+				continue;
+			}
+			for (; pos < end; ++pos)
+			{
+				const unsigned char* slot = &ring[(std::size_t)(pos % slotCount) * slotSize];
+				double time;
+				memcpy(&time, slot, sizeof(double));
+				for (std::size_t i = 0; i < channels.size(); ++i)
+				{
+					values[i] = slot + channels[i].offset;
+				}
+				if (!failed.load(std::memory_order_relaxed) && appendRecord(file, time, values.data()) == 0)
+				{
+					written.fetch_add(1, std::memory_order_relaxed);
+				}
+				else
+				{
+					if (!failed.exchange(true))
+					{
+						Log::WriteLine(LOG_ERROR, tag, "ERROR: Unable to write the recording");
+					}
+					dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+				tail.store(pos + 1, std::memory_order_release);
+			}
+		}
+
+		if (closeRecordingWriter(file) < 0)
+		{
+			failed.store(true);
+		}
+		file = NULL;
+		finished.store(true, std::memory_order_release);
+	}
+
+	// Joins the writer once it has finished the file, or waits for it to
+	// finish if wait is true.
+	static void Reap(bool wait)
+	{
+		if (!writer.joinable() || (!wait && !finished.load(std::memory_order_acquire)))
+		{
+			return;
+		}
+		writer.join();
+		std::vector<unsigned char>().swap(ring);
+		Log::FormatLine(LOG_INFO, tag, "Finished recording (%llu samples, %llu written, %llu dropped)",
+			(unsigned long long)samples.load(), (unsigned long long)written.load(),
+			(unsigned long long)dropped.load());
+	}
+
+	// Checks that a recording name is a plain file name.
+	static bool IsValidName(const std::string& name)
+	{
+		return !name.empty() && name.find_first_of("/\\:") == std::string::npos
+			&& name.find("..") == std::string::npos;
+	}
+
+	bool Recorder::Start(const std::string& name, const std::string drefs[], int count, int frames)
+	{
+		Stop();
+		Reap(false);
+		if (writer.joinable())
+		{
+			Log::WriteLine(LOG_ERROR, tag, "ERROR: The last recording is still being written");
+			return false;
+		}
+		if (count < 1 || count > 255 || frames < 1)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid dref count (%i) or divisor (%i)", count, frames);
+			return false;
+		}
+		if (!IsValidName(name))
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Invalid recording name %s", name.c_str());
+			return false;
+		}
+
+		std::vector<XPCChannel> schema(count);
+		channels.resize(count);
+		std::size_t offset = sizeof(double);
+		for (int i = 0; i < count; ++i)
+		{
+			ResolvedDref dref = DataManager::Resolve(drefs[i], true);
+			XPCChannel& channel = schema[i];
+			switch (dref.type)
+			{
+			case xplmType_Int:
+			case xplmType_IntArray:
+				channel.type = XPC_TYPE_INT;
+				break;
+			case xplmType_Float:
+			case xplmType_FloatArray:
+				channel.type = XPC_TYPE_FLOAT;
+				break;
+			case xplmType_Double:
+				channel.type = XPC_TYPE_DOUBLE;
+				break;
+			default:
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Can't record dref %s", drefs[i].c_str());
+				return false;
+			}
+			if (dref.count < 1 || dref.count > 65535)
+			{
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Can't record dref %s with %i values",
+					drefs[i].c_str(), dref.count);
+				return false;
+			}
+			std::strncpy(channel.name, drefs[i].c_str(), sizeof(channel.name) - 1);
+			channel.name[sizeof(channel.name) - 1] = 0;
+			channel.count = dref.count;
+			channels[i].dref = dref;
+			channels[i].offset = offset;
+			offset += DataManager::ElementSize(dref.type) * dref.count;
+		}
+
+		slotSize = (offset + 7) & ~(std::size_t)7;
+		if (slotSize > MAX_SLOT_BYTES)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Samples of %u bytes are too large to record (limit %u)",
+				(unsigned)slotSize, (unsigned)MAX_SLOT_BYTES);
+			return false;
+		}
+		slotCount = RING_BYTES / slotSize;
+		try
+		{
+			ring.assign((std::size_t)slotCount * slotSize, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Unable to allocate %u bytes for the recording",
+				(unsigned)(slotCount * slotSize));
+			return false;
+		}
+
+#ifdef _WIN32
+		_mkdir(RECORDING_DIR);
+#else
+		mkdir(RECORDING_DIR, 0755);
+#endif
+		std::string path = std::string(RECORDING_DIR) + "/" + name;
+		file = createRecording(path.c_str(), schema.data(), count);
+		if (!file)
+		{
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Unable to create %s", path.c_str());
+			std::vector<unsigned char>().swap(ring);
+			return false;
+		}
+
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+		samples.store(0, std::memory_order_relaxed);
+		written.store(0, std::memory_order_relaxed);
+		dropped.store(0, std::memory_order_relaxed);
+		failed.store(false, std::memory_order_relaxed);
+		finished.store(false, std::memory_order_relaxed);
+		divisor = frames;
+		frame = frames - 1;
+		lastTime = 0;
+		running.store(true, std::memory_order_release);
+		writer = std::thread(Run);
+		Log::FormatLine(LOG_INFO, tag, "Recording %i drefs every %i frames to %s", count, frames, path.c_str());
+		return true;
+	}
+
+	void Recorder::Stop()
+	{
+		if (running.exchange(false, std::memory_order_acq_rel))
+		{
+			Log::WriteLine(LOG_INFO, tag, "Stopping recording");
+		}
+	}
+
+	void Recorder::Clear()
+	{
+		Stop();
+		Reap(true);
+	}
+
+	void Recorder::Sample()
+	{
+		Reap(false);
+		if (!running.load(std::memory_order_relaxed) || ++frame < divisor)
+		{
+			return;
+		}
+		frame = 0;
+		samples.fetch_add(1, std::memory_order_relaxed);
+
+		std::uint64_t pos = head.load(std::memory_order_relaxed);
+		if (pos - tail.load(std::memory_order_acquire) >= slotCount)
+		{
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		// Recordings need times that never decrease.
+		double time = DataManager::GetFloat(DREF_TotalRuntime);
+		time = time < lastTime ? lastTime : time;
+		lastTime = time;
+
+		unsigned char* slot = &ring[(std::size_t)(pos % slotCount) * slotSize];
+		memcpy(slot, &time, sizeof(double));
+		for (std::size_t i = 0; i < channels.size(); ++i)
+		{
+			const RecordedDref& channel = channels[i];
+			int read = DataManager::ReadNative(channel.dref, slot + channel.offset, channel.dref.count);
+			if (read < channel.dref.count)
+			{
+				int elementSize = DataManager::ElementSize(channel.dref.type);
+				memset(slot + channel.offset + read * elementSize, 0, (channel.dref.count - read) * elementSize);
+			}
+		}
+		head.store(pos + 1, std::memory_order_release);
+	}
+
+	RecorderState Recorder::GetStatus(std::uint64_t& samplesTaken, std::uint64_t& samplesWritten,
+		std::uint64_t& samplesDropped)
+	{
+		samplesTaken = samples.load(std::memory_order_relaxed);
+		samplesWritten = written.load(std::memory_order_relaxed);
+		samplesDropped = dropped.load(std::memory_order_relaxed);
+		// Stay busy until the writer has finished the file, so clients know
+		// when it is safe to read it or start another recording.
+		if (!writer.joinable())
+		{
+			return RECORDER_Idle;
+		}
+		return failed.load(std::memory_order_relaxed) ? RECORDER_Failed : RECORDER_Recording;
+	}
+}
@@ -0,0 +1,70 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_RECORDER_H_
+#define XPCPLUGIN_RECORDER_H_
+
+#include <cstdint>
+#include <string>
+
+namespace XPC
+{
+	/// The state of the recorder, as reported by RECD status requests.
+	enum RecorderState
+	{
+		RECORDER_Idle = 0,
+		RECORDER_Recording = 1,
+		/// The recording could not be written. Samples are dropped until the
+		/// recorder is stopped.
+		RECORDER_Failed = 2
+	};
+
+	/// Records datarefs every frame to a binary recording file (see
+	/// xplaneRecording.h in the C client).
+	///
+	/// \details Sample copies the values of the recorded datarefs into a
+	///          preallocated ring every frame, or every Nth frame. A background
+	///          thread drains the ring into the file, so the flight loop never
+	///          waits on file IO. If the writer falls behind and the ring fills
+	///          up, samples are counted and dropped rather than blocking the
+	///          flight loop. Stopping only signals the thread, which finishes
+	///          the file in the background. Recordings are written to
+	///          Output/XPlaneConnect in the X-Plane directory. Start, Stop,
+	///          Clear and Sample must be called from the flight loop thread.
+	class Recorder
+	{
+	public:
+		/// Starts recording to a new file, stopping any recording in progress.
+		///
+		/// \param name    The file name of the recording. Must not contain path
+		///                separators or "..".
+		/// \param drefs   The datarefs to record.
+		/// \param count   The number of datarefs.
+		/// \param divisor Record every divisor'th frame. 1 records every frame.
+		/// \returns       true if recording started. Fails if the last
+		///                recording is still being finished or one sample of
+		///                the datarefs would be too large to record.
+		static bool Start(const std::string& name, const std::string drefs[], int count, int divisor);
+
+		/// Stops recording. The file is finished in the background.
+		static void Stop();
+
+		/// Stops recording and waits for the file to be finished.
+		static void Clear();
+
+		/// Records the current values of the datarefs if this frame should be
+		/// recorded. Should be called once per frame.
+		static void Sample();
+
+		/// Gets the state of the recorder. The recorder is not idle until the
+		/// file of the last recording has been finished.
+		///
+		/// \param samples The number of samples taken by the current or last
+		///                recording.
+		/// \param written The number of samples written to the file.
+		/// \param dropped The number of samples dropped because the ring was
+		///                full or the file could not be written.
+		/// \returns       The state of the recorder.
+		static RecorderState GetStatus(std::uint64_t& samples, std::uint64_t& written, std::uint64_t& dropped);
+	};
+}
+#endif
@@ -0,0 +1,67 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "SendQueue.h"
+#include "Log.h"
+#include "Statistics.h"
+
+#include <cstring>
+
+namespace XPC
+{
+	SendQueue::SendQueue() : sock(NULL), used(0), count(0) {}
+
+	void SendQueue::SetSocket(const UDPSocket* socket)
+	{
+		Flush();
+		sock = socket;
+	}
+
+	unsigned char* SendQueue::Reserve(std::size_t size)
+	{
+		if (size > MaxDatagramSize)
+		{
+			Log::FormatLine(LOG_ERROR, "SNDQ", "ERROR: Datagram of %u bytes is too large to send", (unsigned)size);
+			Statistics::Increment(COUNTER_SendErrors);
+			return NULL;
+		}
+		if (count == MaxPending || used + size > ArenaSize)
+		{
+			Log::FormatLine(LOG_DEBUG, "SNDQ", "Send queue full, sending %i datagrams early", count);
+			Flush();
+		}
+		return arena + used;
+	}
+
+	void SendQueue::Commit(std::size_t len, const sockaddr& remote)
+	{
+		buffers[count] = arena + used;
+		lengths[count] = len;
+		remotes[count] = remote;
+		++count;
+
+		// Keep each datagram 8 byte aligned so that handlers can write
+		// values straight into the buffer.
+		used += (len + 7) & ~(std::size_t)7;
+	}
+
+	void SendQueue::Send(const unsigned char* buffer, std::size_t len, const sockaddr& remote)
+	{
+		unsigned char* dst = Reserve(len);
+		if (!dst)
+		{
+			return;
+		}
+		memcpy(dst, buffer, len);
+		Commit(len, remote);
+	}
+
+	void SendQueue::Flush()
+	{
+		if (count > 0 && sock)
+		{
+			sock->SendBatch(buffers, lengths, remotes, count);
+		}
+		count = 0;
+		used = 0;
+	}
+}
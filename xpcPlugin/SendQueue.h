@@ -0,0 +1,77 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_SENDQUEUE_H_
+#define XPCPLUGIN_SENDQUEUE_H_
+
+#include "UDPSocket.h"
+
+#include <cstddef>
+
+namespace XPC
+{
+	/// Collects the datagrams sent during a frame so they can be sent
+	/// together with UDPSocket::SendBatch.
+	///
+	/// \details Datagrams are built in place in a preallocated arena: call
+	///          Reserve to get space for a datagram, write it, then call
+	///          Commit with its actual length and destination. Nothing is
+	///          allocated while running. If the arena fills up during a frame,
+	///          the datagrams collected so far are sent early. Not thread safe;
+	///          only the flight loop should use a SendQueue.
+	class SendQueue
+	{
+	public:
+		/// Initializes a new, empty queue.
+		SendQueue();
+
+		/// Sets the socket that datagrams are sent from.
+		void SetSocket(const UDPSocket* sock);
+
+		/// Gets space for a datagram of up to the specified size.
+		///
+		/// \param size The maximum size of the datagram in bytes. Must be no
+		///             larger than MaxDatagramSize.
+		/// \returns    A buffer of at least size bytes, or NULL if size is too
+		///             large. The buffer is valid until the next call to
+		///             Commit, Send or Flush.
+		unsigned char* Reserve(std::size_t size);
+
+		/// Queues the datagram written to the buffer returned by the last
+		/// call to Reserve.
+		///
+		/// \param len    The number of bytes written. Must not be larger than
+		///               the size passed to Reserve.
+		/// \param remote The destination of the datagram.
+		void Commit(std::size_t len, const sockaddr& remote);
+
+		/// Copies a datagram into the queue.
+		///
+		/// \param buffer The datagram to send.
+		/// \param len    The size of the datagram in bytes.
+		/// \param remote The destination of the datagram.
+		void Send(const unsigned char* buffer, std::size_t len, const sockaddr& remote);
+
+		/// Sends all queued datagrams.
+		void Flush();
+
+		/// The largest datagram that can be queued.
+		static const std::size_t MaxDatagramSize = 65536;
+
+	private:
+		SendQueue(const SendQueue&);
+		SendQueue& operator=(const SendQueue&);
+
+		static const std::size_t ArenaSize = 256 * 1024;
+		static_assert(MaxDatagramSize <= ArenaSize, "The arena must hold the largest datagram");
+		static const int MaxPending = 256;
+
+		const UDPSocket* sock;
+		alignas(8) unsigned char arena[ArenaSize];
+		std::size_t used;
+		int count;
+		const unsigned char* buffers[MaxPending];
+		std::size_t lengths[MaxPending];
+		sockaddr remotes[MaxPending];
+	};
+}
+#endif
@@ -0,0 +1,221 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#include "Statistics.h"
+
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace XPC
+{
+	using namespace std::chrono;
+
+	// Gets the index of the most significant set bit. v must not be 0.
+	static int HighestBit(std::uint64_t v)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+#ifdef _WIN64
+		_BitScanReverse64(&index, v);
+		return (int)index;
+#else
+		if (v >> 32)
+		{
+			_BitScanReverse(&index, (unsigned long)(v >> 32));
+			return (int)index + 32;
+		}
+		_BitScanReverse(&index, (unsigned long)v);
+		return (int)index;
+#endif
+#else
+		return 63 - __builtin_clzll(v);
+#endif
+	}
+
+	Histogram::Histogram()
+	{
+		Reset();
+	}
+
+	int Histogram::BucketIndex(std::uint64_t ns)
+	{
+		if (ns < SubCount)
+		{
+			return (int)ns;
+		}
+		int msb = HighestBit(ns);
+		int group = msb - SubBits + 1;
+		int sub = (int)(ns >> (msb - SubBits)) - SubCount;
+		int index = group * SubCount + sub;
+		return index < BucketCount ? index : BucketCount - 1;
+	}
+
+	std::uint64_t Histogram::BucketValue(int index)
+	{
+		if (index < SubCount)
+		{
+			return (std::uint64_t)index;
+		}
+		int group = index / SubCount;
+		int sub = index % SubCount;
+		std::uint64_t lowest = (std::uint64_t)(SubCount + sub) << (group - 1);
+		return lowest + ((std::uint64_t)1 << (group - 1)) - 1;
+	}
+
+	void Histogram::Record(std::uint64_t ns)
+	{
+		++buckets[BucketIndex(ns)];
+		++count;
+		if (ns > max)
+		{
+			max = ns;
+		}
+	}
+
+	void Histogram::Reset()
+	{
+		memset(buckets, 0, sizeof(buckets));
+		count = 0;
+		max = 0;
+	}
+
+	std::uint64_t Histogram::GetCount() const
+	{
+		return count;
+	}
+
+	std::uint64_t Histogram::GetMax() const
+	{
+		return max;
+	}
+
+	std::uint64_t Histogram::GetPercentile(double fraction) const
+	{
+		if (count == 0)
+		{
+			return 0;
+		}
+		std::uint64_t target = (std::uint64_t)(fraction * count + 0.5);
+		if (target < 1)
+		{
+			target = 1;
+		}
+		std::uint64_t seen = 0;
+		for (int i = 0; i < BucketCount; ++i)
+		{
+			seen += buckets[i];
+			if (seen >= target)
+			{
+				std::uint64_t value = BucketValue(i);
+				return value < max ? value : max;
+			}
+		}
+		return max;
+	}
+
+	// Message types are assigned a histogram the first time they are seen.
+	// Once the table is full, any other types share the last entry, which is
+	// reported with the name "????".
+	static const std::size_t HANDLER_SLOTS = 64;
+	static std::uint32_t handlerTags[HANDLER_SLOTS];
+	static Histogram handlerTimes[HANDLER_SLOTS];
+	static std::size_t handlerCount;
+
+	std::atomic<std::uint64_t> Statistics::counters[COUNTER_Count];
+
+	static Histogram queueWait;
+	static Histogram callbackTime;
+
+	static std::uint64_t ToNanoseconds(steady_clock::duration elapsed)
+	{
+		long long ns = duration_cast<nanoseconds>(elapsed).count();
+		return ns < 0 ? 0 : (std::uint64_t)ns;
+	}
+
+	void Statistics::RecordHandler(std::uint32_t tag, steady_clock::duration elapsed)
+	{
+		std::size_t i = 0;
+		while (i < handlerCount && handlerTags[i] != tag)
+		{
+			++i;
+		}
+		if (i == HANDLER_SLOTS)
+		{
+			i = HANDLER_SLOTS - 1;
+		}
+		else if (i == handlerCount)
+		{
+			handlerTags[i] = i == HANDLER_SLOTS - 1 ? 0 : tag;
+			++handlerCount;
+		}
+		handlerTimes[i].Record(ToNanoseconds(elapsed));
+	}
+
+	void Statistics::RecordQueueWait(steady_clock::duration elapsed)
+	{
+		queueWait.Record(ToNanoseconds(elapsed));
+	}
+
+	void Statistics::RecordCallback(steady_clock::duration elapsed)
+	{
+		callbackTime.Record(ToNanoseconds(elapsed));
+	}
+
+	void Statistics::Reset()
+	{
+		for (std::size_t i = 0; i < handlerCount; ++i)
+		{
+			handlerTimes[i].Reset();
+		}
+		handlerCount = 0;
+		queueWait.Reset();
+		callbackTime.Reset();
+	}
+
+	static unsigned char* WriteEntry(unsigned char* cur, const char name[4], const Histogram& h)
+	{
+		std::uint32_t count = (std::uint32_t)h.GetCount();
+		float values[4] =
+		{
+			h.GetPercentile(0.5) / 1000.0F,
+			h.GetPercentile(0.99) / 1000.0F,
+			h.GetPercentile(0.999) / 1000.0F,
+			h.GetMax() / 1000.0F
+		};
+		memcpy(cur, name, 4);
+		memcpy(cur + 4, &count, 4);
+		memcpy(cur + 8, values, sizeof(values));
+		return cur + Statistics::EntrySize;
+	}
+
+	std::size_t Statistics::WriteSummary(unsigned char* buffer, std::size_t size, unsigned char& count)
+	{
+		unsigned char* cur = buffer;
+		unsigned char* end = buffer + size;
+		count = 0;
+		if (cur + 2 * EntrySize > end)
+		{
+			return 0;
+		}
+		cur = WriteEntry(cur, "loop", callbackTime);
+		cur = WriteEntry(cur, "wait", queueWait);
+		count = 2;
+		for (std::size_t i = 0; i < handlerCount && cur + EntrySize <= end && count < 255; ++i)
+		{
+			char name[4] = { '?', '?', '?', '?' };
+			std::uint32_t tag = handlerTags[i];
+			if (tag != 0)
+			{
+				name[0] = (char)(tag >> 24);
+				name[1] = (char)(tag >> 16);
+				name[2] = (char)(tag >> 8);
+				name[3] = (char)tag;
+			}
+			cur = WriteEntry(cur, name, handlerTimes[i]);
+			++count;
+		}
+		return cur - buffer;
+	}
+}
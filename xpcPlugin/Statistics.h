@@ -0,0 +1,153 @@
+// Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
+// National Aeronautics and Space Administration. All Rights Reserved.
+#ifndef XPCPLUGIN_STATISTICS_H_
+#define XPCPLUGIN_STATISTICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace XPC
+{
+	/// A fixed size histogram of durations with log-linear buckets.
+	///
+	/// \details Values below 2^SubBits nanoseconds get a bucket each. Above that, each power of
+	///          two is split into 2^SubBits equal buckets, so every recorded value is known to
+	///          within about 3%. All storage is part of the object, so recording never allocates.
+	///          Values too large for the last bucket are counted in it.
+	class Histogram
+	{
+	public:
+		/// Initializes a new, empty histogram.
+		Histogram();
+
+		/// Adds a duration to the histogram.
+		///
+		/// \param ns The duration in nanoseconds.
+		void Record(std::uint64_t ns);
+
+		/// Removes all recorded values.
+		void Reset();
+
+		/// Gets the number of recorded values.
+		std::uint64_t GetCount() const;
+
+		/// Gets the largest recorded value in nanoseconds.
+		std::uint64_t GetMax() const;
+
+		/// Gets the value below which the specified fraction of recorded
+		/// values fall.
+		///
+		/// \param fraction The fraction of values, between 0 and 1.
+		/// \returns        The highest value in the bucket containing the
+		///                 percentile, in nanoseconds, or 0 if the histogram
+		///                 is empty.
+		std::uint64_t GetPercentile(double fraction) const;
+
+	private:
+		static const int SubBits = 5;
+		static const int SubCount = 1 << SubBits;
+		// Enough buckets for durations up to 2^36 ns (about a minute).
+		static const int BucketCount = (36 - SubBits + 1) * SubCount;
+
+		static int BucketIndex(std::uint64_t ns);
+		static std::uint64_t BucketValue(int index);
+
+		std::uint32_t buckets[BucketCount];
+		std::uint64_t count;
+		std::uint64_t max;
+	};
+
+	/// Health counters kept by the plugin. The order of the values is the
+	/// order in which they are sent in STAR messages, so new counters must
+	/// be added at the end.
+	enum Counter
+	{
+		/// Datagrams read from the socket.
+		COUNTER_DatagramsReceived,
+		/// Bytes read from the socket.
+		COUNTER_BytesReceived,
+		/// Failed reads from the socket.
+		COUNTER_ReceiveErrors,
+		/// Datagrams discarded because they were too short to be messages.
+		COUNTER_RuntsDropped,
+		/// Messages passed to a message handler.
+		COUNTER_MessagesHandled,
+		/// Messages with a header that the plugin does not recognize.
+		COUNTER_UnknownMessages,
+		/// Frames in which messages were left in the queue because the
+		/// cycle budget ran out.
+		COUNTER_BudgetExhausted,
+		/// Requests for datarefs that do not exist.
+		COUNTER_InvalidDrefs,
+		/// Datagrams sent from the socket.
+		COUNTER_DatagramsSent,
+		/// Bytes sent from the socket.
+		COUNTER_BytesSent,
+		/// Failed sends from the socket.
+		COUNTER_SendErrors,
+
+		/// The number of counters. Not a valid counter.
+		COUNTER_Count
+	};
+
+	/// Collects timing statistics and health counters for the plugin.
+	///
+	/// \details Timing statistics are kept separately for each message type,
+	///          for the time messages wait in the receive queue, and for the
+	///          time taken by the whole flight loop callback. The timing
+	///          methods must be called from the flight loop thread. Counters
+	///          are atomic and may be updated from any thread.
+	class Statistics
+	{
+	public:
+		/// Adds to one of the health counters.
+		static void Increment(Counter counter, std::uint64_t amount = 1)
+		{
+			counters[counter].fetch_add(amount, std::memory_order_relaxed);
+		}
+
+		/// Gets the current value of one of the health counters.
+		static std::uint64_t Get(Counter counter)
+		{
+			return counters[counter].load(std::memory_order_relaxed);
+		}
+
+		/// Records the time taken to handle a message.
+		///
+		/// \param tag     The tag of the message, as returned by Message::GetTag.
+		/// \param elapsed The time spent in the message handler.
+		static void RecordHandler(std::uint32_t tag, std::chrono::steady_clock::duration elapsed);
+
+		/// Records the time a message waited between being read from the
+		/// socket and being handled.
+		static void RecordQueueWait(std::chrono::steady_clock::duration elapsed);
+
+		/// Records the time taken by one call of the flight loop callback.
+		static void RecordCallback(std::chrono::steady_clock::duration elapsed);
+
+		/// Removes all recorded timing values. Counters are not reset.
+		static void Reset();
+
+		/// Writes a summary of the statistics in the format used by STAR
+		/// messages.
+		///
+		/// \details Each entry is
+		///          name (4) | count (u32) | p50 | p99 | p99.9 | max (f32, microseconds).
+		///          Message types use their header as the name. The queue wait
+		///          and callback entries are named "wait" and "loop".
+		/// \param buffer The location to write the entries.
+		/// \param size   The size of buffer in bytes.
+		/// \param count  Set to the number of entries written.
+		/// \returns      The number of bytes written.
+		static std::size_t WriteSummary(unsigned char* buffer, std::size_t size, unsigned char& count);
+
+		/// The size of one entry written by WriteSummary.
+		static const std::size_t EntrySize = 24;
+
+	private:
+		static std::atomic<std::uint64_t> counters[COUNTER_Count];
+	};
+}
+#endif
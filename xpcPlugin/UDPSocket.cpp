@@ -1,14 +1,18 @@
 // Copyright (c) 2013-2018 United States Government as represented by the Administrator of the
 // National Aeronautics and Space Administration. All Rights Reserved.
 #include "Log.h"
+#include "Statistics.h"
 #include "UDPSocket.h"
 
 #include <cstring>
 #include <cstdio>
+#ifdef __linux
+#include <cerrno>
+#endif
 
 namespace XPC
 {
-	const static std::string tag = "SOCK";
+	static const char* const tag = "SOCK";
 
 	UDPSocket::UDPSocket(unsigned short recvPort)
 	{
@@ -56,6 +60,15 @@ namespace XPC
 			return;
 		}
 
+		// Give the kernel room to hold datagrams that arrive faster than we
+		// handle them. Anything we don't get to in one frame stays queued here
+		// until the next frame.
+		int rcvbuf = 1 << 20;
+		if (setsockopt(this->sock, SOL_SOCKET, SO_RCVBUF, (char*)&rcvbuf, sizeof(rcvbuf)) < 0)
+		{
+			Log::WriteLine(LOG_WARN, tag, "WARN: Failed to set receive buffer size.");
+		}
+
 		// Set timeout period for SendTo to 1 millisecond
 		// Without this, playback may become choppy due to process blocking
 #ifdef _WIN32
@@ -113,6 +126,7 @@ namespace XPC
 		int status = select(sock+1, &stReadFDS, NULL, &stExceptFDS, &timeout);
 		if (status < 0)
 		{
+			Statistics::Increment(COUNTER_ReceiveErrors);
 #ifdef _WIN32
 			int err = WSAGetLastError();
 			Log::FormatLine(LOG_ERROR, tag, "ERROR: Select failed. (Error code %i)", err);
@@ -131,6 +145,7 @@ namespace XPC
 		status = recvfrom(sock, (char*)dst, maxLen, 0, recvAddr, &recvaddrlen);
 		if (status < 0)
 		{
+			Statistics::Increment(COUNTER_ReceiveErrors);
 #ifdef _WIN32
 			int err = WSAGetLastError();
 			Log::FormatLine(LOG_ERROR, tag, "ERROR: Receive failed. (Error code %i)", err);
@@ -138,18 +153,167 @@ namespace XPC
 			Log::WriteLine(LOG_ERROR, tag, "ERROR: Receive failed.");
 #endif
 		}
+		else
+		{
+			Statistics::Increment(COUNTER_DatagramsReceived);
+			Statistics::Increment(COUNTER_BytesReceived, status);
+		}
+		return status;
+	}
+
+	bool UDPSocket::WaitForData(int timeoutMs) const
+	{
+		fd_set stReadFDS;
+		struct timeval timeout;
+
+		FD_ZERO(&stReadFDS);
+		FD_SET(sock, &stReadFDS);
+
+		timeout.tv_sec = timeoutMs / 1000;
+		timeout.tv_usec = (timeoutMs % 1000) * 1000;
+
+		int status = select(sock + 1, &stReadFDS, NULL, NULL, &timeout);
+		if (status < 0)
+		{
+#ifdef _WIN32
+			int err = WSAGetLastError();
+			Log::FormatLine(LOG_ERROR, tag, "ERROR: Select failed. (Error code %i)", err);
+#else
+			Log::WriteLine(LOG_ERROR, tag, "ERROR: Select failed.");
+#endif
+			return false;
+		}
+		return status > 0;
+	}
+
+	int UDPSocket::ReadBatch(unsigned char* buffers[], int size, int lengths[], sockaddr remoteAddrs[], int count) const
+	{
+		if (count > MaxBatchSize)
+		{
+			count = MaxBatchSize;
+		}
+#ifdef __linux
+		struct mmsghdr msgs[MaxBatchSize];
+		struct iovec iovecs[MaxBatchSize];
+		memset(msgs, 0, count * sizeof(struct mmsghdr));
+		for (int i = 0; i < count; ++i)
+		{
+			iovecs[i].iov_base = buffers[i];
+			iovecs[i].iov_len = size;
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_name = &remoteAddrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr);
+		}
+
+		int status = recvmmsg(sock, msgs, count, MSG_DONTWAIT, NULL);
+		if (status < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				Statistics::Increment(COUNTER_ReceiveErrors);
+				Log::FormatLine(LOG_ERROR, tag, "ERROR: Batch receive failed. (Error code %i)", errno);
+			}
+			return 0;
+		}
+		std::uint64_t bytes = 0;
+		for (int i = 0; i < status; ++i)
+		{
+			lengths[i] = (int)msgs[i].msg_len;
+			bytes += msgs[i].msg_len;
+		}
+		Statistics::Increment(COUNTER_DatagramsReceived, status);
+		Statistics::Increment(COUNTER_BytesReceived, bytes);
 		return status;
+#else
+		int read = 0;
+		while (read < count)
+		{
+			int len = Read(buffers[read], size, &remoteAddrs[read]);
+			if (len <= 0)
+			{
+				break;
+			}
+			lengths[read++] = len;
+		}
+		return read;
+#endif
+	}
+
+	int UDPSocket::SendBatch(const unsigned char* const buffers[], const std::size_t lengths[],
+		const sockaddr remotes[], int count) const
+	{
+		int sent = 0;
+		std::uint64_t bytes = 0;
+#ifdef __linux
+		struct mmsghdr msgs[MaxBatchSize];
+		struct iovec iovecs[MaxBatchSize];
+		int first = 0;
+		while (first < count)
+		{
+			int batch = count - first < MaxBatchSize ? count - first : MaxBatchSize;
+			memset(msgs, 0, batch * sizeof(struct mmsghdr));
+			for (int i = 0; i < batch; ++i)
+			{
+				iovecs[i].iov_base = (void*)buffers[first + i];
+				iovecs[i].iov_len = lengths[first + i];
+				msgs[i].msg_hdr.msg_iov = &iovecs[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+				msgs[i].msg_hdr.msg_name = (void*)&remotes[first + i];
+				msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr);
+			}
+
+			int status = sendmmsg(sock, msgs, batch, 0);
+			if (status <= 0)
+			{
+				// The first datagram in the batch failed. Skip it and carry on
+				// with the rest.
+				Statistics::Increment(COUNTER_SendErrors);
+				Log::FormatLine(LOG_ERROR, tag, "Batch send failed. (Error code %i)", errno);
+				++first;
+				continue;
+			}
+			for (int i = 0; i < status; ++i)
+			{
+				bytes += msgs[i].msg_len;
+			}
+			sent += status;
+			first += status;
+		}
+#else
+		for (int i = 0; i < count; ++i)
+		{
+			if (sendto(sock, (const char*)buffers[i], (int)lengths[i], 0, &remotes[i], sizeof(sockaddr)) < 0)
+			{
+				Statistics::Increment(COUNTER_SendErrors);
+				Log::WriteLine(LOG_ERROR, tag, "Send failed.");
+				continue;
+			}
+			bytes += lengths[i];
+			++sent;
+		}
+#endif
+		Statistics::Increment(COUNTER_DatagramsSent, sent);
+		Statistics::Increment(COUNTER_BytesSent, bytes);
+		Log::FormatLine(LOG_TRACE, tag, "Sent batch of %i datagrams", sent);
+		return sent;
 	}
 
 	void UDPSocket::SendTo(const unsigned char* buffer, std::size_t len, sockaddr* remote) const
 	{
 		if (sendto(sock, (char*)buffer, (int)len, 0, remote, sizeof(*remote)) < 0)
 		{
+			Statistics::Increment(COUNTER_SendErrors);
 			Log::FormatLine(LOG_ERROR, tag, "Send failed. (remote: %s)", GetHost(remote).c_str());
 		}
 		else
 		{
-			Log::FormatLine(LOG_INFO, tag, "Send succeeded. (remote: %s)", GetHost(remote).c_str());
+			Statistics::Increment(COUNTER_DatagramsSent);
+			Statistics::Increment(COUNTER_BytesSent, len);
+			if (Log::IsEnabled(LOG_INFO))
+			{
+				Log::FormatLine(LOG_INFO, tag, "Send succeeded. (remote: %s)", GetHost(remote).c_str());
+			}
 		}
 	}
 	
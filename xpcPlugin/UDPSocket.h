@@ -32,6 +32,9 @@ namespace XPC
 	class UDPSocket
 	{
 	public:
+		/// The maximum number of datagrams read by a single call to ReadBatch.
+		static const int MaxBatchSize = 64;
+
 		/// Initializes a new instance of the XPCSocket class bound to the
 		/// specified receive port.
 		///
@@ -52,12 +55,50 @@ namespace XPC
 		///                   an error occurs.
 		int Read(unsigned char* buffer, int size, sockaddr* remoteAddr) const;
 
+		/// Reads as many datagrams as are immediately available, up to the
+		/// specified count, without blocking.
+		///
+		/// \param buffers     An array of count buffers to copy the data into.
+		/// \param size        The size of each buffer in bytes.
+		/// \param lengths     When the method returns, contains the number of bytes
+		///                    read into each buffer.
+		/// \param remoteAddrs When the method returns, contains the address of the
+		///                    remote host for each datagram read.
+		/// \param count       The number of buffers available.
+		/// \returns           The number of datagrams read. Zero if no data was
+		///                    available or an error occurs.
+		///
+		/// \remarks On Linux, this reads the whole batch with a single recvmmsg
+		///          call. On other platforms it falls back to calling Read in a loop.
+		int ReadBatch(unsigned char* buffers[], int size, int lengths[], sockaddr remoteAddrs[], int count) const;
+
+		/// Blocks until data is available to read or the specified timeout
+		/// expires.
+		///
+		/// \param timeoutMs The maximum time to wait in milliseconds.
+		/// \returns         true if data is available; otherwise false.
+		bool WaitForData(int timeoutMs) const;
+
 		/// Sends data to the specified remote endpoint.
 		///
 		/// \param data   The data to be sent.
 		/// \param len    The number of bytes to send.
 		/// \param remote The destination socket.
 		void SendTo(const unsigned char* buffer, std::size_t len, sockaddr* remote) const;
+
+		/// Sends a batch of datagrams.
+		///
+		/// \param buffers The data for each datagram.
+		/// \param lengths The number of bytes in each datagram.
+		/// \param remotes The destination of each datagram.
+		/// \param count   The number of datagrams to send.
+		/// \returns       The number of datagrams sent successfully.
+		///
+		/// \remarks On Linux, this sends up to MaxBatchSize datagrams per
+		///          sendmmsg call. On other platforms it falls back to calling
+		///          sendto in a loop.
+		int SendBatch(const unsigned char* const buffers[], const std::size_t lengths[],
+			const sockaddr remotes[], int count) const;
 		
 		/// Gets a string containing the IP address and port contained in the given sockaddr.
 		///
@@ -57,38 +57,49 @@
 // XPC Includes
 #include "DataManager.h"
 #include "Drawing.h"
+#include "History.h"
+#include "Interpolator.h"
 #include "Log.h"
 #include "MessageHandlers.h"
+#include "MessageQueue.h"
+#include "Playback.h"
+#include "Recorder.h"
+#include "Statistics.h"
 #include "UDPSocket.h"
 #include "Timer.h"
 
 // XPLM Includes
+#include "XPLMPlugin.h"
 #include "XPLMProcessing.h"
 #include "XPLMUtilities.h"
 
 // System Includes
+#include <chrono>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
-#ifdef __APPLE__
-#include <mach/mach_time.h>
-#endif
 
 #define RECVPORT 49009 // Port that the plugin receives commands on
-#define OPS_PER_CYCLE 20 // Max Number of operations per cycle
+#define CYCLE_BUDGET_US 2000 // Default time budget for handling messages each cycle, in microseconds
+#define CONNECTION_TIMEOUT_S 300 // Seconds without a message before a client's connection record is discarded
+#define SUBSCRIPTION_TIMEOUT_S 30 // Seconds without a message from a subscribed client before its subscription is cancelled
+#define QUEUE_SIZE 256 // Number of received messages buffered between the receiver thread and the flight loop
 
 #define XPC_PLUGIN_VERSION "1.3-rc.1"
 
 using namespace std;
 
 XPC::UDPSocket* sock = NULL;
+XPC::MessageQueue* queue = NULL;
 XPC::Timer* timer = NULL;
 
-double start;
-double lap;
-static double timeConvert = 0.0;
 int benchmarkingSwitch = 0; // 1 = time for operations, 2 = time for op + cycle;
 
+// Time budget for handling messages each cycle. May be overridden by setting the
+// XPC_CYCLE_BUDGET_US environment variable before starting X-Plane.
+static long cycleBudgetUs = CYCLE_BUDGET_US;
+
 PLUGIN_API int XPluginStart(char* outName, char* outSig, char* outDesc);
 PLUGIN_API void	XPluginStop(void);
 PLUGIN_API void XPluginDisable(void);
@@ -102,16 +113,11 @@ PLUGIN_API int XPluginStart(char* outName, char* outSig, char* outDesc)
 	strcpy(outSig, "NASA.XPlaneConnect");
 	strcpy(outDesc, "X Plane Communications Toolbox\nCopyright (c) 2013-2018 United States Government as represented by the Administrator of the National Aeronautics and Space Administration. All Rights Reserved.");
 
-#if (__APPLE__)
-	if ( timeConvert <= 1e-9 ) // is about 0
+	const char* logLevel = getenv("XPC_LOG_LEVEL");
+	if (logLevel != NULL)
 	{
-		mach_timebase_info_data_t timeBase;
-		(void)mach_timebase_info(&timeBase);
-		timeConvert = (double)timeBase.numer /
-		(double)timeBase.denom /
-		1000000000.0;
+		XPC::Log::SetLevel(atoi(logLevel));
 	}
-#endif
 	XPC::Log::Initialize(XPC_PLUGIN_VERSION);
 	XPC::Log::WriteLine(LOG_INFO, "EXEC", "Plugin Start");
 	XPC::DataManager::Initialize();
@@ -129,6 +135,15 @@ PLUGIN_API void XPluginDisable(void)
 {
 	XPLMUnregisterFlightLoopCallback(XPCFlightLoopCallback, NULL);
 
+	// Stop the receiver thread before closing the socket it reads from
+	delete queue;
+	queue = NULL;
+	XPC::MessageHandlers::ClearConnections();
+	XPC::Interpolator::Clear();
+	XPC::Playback::Clear();
+	XPC::Recorder::Clear();
+	XPC::History::Clear();
+
 	// Close sockets
 	delete sock;
 	sock = NULL;
@@ -151,15 +166,25 @@ PLUGIN_API int XPluginEnable(void)
 	// Open sockets
 	sock = new XPC::UDPSocket(RECVPORT);
 	timer = new XPC::Timer();
+	queue = new XPC::MessageQueue(QUEUE_SIZE);
+	queue->Start(sock);
 	
 	XPC::MessageHandlers::SetSocket(sock);
 
+	const char* budget = getenv("XPC_CYCLE_BUDGET_US");
+	if (budget != NULL && atol(budget) > 0)
+	{
+		cycleBudgetUs = atol(budget);
+	}
+	XPC::Log::FormatLine(LOG_INFO, "EXEC", "Cycle budget: %li us", cycleBudgetUs);
+
 	XPC::Log::WriteLine(LOG_INFO, "EXEC", "Plugin Enabled, sockets opened");
 	if (benchmarkingSwitch > 0)
 	{
 		XPC::Log::FormatLine(LOG_INFO, "EXEC", "Benchmarking Enabled (Verbosity: %i)", benchmarkingSwitch);
 	}
-	XPC::Log::FormatLine(LOG_INFO, "EXEC", "Debug Logging Enabled (Verbosity: %i)", LOG_LEVEL);
+	XPC::Log::FormatLine(LOG_INFO, "EXEC", "Debug Logging Enabled (Verbosity: %i, built with %i)",
+		XPC::Log::GetLevel(), LOG_LEVEL);
 
 	float interval = -1; // Call every frame
 	void* refcon = NULL; // Don't pass anything to the callback directly
@@ -179,8 +204,13 @@ PLUGIN_API int XPluginEnable(void)
 
 PLUGIN_API void XPluginReceiveMessage(XPLMPluginID inFromWho, int inMessage, void* inParam)
 {
-	// XPC doesn't have anything useful to say to other plugins, so simply ignore
-	// any messages received.
+	// XPC doesn't have anything useful to say to other plugins. The only
+	// message we care about is an aircraft being (re)loaded, which may change
+	// the datarefs that DataManager has already looked up.
+	if (inMessage == XPLM_MSG_PLANE_LOADED)
+	{
+		XPC::DataManager::Invalidate((int)(intptr_t)inParam);
+	}
 }
 
 float XPCFlightLoopCallback(float inElapsedSinceLastCall,
@@ -188,54 +218,48 @@ float XPCFlightLoopCallback(float inElapsedSinceLastCall,
 	int inCounter,
 	void* inRefcon)
 {
-#if (__APPLE__)
-	double diff_t;
-#endif
-
+	chrono::steady_clock::time_point cycleStart = chrono::steady_clock::now();
 	if (benchmarkingSwitch > 1)
 	{
 		XPC::Log::FormatLine(LOG_DEBUG, "EXEC", "Cycle time %.6f", inElapsedSinceLastCall);
 	}
 
-	int ops;
-	for (ops = 0; ops < OPS_PER_CYCLE; ops++)
+	// Every client reading a dataref this frame should see the same value.
+	XPC::DataManager::ClearSnapshot();
+
+	chrono::steady_clock::time_point deadline = cycleStart + chrono::microseconds(cycleBudgetUs);
+	XPC::Message* msg;
+	while ((msg = queue->Front()) != NULL)
 	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		XPC::MessageHandlers::HandleMessage(*msg);
+		queue->Pop();
+
 		if (benchmarkingSwitch > 0)
 		{
-#if (__APPLE__)
-			start = (double)mach_absolute_time( ) * timeConvert;
-#endif
+			chrono::duration<double> diff_t = chrono::steady_clock::now() - start;
+			XPC::Log::FormatLine(LOG_INFO, "EXEC", "Runtime %.6f", diff_t.count());
 		}
 
-		XPC::Message msg = XPC::Message::ReadFrom(*sock);
-		if (msg.GetHead() == "")
+		// If we run out of time, leave whatever is left in the queue for the
+		// next cycle rather than stalling the sim. This typically only
+		// happens during transitory events like a long load inside X-Plane
+		// that caused us to stop responding for a while.
+		if (chrono::steady_clock::now() >= deadline && queue->Front() != NULL)
 		{
+			XPC::Statistics::Increment(XPC::COUNTER_BudgetExhausted);
+			XPC::Log::WriteLine(LOG_DEBUG, "EXEC", "Cycle budget exhausted, deferring remaining messages");
 			break;
 		}
-		XPC::MessageHandlers::HandleMessage(msg);
-
-		if (benchmarkingSwitch > 0)
-		{
-#if (__APPLE__)
-			lap = (double)mach_absolute_time( ) * timeConvert;
-			diff_t = lap - start;
-			XPC::Log::FormatLine(LOG_INFO, "EXEC", "Runtime %.6f", diff_t);
-#endif
-		}
 	}
 
-	// If we have processed the maximum number of requests in a single frame,
-	// the socket is probably overloaded. Hopefully this is caused by a
-	// transitory event like a long load inside X-Plane that caused us to stop
-	// responding to requests for a while. We drop the current socket and
-	// re-create it to drop any old packets that have probably already timed
-	// out on the client side.
-	if (ops == OPS_PER_CYCLE)
-	{
-		XPC::Log::WriteLine(LOG_WARN, "EXEC", "Cleared UDP Buffer");
-		delete sock;
-		sock = new XPC::UDPSocket(RECVPORT);
-		XPC::MessageHandlers::SetSocket(sock);
-	}
+	XPC::Interpolator::Update(chrono::steady_clock::now());
+	XPC::Playback::Update();
+	XPC::Recorder::Sample();
+	XPC::History::Sample();
+	XPC::MessageHandlers::SendSubscriptions(chrono::seconds(SUBSCRIPTION_TIMEOUT_S));
+	XPC::MessageHandlers::FlushResponses();
+	XPC::MessageHandlers::EvictIdleConnections(chrono::seconds(CONNECTION_TIMEOUT_S));
+	XPC::Statistics::RecordCallback(chrono::steady_clock::now() - cycleStart);
 	return -1;
 }